@@ -0,0 +1,49 @@
+#ifndef AHUFFMAN_H
+#define AHUFFMAN_H
+
+#include "bitarray.h"
+#include "buffer.h"
+#include <sys/types.h>
+#define AHUFF_SYMBOLS 257 // byte values and the end of stream marker
+#define AHUFF_EOF 256 // symbol marking the end of the stream
+#define AHUFF_SYMBOL_BITS 9 // bits used to send a symbol seen for the first time
+#define AHUFF_NODES (2 * AHUFF_SYMBOLS + 1) // leaves for every symbol and NYT, and their parents
+
+/*
+ * Adaptive Huffman tree node
+ * Nodes are stored in an array indexed by their node number, so that nodes
+ * with a higher number never have a smaller weight (the sibling property).
+ */
+typedef struct ahuffnode_st {
+    size_t weight;
+    int parent;
+    int left;   // -1 for leaves
+    int right;  // -1 for leaves
+    int symbol; // -1 for internal nodes and the NYT node
+} AHuffNode;
+
+/*
+ * Adaptive Huffman coder state (FGK algorithm)
+ * The tree starts out with only the NYT (not yet transmitted) node and is
+ * updated after every symbol, so the encoder and decoder stay in sync
+ * without storing the tree in the stream.
+ */
+typedef struct ahuffman_st {
+    AHuffNode nodes[AHUFF_NODES];
+    int leaves[AHUFF_SYMBOLS]; // node of each symbol, -1 if not seen yet
+    int nyt;                   // node of the NYT leaf
+} AHuffman;
+
+AHuffman *new_ahuffman();
+void delete_ahuffman(AHuffman *coder);
+void ahuffman_encode(AHuffman *coder, BitArray *dst, unsigned symbol);
+ssize_t ahuffman_decode(AHuffman *coder, BitArrayReader *src);
+Buffer *ahuffman_compress(Buffer *src);
+Buffer *ahuffman_extract(Buffer *src);
+void *ahuffman_startEncoder(Buffer *history);
+void ahuffman_updateEncoder(void *encoder, unsigned char *src, size_t len, Buffer *dst);
+void ahuffman_finishEncoder(void *encoder, Buffer *dst);
+void *ahuffman_startDecoder(Buffer *history);
+void ahuffman_updateDecoder(void *decoder, unsigned char *src, size_t len, Buffer *dst);
+void ahuffman_finishDecoder(void *decoder, Buffer *dst);
+#endif
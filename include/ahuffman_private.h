@@ -0,0 +1,20 @@
+#ifndef AHUFFMAN_PRIVATE_H
+#define AHUFFMAN_PRIVATE_H
+#include "ahuffman.h"
+
+/*
+ * Adaptive Huffman coding of a stream given in chunks of any size. The tree
+ * and the bits of a byte not yet complete carry over to the next chunk.
+ */
+typedef struct ahuffstream_st {
+    AHuffman *coder;
+    BitArray *bits;         // coded bits of the last partial byte, or input not yet decoded
+    BitArrayReader *reader; // position in bits when decoding
+    int ended;              // nonzero once AHUFF_EOF has been decoded
+} AHuffStream;
+
+AHuffStream *new_ahuffstream();
+void delete_ahuffstream(AHuffStream *stream);
+void updateAHufftree(AHuffman *coder, unsigned symbol);
+void swapAHuffNodes(AHuffman *coder, int a, int b);
+#endif
@@ -0,0 +1,45 @@
+#ifndef ANS_H
+#define ANS_H
+
+#include "buffer.h"
+#include "bitarray.h"
+#include <stdint.h>
+#define ANS_SYMBOLS 256 // number of possible 8-bit values
+#define ANS_BLOCK_SIZE (128 * 1024) // bytes coded with each table
+#define ANS_MIN_TABLE_LOG 5
+#define ANS_MAX_TABLE_LOG 12 // 4096 states
+#define ANS_TABLE_LOG_BITS 4 // bits used for the table size in a block header
+
+/*
+ * Decoding table entry: the symbol of a state, and how to get to the next
+ * state by reading bits.
+ */
+typedef struct ansentry_st {
+    uint16_t base;      // next state before adding the bits read
+    unsigned char symbol;
+    unsigned char bits; // amount of bits to read
+} ANSEntry;
+
+/*
+ * Table-based asymmetric numeral system (tANS) coding table
+ * The table has 1 << tableLog states. Each symbol owns as many states as its
+ * normalized count, so a symbol occupying a fraction p of the states costs
+ * close to -log2(p) bits, fractions of a bit included.
+ */
+typedef struct anstable_st {
+    int tableLog;
+    uint16_t counts[ANS_SYMBOLS];     // normalized counts, summing to 1 << tableLog
+    uint16_t cumulative[ANS_SYMBOLS]; // first encoding table index of each symbol
+    uint16_t *encode;                 // next state for each symbol and sub-state
+    ANSEntry *decode;
+} ANSTable;
+
+ANSTable *new_anstable(int tableLog);
+void delete_anstable(ANSTable *table);
+void anstable_normalize(ANSTable *table, size_t *freqs);
+void anstable_build(ANSTable *table);
+void anstable_writeCounts(ANSTable *table, BitArray *dst);
+void anstable_readCounts(ANSTable *table, BitArrayReader *src);
+Buffer *ans_compress(Buffer *src);
+Buffer *ans_extract(Buffer *src);
+#endif
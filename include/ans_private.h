@@ -0,0 +1,9 @@
+#ifndef ANS_PRIVATE_H
+#define ANS_PRIVATE_H
+
+#include "ans.h"
+
+int chooseTableLog(size_t *freqs, size_t len);
+size_t encodeANSBlock(unsigned char *data, size_t len, BitArray *dst);
+void decodeANSBlock(BitArrayReader *reader, Buffer *output, size_t len);
+#endif
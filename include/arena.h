@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <sys/types.h>
+
+/*
+ * Scratch memory of a thread
+ * Each slot holds one allocation that is reused by every task the thread
+ * runs, growing when a task needs more. Codecs get their large tables from
+ * the arena of the current thread, so compressing many blocks does not
+ * allocate and free them for every block.
+ */
+enum arena_slot {ARENA_MATCH_HEAD = 0, ARENA_MATCH_PREV, ARENA_FAST_TABLE, ARENA_SLOTS};
+
+typedef struct arena_st {
+    void *blocks[ARENA_SLOTS];
+    size_t sizes[ARENA_SLOTS];
+    int used[ARENA_SLOTS];
+} Arena;
+
+Arena *new_arena();
+void delete_arena(Arena *arena);
+Arena *arena_current();
+void arena_setCurrent(Arena *arena);
+void *arena_alloc(int slot, size_t size);
+void arena_free(int slot, void *ptr);
+#endif
@@ -2,6 +2,7 @@
 #define BITARRAY_H
 
 #include "buffer.h"
+#include <stdint.h>
 
 /*
  * Bit array struct
@@ -43,5 +44,11 @@ int bitarray_get(BitArray *, size_t);
 unsigned char bitarray_getByte(BitArray *, size_t);
 void bitarray_writeInteger(BitArray *ba, size_t val);
 size_t bitarrayreader_readInteger(BitArrayReader *br);
+void bitarray_appendBits(BitArray *dst, uint32_t bits, int count);
+uint32_t bitarrayreader_peekBits(BitArrayReader *br, int count);
+int bitarrayreader_readBits(BitArrayReader *br, int count, uint32_t *dst);
+void bitarray_writeGamma(BitArray *dst, size_t val);
+size_t bitarrayreader_readGamma(BitArrayReader *br);
+size_t bitarray_gammaLength(size_t val);
 
 #endif
@@ -0,0 +1,39 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include "buffer.h"
+#include "threadpool.h"
+#define BLOCK_SIZE ((size_t)1 << 20) // input bytes per block, 1 MiB
+
+/*
+ * Block mode splits the input into blocks that are compressed with one of the
+ * algorithms, so that they can be processed concurrently. Algorithms that
+ * support it can be given the end of the previous block as history, so that
+ * matches may cross block boundaries.
+ */
+typedef Buffer *(*BlockCodec)(Buffer *src);
+typedef Buffer *(*PrimedCodec)(Buffer *src, Buffer *history);
+
+/*
+ * The table of the blocks in compressed input, read from its header before
+ * any block is decoded. It gives the place of every block both in the input
+ * and in the output, so blocks can be decoded in parallel into an output
+ * allocated at once, or skipped.
+ */
+typedef struct blocktable_st {
+    size_t decodedLength;
+    size_t blockSize;
+    size_t history;  // bytes before a block it may refer to, 0 if the blocks are independent
+    size_t count;
+    size_t *offsets; // start of each block in the input, and the end of the last
+    size_t *starts;  // start of each block in the output, and the end of the last
+} BlockTable;
+
+Buffer *block_compress(Buffer *src, BlockCodec compress, ThreadPool *pool);
+Buffer *block_compressPrimed(Buffer *src, PrimedCodec compress, size_t history, ThreadPool *pool);
+Buffer *block_compressWhole(Buffer *src, BlockCodec compress);
+BlockTable *block_readTable(Buffer *src);
+void delete_blocktable(BlockTable *table);
+Buffer *block_extractBlock(Buffer *src, BlockTable *table, size_t index, BlockCodec extract);
+Buffer *block_extract(Buffer *src, BlockCodec extract, PrimedCodec primedExtract, ThreadPool *pool);
+#endif
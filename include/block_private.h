@@ -0,0 +1,34 @@
+#ifndef BLOCK_PRIVATE_H
+#define BLOCK_PRIVATE_H
+
+#include "block.h"
+
+/*
+ * The blocks of one input and the results of processing them
+ */
+typedef struct blockjob_st {
+    BlockCodec codec;
+    PrimedCodec primed; // used instead of codec if set
+    size_t history;     // bytes before a block given to primed
+    Buffer *src;
+    size_t blockSize;
+    Buffer **results;   // the output of each block
+    size_t first;       // start of the first block in src, history before it
+} BlockJob;
+
+/*
+ * The compressed blocks of one input and the buffer they are decoded into
+ */
+typedef struct extractjob_st {
+    BlockCodec codec;
+    PrimedCodec primed; // used instead of codec if history is nonzero
+    Buffer *src;
+    BlockTable *table;
+    Buffer *dst;
+} ExtractJob;
+
+Buffer *compressBlocks(BlockJob *job, ThreadPool *pool);
+void compressBlock(void *job, size_t index);
+void extractBlock(void *job, size_t index);
+Buffer *decodeBlock(ExtractJob *job, size_t index);
+#endif
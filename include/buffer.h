@@ -1,6 +1,7 @@
 #ifndef BUFFER_H
 #define BUFFER_H
 #define BUFSIZE 4096
+#define BUFFER_MAX_GROWTH ((size_t)1 << 28) // a large buffer grows by at most 256 MiB at a time
 #include "error.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,6 +28,7 @@ int buffer_equals(Buffer *a, Buffer *b);
 Buffer *buffer_copyl(Buffer *buf, size_t len);
 void buffer_concatl(Buffer *dest, Buffer *src, size_t len);
 void buffer_pad(Buffer *buf, size_t len);
+void buffer_grow(Buffer *buf, size_t len, size_t limit);
 void buffer_truncate(Buffer *buf);
 void buffer_append(Buffer *, unsigned char *, size_t);
 void buffer_clear(Buffer *buf);
@@ -34,5 +36,7 @@ BufferReader *buffer_createReader(Buffer *buffer);
 void delete_bufferreader(BufferReader *reader);
 ssize_t bufferreader_read(BufferReader *reader, unsigned char *dst, size_t len);
 int bufferreader_isFinal(BufferReader *reader);
+void buffer_appendVarint(Buffer *dst, size_t val);
+int bufferreader_readVarint(BufferReader *reader, size_t *dst);
 
 #endif
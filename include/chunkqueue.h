@@ -0,0 +1,26 @@
+#ifndef CHUNKQUEUE_H
+#define CHUNKQUEUE_H
+
+#include <stdatomic.h>
+#include <sys/types.h>
+#define CHUNKQUEUE_SPINS 64 // tries with sched_yield before sleeping between tries
+
+/*
+ * Bounded single producer, single consumer queue of pointers
+ * Passes chunks of data from one stage of a pipeline to the next. The
+ * producer only writes tail and the consumer only writes head, so neither
+ * takes a lock; a full or empty queue makes the waiting side yield and then
+ * sleep until the other side has caught up.
+ */
+typedef struct chunkqueue_st {
+    void **slots;
+    size_t capacity;
+    atomic_size_t head; // amount of chunks taken
+    atomic_size_t tail; // amount of chunks put in
+} ChunkQueue;
+
+ChunkQueue *new_chunkqueue(size_t capacity);
+void delete_chunkqueue(ChunkQueue *queue);
+void chunkqueue_push(ChunkQueue *queue, void *chunk);
+void *chunkqueue_pop(ChunkQueue *queue);
+#endif
@@ -0,0 +1,29 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include "buffer.h"
+#define CONTAINER_MAGIC "\x89" "CMP"
+#define CONTAINER_MAGIC_SIZE 4
+#define CONTAINER_VERSION 1
+#define CONTAINER_HEADER_SIZE 9
+#define CONTAINER_STREAM 0x01     // blocks framed one at a time as in stream.h, otherwise a block table
+#define CONTAINER_DICTIONARY 0x02 // compressed against a preset dictionary or a reference
+#define CONTAINER_TABLE 0x04      // Huffman codes from a trained table
+
+/*
+ * The header that identifies compressed output: the magic number, the format
+ * version, the ID of the algorithm, the LZSS window and length bits it was
+ * compressed with and flags for the layout of the blocks and what else is
+ * needed to extract them. The blocks follow, either in the block format with
+ * its table of sizes or as a stream.
+ */
+typedef struct containerheader_st {
+    int algorithm;    // ID of the algorithm, numbered by the caller
+    int distanceBits;
+    int lengthBits;
+    int flags;
+} ContainerHeader;
+
+void container_writeHeader(Buffer *dst, ContainerHeader *header);
+size_t container_readHeader(unsigned char *src, size_t len, ContainerHeader *header);
+#endif
@@ -11,5 +11,11 @@
 #include <unistd.h>
 
 Buffer *readFile(char *);
+void readInto(int, Buffer *);
+size_t readUpTo(int, Buffer *, size_t);
 void writeFile(Buffer *, char *);
+int openInput(char *);
+int openOutput(char *);
+void writeBuffer(Buffer *, int);
+Buffer **readDirectory(char *, size_t *);
 #endif
@@ -0,0 +1,39 @@
+#ifndef HUFFCODE_H
+#define HUFFCODE_H
+
+#include "bitarray.h"
+#include <stdint.h>
+#include <sys/types.h>
+#define HUFFCODE_MAX_LENGTH 15 // longest allowed code, fits in the 4-bit length field
+#define HUFFCODE_LENGTH_BITS 4 // bits used for a code length in a serialized table
+#define HUFFCODE_LOOKUP_BITS 10 // width of the primary decoding table index
+
+/*
+ * Canonical Huffman code table
+ * A canonical code is fully described by the code lengths of its symbols, so
+ * only the lengths have to be stored in the compressed stream. Codes are kept
+ * in bit-reversed order so that they can be appended to a BitArray and looked
+ * up from it directly, first bit of the code first.
+ */
+typedef struct huffcode_st {
+    size_t symbols;           // alphabet size
+    unsigned char *lengths;   // code length of each symbol, 0 if unused
+    uint32_t *codes;          // bit-reversed code of each symbol
+    uint16_t *lookup;         // symbol << 4 | length for each HUFFCODE_LOOKUP_BITS prefix
+    uint16_t *sorted;         // symbols in canonical order, for codes longer than the lookup
+    size_t counts[HUFFCODE_MAX_LENGTH + 1]; // amount of codes of each length
+    ssize_t single;           // the only symbol if the code has just one, -1 otherwise
+} HuffCode;
+
+HuffCode *new_huffcode(size_t symbols);
+void delete_huffcode(HuffCode *code);
+void huffcode_fromFrequencies(HuffCode *code, size_t *freqs);
+void huffcode_fromLengths(HuffCode *code, unsigned char *lengths);
+size_t huffcode_cost(HuffCode *code, size_t *freqs);
+size_t huffcode_tableCost(HuffCode *code);
+void huffcode_writeLengths(HuffCode *code, BitArray *dst);
+void huffcode_readLengths(HuffCode *code, BitArrayReader *src);
+void huffcode_encode(HuffCode *code, BitArray *dst, unsigned symbol);
+ssize_t huffcode_decode(HuffCode *code, BitArrayReader *src);
+
+#endif
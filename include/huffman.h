@@ -6,6 +6,11 @@
 #include <string.h>
 #include <sys/types.h>
 #define MAX_LEAVES 256 // number of possible 8-bit values
+#define HUFFMAN_BLOCK_SIZE (128 * 1024) // bytes coded with each Huffman table
+#define HUFFMAN_TABLE_MODE_BITS 2 // bits used for the table mode in a block header
+#define HUFFMAN_TABLE_MODES 3
+
+enum huffman_table_mode {HUFFMAN_TABLE_NEW = 0, HUFFMAN_TABLE_REUSE, HUFFMAN_TABLE_STATIC};
 
 Buffer *huffman_compress(Buffer *src);
 Buffer *huffman_extract(Buffer *src);
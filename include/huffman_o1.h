@@ -0,0 +1,12 @@
+#ifndef HUFFMAN_O1_H
+#define HUFFMAN_O1_H
+
+#include "buffer.h"
+#define O1_CONTEXTS 256 // one context for every possible previous byte
+#define O1_MAX_TABLES 8 // most Huffman tables shared by the contexts
+#define O1_TABLE_BITS 3 // bits used to store the amount of tables
+#define O1_ITERATIONS 8 // most rounds of context clustering
+
+Buffer *huffman_o1_compress(Buffer *src);
+Buffer *huffman_o1_extract(Buffer *src);
+#endif
@@ -0,0 +1,10 @@
+#ifndef HUFFMAN_O1_PRIVATE_H
+#define HUFFMAN_O1_PRIVATE_H
+#include "huffman_o1.h"
+#include "huffcode.h"
+
+size_t *countContextFrequencies(Buffer *src);
+int clusterContexts(size_t *freqs, int tables, unsigned char *map);
+size_t buildContextCodes(size_t *freqs, unsigned char *map, int tables, HuffCode **codes);
+int contextMapBits(int tables);
+#endif
@@ -1,4 +1,5 @@
 #include "huffman.h"
+#include "huffcode.h"
 
 HuffNode *buildHufftree(Buffer *src);
 void encodeLength(BitArray *ba, size_t val);
@@ -7,3 +8,9 @@ HuffNode *buildHufftree(Buffer *src);
 void cacheHuffcodes(HuffNode *, BitArray **, char *, int length);
 void encodeHuffmanPayload(Buffer *src, BitArray *dst, BitArray **codes);
 Buffer *decodeHuffmanPayload(BitArrayReader *reader, HuffNode *tree, size_t decoded_length);
+size_t encodeHuffmanBlock(unsigned char *data, size_t len, BitArray *dst, HuffCode **previous, int *mode);
+size_t encodeCountedHuffmanBlock(unsigned char *data, size_t len, size_t *freqs, BitArray *dst,
+        HuffCode **previous, int *mode);
+void decodeHuffmanBlock(BitArrayReader *reader, Buffer *output, size_t len, HuffCode **previous);
+HuffCode *readHuffmanBlockHeader(BitArrayReader *reader, HuffCode **previous);
+void decodeHuffmanSymbols(BitArrayReader *reader, HuffCode *code, unsigned char *dst, size_t len);
@@ -0,0 +1,24 @@
+#ifndef HUFFMAN_TABLES_H
+#define HUFFMAN_TABLES_H
+
+#include "buffer.h"
+#include "huffcode.h"
+#define HUFFMAN_STATIC_TABLES 3 // built-in text and binary tables and a user table
+#define HUFFMAN_TABLE_ID_BITS 2 // bits used for a static table ID in a block header
+#define HUFFMAN_TABLE_MAGIC "HUFT" // first bytes of a table file
+#define HUFFMAN_TABLE_HASH_BITS 32 // bits used for the ID of the user table
+
+/*
+ * Static Huffman tables
+ * Blocks can refer to a predefined code by its ID instead of storing their
+ * own code lengths, which pays off for inputs too small to carry a table.
+ */
+enum huffman_table_id {HUFFMAN_TABLE_TEXT = 0, HUFFMAN_TABLE_BINARY, HUFFMAN_TABLE_USER};
+
+HuffCode *huffman_staticTable(int id);
+uint32_t huffman_tableId(HuffCode *code);
+void huffman_setUserTable(HuffCode *code);
+HuffCode *huffman_trainTable(Buffer *src);
+Buffer *huffman_serializeTable(HuffCode *code);
+HuffCode *huffman_deserializeTable(Buffer *src);
+#endif
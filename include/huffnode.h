@@ -9,18 +9,19 @@ struct huffnode_st {
     HuffNode *left;
     HuffNode *right;
     ssize_t key;
-    unsigned char value;
+    unsigned short value; // symbol, wider than a byte for alphabets with more than 256 symbols
 };
 
 int huffnode_compare(void *, void *);
 void delete_huffnode(HuffNode *);
-HuffNode *new_huffnode(HuffNode *, HuffNode *, ssize_t, unsigned char);
-HuffNode *huffnode_createLeaf(ssize_t key, unsigned char value);
+HuffNode *new_huffnode(HuffNode *, HuffNode *, ssize_t, unsigned short);
+HuffNode *huffnode_createLeaf(ssize_t key, unsigned short value);
 HuffNode *huffnode_createParent(HuffNode *, HuffNode *);
 int huffnode_isValid(HuffNode *node);
 int huffnode_equals(HuffNode *node1, HuffNode *node2);
 void huffnode_serialize(HuffNode *node, BitArray *dst);
 HuffNode *huffnode_deserialize(BitArrayReader *src);
 int huffnode_isLeaf(HuffNode *);
+HuffNode *huffnode_buildTree(size_t *freqs, size_t symbols);
 
 #endif
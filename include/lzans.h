@@ -0,0 +1,8 @@
+#ifndef LZANS_H
+#define LZANS_H
+
+#include "buffer.h"
+
+Buffer *lzans_compress(Buffer *src);
+Buffer *lzans_extract(Buffer *src);
+#endif
@@ -0,0 +1,13 @@
+#ifndef LZDICT_H
+#define LZDICT_H
+
+#include "buffer.h"
+#include <stdint.h>
+#define LZDICT_KMER 8 // length of the substrings counted by the trainer
+#define LZDICT_SEGMENT 64 // length of the pieces a dictionary is made of
+#define LZDICT_HASH_BITS 20 // size of the substring count table
+
+uint32_t lzdict_id(Buffer *dictionary);
+Buffer *lzdict_check(Buffer *dictionary, uint32_t id);
+Buffer *lzdict_train(Buffer **samples, size_t count, size_t size);
+#endif
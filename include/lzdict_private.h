@@ -0,0 +1,20 @@
+#ifndef LZDICT_PRIVATE_H
+#define LZDICT_PRIVATE_H
+
+#include "lzdict.h"
+
+/*
+ * Piece of a sample chosen for a dictionary
+ */
+typedef struct dictsegment_st {
+    size_t sample; // index of the sample
+    size_t pos;    // position in the sample
+    size_t len;
+    size_t score;  // how common its substrings are among the samples
+} DictSegment;
+
+uint32_t *countSubstrings(Buffer **samples, size_t count);
+int findBestSegment(Buffer **samples, size_t count, uint32_t *occurrences, size_t from, size_t to,
+        DictSegment *best);
+size_t hashSubstring(unsigned char *data);
+#endif
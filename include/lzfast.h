@@ -0,0 +1,15 @@
+#ifndef LZFAST_H
+#define LZFAST_H
+
+#include "buffer.h"
+#define FAST_MINMATCH 4
+#define FAST_HASH_BITS 14 // size of the single-probe hash table
+#define FAST_MAX_OFFSET 65535
+#define FAST_SKIP_STRENGTH 6 // step grows by one every 1 << FAST_SKIP_STRENGTH failed probes
+#define FAST_LAST_LITERALS 5 // matches end at least this far from the end of input
+#define FAST_MATCH_LIMIT 12 // no match starts closer than this to the end of input
+#define FAST_WILDCOPY 32 // extra output space for copying in fixed-size chunks
+
+Buffer *lzfast_compress(Buffer *src);
+Buffer *lzfast_extract(Buffer *src);
+#endif
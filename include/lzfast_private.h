@@ -0,0 +1,8 @@
+#ifndef LZFAST_PRIVATE_H
+#define LZFAST_PRIVATE_H
+
+#include "lzfast.h"
+
+size_t encodeFastSequences(unsigned char *src, size_t len, unsigned char *dst);
+size_t decodeFastSequences(unsigned char *src, size_t srcLen, unsigned char *dst, size_t len);
+#endif
@@ -0,0 +1,20 @@
+#ifndef LZHF_H
+#define LZHF_H
+
+#include "buffer.h"
+#define LZHF_WINDOW_SIZE 32768 // maximum distance of a reference
+#define LZHF_MAXLEN 258 // longest reference
+#define LZHF_CHAIN_LIMIT 128 // hash chain candidates visited per position
+#define LZHF_BLOCK_TOKENS 16384 // tokens coded with each pair of tables
+#define LZHF_END_OF_BLOCK 256
+#define LZHF_LITLEN_SYMBOLS 273 // literals, end of block and 16 length buckets
+#define LZHF_DISTANCE_SYMBOLS 30 // distance buckets
+
+void lzhf_setPipelined(int enabled);
+Buffer *lzhf_compress(Buffer *src);
+Buffer *lzhf_compressWithHistory(Buffer *src, Buffer *history);
+Buffer *lzhf_extract(Buffer *src);
+Buffer *lzhf_extractWithHistory(Buffer *src, Buffer *history);
+Buffer *lzhf2_compress(Buffer *src);
+Buffer *lzhf2_extract(Buffer *src);
+#endif
@@ -0,0 +1,51 @@
+#ifndef LZHF_PRIVATE_H
+#define LZHF_PRIVATE_H
+
+#include "lzhf.h"
+#include "lzss_common.h"
+#include "bitarray.h"
+#include "huffcode.h"
+#include "huffman.h"
+#include "chunkqueue.h"
+#include "lzss_byte_private.h"
+#define LZHF_QUEUE_CHUNKS 4 // chunks in flight between the two stages of lzhf
+#define LZHF_PIECE_SIZE 16384 // bytes Huffman decoded for the LZSS stage at a time
+#define LZHF_RING_PIECES (LZHF_QUEUE_CHUNKS + 2) // pieces in the queue, being decoded and being expanded
+
+/*
+ * Huffman stage of lzhf compression, coding the lzss-byte stream one
+ * Huffman block at a time as the blocks arrive
+ */
+typedef struct encodestage_st {
+    ChunkQueue *queue;  // blocks from the LZSS stage, NULL if both run in one thread
+    BitArray *payload;  // the coded blocks, without the stream header
+    HuffCode *previous; // the last new code, which later blocks may reuse
+    size_t length;      // length of the lzss-byte stream so far
+    size_t blocks;
+    size_t tableBits;
+    size_t modes[HUFFMAN_TABLE_MODES];
+} EncodeStage;
+
+/*
+ * Huffman stage of lzhf extraction, decoding the lzss-byte stream one
+ * Huffman block at a time for the LZSS stage
+ */
+typedef struct decodestage_st {
+    ChunkQueue *queue;  // pieces for the LZSS stage, NULL if both run in one thread
+    Buffer *pieces;     // ring of LZHF_RING_PIECES pieces passed through the queue
+    BitArrayReader *reader;
+    HuffCode *previous;
+    HuffCode *code;     // code of the current block
+    size_t length;      // length of the lzss-byte stream
+    size_t blockSize;
+    size_t pos;         // bytes of the stream decoded
+} DecodeStage;
+
+size_t encodeLZHFBlock(LZToken *tokens, size_t count, BitArray *dst);
+size_t decodeLZHFBlock(BitArrayReader *reader, Buffer *output, size_t limit);
+void queueChunk(ByteChunk *chunk, void *stage);
+void encodeChunk(ByteChunk *chunk, void *stage);
+void *runEncodeStage(void *stage);
+size_t decodePiece(DecodeStage *stage, unsigned char *dst);
+void *runDecodeStage(void *stage);
+#endif
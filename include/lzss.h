@@ -5,4 +5,6 @@
 
 Buffer *lzss_compress(Buffer *src);
 Buffer *lzss_extract(Buffer *src);
+Buffer *lzss_compressWithHistory(Buffer *src, Buffer *history);
+Buffer *lzss_extractWithHistory(Buffer *src, Buffer *history);
 #endif
@@ -5,5 +5,10 @@
 
 Buffer *lzss_byte_compress(Buffer *src);
 Buffer *lzss_byte_extract(Buffer *src);
+Buffer *lzss_byte_compressWithHistory(Buffer *src, Buffer *history);
+Buffer *lzss_byte_extractWithHistory(Buffer *src, Buffer *history);
+void *lzss_byte_startDecoder(Buffer *history);
+void lzss_byte_updateDecoder(void *decoder, unsigned char *src, size_t len, Buffer *dst);
+void lzss_byte_finishDecoder(void *decoder, Buffer *dst);
 #endif
 
@@ -1,10 +1,68 @@
 #ifndef LZSS_BYTE_PRIVATE_H
 #define LZSS_BYTE_PRIVATE_H
 #include "bitarray.h"
+#include "lzss_common.h"
 #include "ringbuffer.h"
 
-void encodeLZSSPayloadByteLevel(Buffer *src, Buffer *dst);
-Buffer *decodeLZSSPayloadByteLevel(BufferReader *reader);
+#define LZSS_BYTE_DICTIONARY_FLAG 0x80 // set in the length byte of the header when a dictionary is used
+#define BYTE_DECODER_TAIL 16 // bytes of a chunk joined to a header or token split by the previous chunk
+
+/*
+ * Part of a byte-level stream and the frequencies of its bytes
+ */
+typedef struct bytechunk_st {
+    Buffer *data;
+    size_t freqs[256];
+} ByteChunk;
+
+typedef void (*ChunkSink)(ByteChunk *chunk, void *arg);
+
+/*
+ * Writes tokens as a byte-level stream, optionally handing it out in chunks
+ */
+typedef struct bytewriter_st {
+    Buffer *dst;         // the output, or the data of the chunk being filled
+    size_t *freqs;       // byte frequencies of dst, NULL to not count them
+    ByteChunk *chunk;    // the chunk being filled, NULL without chunks
+    unsigned char *data; // the input, history included
+    size_t pos;          // position in data of the next token
+    LZSSParams params;
+    size_t chunkSize;    // 0 to write the whole output into dst
+    ChunkSink sink;      // receives each full chunk
+    void *arg;
+} ByteWriter;
+
+/*
+ * Decodes a byte-level stream given in chunks of any size
+ */
+typedef struct bytedecoder_st {
+    Buffer *output;      // history followed by the decoded data
+    Buffer *history;     // the history given, NULL for the preset dictionary
+    size_t start;        // length of the history in front of the output
+    Buffer *tail;        // end of the last chunk, a header or token cut short
+    size_t taken;        // end of the output handed out by bytedecoder_take
+    LZSSParams params;
+    int started;         // nonzero once the header has been read
+} ByteDecoder;
+
+void writeByteHeader(Buffer *dst, Buffer *dictionary, LZSSParams params);
+void encodeByteChunks(Buffer *src, Buffer *history, size_t chunkSize, ChunkSink sink, void *arg);
+ByteChunk *new_bytechunk();
+void delete_bytechunk(ByteChunk *chunk);
+void encodeLZSSPayloadByteLevel(Buffer *src, Buffer *history, Buffer *dst, LZSSParams params);
+void encodeByteTokens(Buffer *src, Buffer *history, ByteWriter *writer);
+void writeByteTokens(LZToken *tokens, size_t count, void *writer);
+void flushByteChunk(ByteWriter *writer);
+Buffer *decodeLZSSPayloadByteLevel(BufferReader *reader, Buffer *history, LZSSParams params);
+ByteDecoder *new_bytedecoder(Buffer *history);
+void startByteDecoder(ByteDecoder *decoder, Buffer *history, LZSSParams params);
+void bytedecoder_update(ByteDecoder *decoder, unsigned char *src, size_t len);
+void bytedecoder_take(ByteDecoder *decoder, Buffer *dst);
+Buffer *bytedecoder_finish(ByteDecoder *decoder);
+size_t readByteHeader(ByteDecoder *decoder, unsigned char *src, size_t len);
+size_t decodeByteChunk(ByteDecoder *decoder, unsigned char *src, size_t len);
+size_t byteTokenSize(LZSSParams params);
+int writeByteTokenWidth(Buffer *dst, unsigned distance, unsigned length, LZSSParams params);
 
 int writeByteToken(Buffer *dst, unsigned distance, unsigned length);
 int writeByteString(Buffer *dst, Buffer *src);
@@ -2,13 +2,116 @@
 #define LZSS_COMMON_H
 
 #include "bitarray.h"
-#include "ringbuffer.h"
-#define WINDOW_SIZE 4096 // size of dictionary window
-#define TOKEN_DISTANCE_BITS 12 // amount of bits for distance of reference from current position (max value 4095
-#define TOKEN_LENGTH_BITS 4 // amount of bits for length of reference (max value 15)
-#define TOKEN_MAXLEN 15
-
-int findMatchKMP(RingBuffer *haystack, Buffer *needle);
-void genKMPTable(Buffer *needle, int *table);
+#include <stdint.h>
+#include <sys/types.h>
+#define LZSS_DEFAULT_DISTANCE_BITS 12 // 4 KiB window, distances up to 4095
+#define LZSS_DEFAULT_LENGTH_BITS 4 // references up to 15 bytes long
+#define LZSS_MIN_DISTANCE_BITS 8
+#define LZSS_MAX_DISTANCE_BITS 20
+#define LZSS_MIN_LENGTH_BITS 2 // room for a MATCH_MIN byte reference
+#define LZSS_MAX_LENGTH_BITS 8 // keeps the first byte of a byte-level token nonzero
+#define LZSS_PARAM_BITS 5 // width of each parameter in a bit-level stream header
+#define LZSS_VARIABLE_LENGTH 0 // length bits for gamma coded lengths and distances, bit-level only
+#define LZSS_VARIABLE_MAXLEN 65535
+#define LZSS_VARIABLE_DISTANCE_BITS 13 // low distance bits stored as is after the gamma coded rest
+#define LZSS_CHAIN_LIMIT 64
+
+#define MATCH_MIN 3 // shortest match found by the hash chain match finder
+#define MATCH_HASH_BITS 15 // size of the hash chain head table
+#define MATCH_REPS 4 // amount of recent distances kept for repeat matches
+#define MATCH_REP_BITS 2 // bits of an index into the recent distances
+#define MATCH_REP_GOOD 32 // repeat matches this long skip the hash chain search
+
+#define LONG_HASH_WINDOW 64 // bytes covered by the rolling hash of the long-range match finder
+#define LONG_SAMPLE_BITS 5 // one position in 32 is sampled on average
+#define LONG_MIN_TABLE_BITS 10
+#define LONG_MAX_TABLE_BITS 20 // bounds the sample table to 8 MiB
+#define LONG_MIN_MATCH 256 // shortest long-range match
+
+/*
+ * Hash chain match finder
+ * Positions are hashed by their first MATCH_MIN bytes. Each inserted position
+ * links to the previous position with the same hash, so candidates are
+ * visited nearest first. Positions are absolute offsets into data, so bytes
+ * before the first coded position can serve as history. Formats that can
+ * code a recently used distance cheaply set repeats, so that the parser
+ * tries those distances first and prefers them over a similar match.
+ */
+typedef struct matchfinder_st {
+    unsigned char *data;
+    size_t len;
+    size_t window;  // maximum distance + 1, a power of two
+    size_t maxLen;  // longest match to look for
+    int chainLimit; // maximum amount of candidates visited per search
+    int repeats;    // amount of recent distances to try first, 0 for none
+    size_t reps[MATCH_REPS]; // recent distances, latest first
+    ssize_t *head;  // latest position of each hash, -1 if none
+    ssize_t *prev;  // previous position with the same hash, indexed modulo window
+} MatchFinder;
+
+/*
+ * LZSS token layout
+ * References are stored as distance << lengthBits | length. The layout is
+ * chosen per run and written to the stream header, so that large windows can
+ * be used for archives and small ones where memory or latency matter. With
+ * LZSS_VARIABLE_LENGTH length bits, bit-level tokens are variable-length
+ * codes instead and distanceBits only limits the window.
+ */
+typedef struct lzssparams_st {
+    int distanceBits; // references reach (1 << distanceBits) - 1 bytes back
+    int lengthBits;   // references are at most (1 << lengthBits) - 1 bytes long
+    int longRange;    // 1 to also look for long repeats at any distance
+} LZSSParams;
+
+/*
+ * Long-range match, a repeat found beyond the reach of the match finder
+ */
+typedef struct longmatch_st {
+    size_t pos;      // position of the repeat
+    size_t distance; // distance to the earlier copy
+    size_t length;
+} LongMatch;
+
+/*
+ * LZ token, either a literal or a back reference
+ */
+typedef struct lztoken_st {
+    uint32_t distance; // 0 for a literal
+    uint32_t length;   // match length, or the value of a literal
+} LZToken;
+
+/*
+ * Receives the tokens of parseTokensTo in batches of up to PARSE_BATCH_TOKENS
+ */
+#define PARSE_BATCH_TOKENS 4096
+typedef void (*TokenSink)(LZToken *tokens, size_t count, void *arg);
+
+/*
+ * Token array filled by parseTokens
+ */
+typedef struct tokenlist_st {
+    LZToken *tokens;
+    size_t count;
+    size_t capacity;
+} TokenList;
+
+LZSSParams lzss_getParameters();
+void lzss_setParameters(int distanceBits, int lengthBits);
+void lzss_setLongRange(int enabled);
+Buffer *lzss_getDictionary();
+void lzss_setDictionary(Buffer *dictionary);
+int lzss_validParameters(LZSSParams params);
+MatchFinder *new_matchfinder(unsigned char *data, size_t len, size_t window, size_t maxLen, int chainLimit);
+void delete_matchfinder(MatchFinder *mf);
+void matchfinder_insert(MatchFinder *mf, size_t pos);
+void matchfinder_skip(MatchFinder *mf, size_t start, size_t end);
+size_t matchfinder_find(MatchFinder *mf, size_t pos, size_t *distance);
+LZToken *parseTokens(MatchFinder *mf, size_t start, size_t *count);
+void parseTokensTo(MatchFinder *mf, size_t start, TokenSink sink, void *arg);
+int findRepeat(size_t *reps, size_t distance);
+int updateRepeats(size_t *reps, size_t distance);
+LongMatch *findLongMatches(unsigned char *data, size_t len, size_t start, size_t minDistance, size_t *count);
+int valueToBucket(size_t value, int *extraBits);
+size_t bucketBase(int bucket, int *extraBits);
 
 #endif
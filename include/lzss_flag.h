@@ -0,0 +1,13 @@
+#ifndef LZSS_FLAG_H
+#define LZSS_FLAG_H
+
+#include "buffer.h"
+#include "lzss_common.h"
+#define LZSS_FLAG_WINDOW 4096 // distances are stored as 12 bits, minus one
+#define LZSS_FLAG_LENGTH_BITS 4
+#define LZSS_FLAG_MAXLEN (MATCH_MIN + 15) // lengths are stored as 4 bits over MATCH_MIN
+#define LZSS_FLAG_CHAIN_LIMIT 32
+
+Buffer *lzss_flag_compress(Buffer *src);
+Buffer *lzss_flag_extract(Buffer *src);
+#endif
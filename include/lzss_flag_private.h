@@ -0,0 +1,17 @@
+#ifndef LZSS_FLAG_PRIVATE_H
+#define LZSS_FLAG_PRIVATE_H
+
+#include "lzss_flag.h"
+
+/*
+ * Decoding table entry for a flag byte
+ */
+typedef struct flagentry_st {
+    unsigned char size;     // bytes taken by the 8 items of the group
+    unsigned char literals; // literals before the first reference
+} FlagEntry;
+
+void encodeLZSSPayloadFlagLevel(LZToken *tokens, size_t count, Buffer *dst);
+void buildFlagTable(FlagEntry *table);
+void decodeLZSSPayloadFlagLevel(unsigned char *src, size_t len, Buffer *dst);
+#endif
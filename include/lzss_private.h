@@ -1,11 +1,34 @@
 #ifndef LZSS_PRIVATE_H
 #define LZSS_PRIVATE_H
 #include "bitarray.h"
+#include "lzss_common.h"
 #include "ringbuffer.h"
 
+/*
+ * State of variable-length token coding, kept alike by encoder and decoder
+ */
+typedef struct variablecoder_st {
+    int lowBits;   // amount of distance bits stored as is
+    int repeats;   // 1 if tokens can refer to a recent distance
+    int longRange; // 1 if the stream has long-range references
+    size_t reps[MATCH_REPS]; // recent distances, latest first
+} VariableCoder;
+
 void writeToken(BitArray *dst, unsigned distance, unsigned length);
 int readToken(BitArrayReader *src, unsigned *distance, unsigned *length);
+void writeTokenWidth(BitArray *dst, unsigned distance, unsigned length, LZSSParams params);
+int readTokenWidth(BitArrayReader *reader, unsigned *distance, unsigned *length, LZSSParams params);
+void writeVariableToken(BitArray *dst, size_t distance, size_t length, VariableCoder *coder);
+void writeLongToken(BitArray *dst, size_t distance, size_t length);
+int readVariableToken(BitArrayReader *reader, size_t *distance, size_t *length, VariableCoder *coder);
+size_t variableTokenLength(size_t distance, size_t length, VariableCoder *coder);
+void writeLZSSItems(BitArray *dst, unsigned char *data, size_t pos, LZToken *tokens, size_t count,
+        LongMatch *longs, size_t longCount, VariableCoder *coder, LZSSParams params);
+void chooseDistanceBits(LZToken *tokens, size_t count, int distanceBits, VariableCoder *coder);
+LZToken *parseAroundLongMatches(MatchFinder *mf, size_t start, LongMatch *longs, size_t longCount, size_t *count);
+void decodeVariableItems(BitArrayReader *reader, Buffer *output, size_t len);
 void writeString(BitArray *dst, Buffer *src);
-void encodeLZSSPayloadBitLevel(Buffer *src, BitArray *dst);
-Buffer *decodeLZSSPayloadBitLevel(BitArrayReader *reader, size_t decoded_length);
+void encodeLZSSPayloadBitLevel(Buffer *src, Buffer *history, BitArray *dst, LZSSParams params);
+Buffer *decodeLZSSPayloadBitLevel(BitArrayReader *reader, Buffer *history, size_t decoded_length,
+        LZSSParams params);
 #endif
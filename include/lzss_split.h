@@ -0,0 +1,16 @@
+#ifndef LZSS_SPLIT_H
+#define LZSS_SPLIT_H
+
+#include "buffer.h"
+#include "lzss_common.h"
+#define LZSS_SPLIT_WINDOW 65536 // distances fit in a high and a low byte
+#define LZSS_SPLIT_MAXLEN (MATCH_MIN + 255) // lengths fit in a byte
+#define LZSS_SPLIT_CHAIN_LIMIT 64
+#define LZSS_SPLIT_STREAMS 5
+
+enum lzss_split_stream {SPLIT_FLAGS = 0, SPLIT_LITERALS, SPLIT_LENGTHS, SPLIT_DISTANCE_HIGH, SPLIT_DISTANCE_LOW};
+enum lzss_split_coder {SPLIT_HUFFMAN = 0, SPLIT_ANS};
+
+Buffer *lzss_split_compress(Buffer *src);
+Buffer *lzss_split_extract(Buffer *src);
+#endif
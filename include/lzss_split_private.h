@@ -0,0 +1,11 @@
+#ifndef LZSS_SPLIT_PRIVATE_H
+#define LZSS_SPLIT_PRIVATE_H
+
+#include "lzss_split.h"
+#include "bitarray.h"
+
+void splitTokens(LZToken *tokens, size_t count, Buffer **streams);
+Buffer *mergeStreams(Buffer **streams, size_t len);
+int encodeStream(Buffer *stream, BitArray *dst);
+Buffer *decodeStream(BitArrayReader *reader);
+#endif
@@ -0,0 +1,83 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "buffer.h"
+#include "block.h"
+#include "threadpool.h"
+#define STREAM_MIN_BLOCK ((size_t)1 << 16)
+#define STREAM_MAX_BLOCK ((size_t)1 << 28)
+#define STREAM_BLOCK_COST 6  // memory per byte of a block in flight: input, output and codec scratch
+#define STREAM_WINDOW_COST 9 // the same per byte of history: the copy and the match finder chains
+
+/*
+ * A decoder of one block that is given the compressed block in chunks of any
+ * size and hands out its output as it goes, for algorithms that can decode
+ * part of a block. The history stays in place until the decoder hands out
+ * output, so it must be copied by then. An encoder that codes the whole
+ * stream as it arrives has the same functions and is given no history.
+ */
+typedef void *(*PartialStart)(Buffer *history);
+typedef void (*PartialUpdate)(void *decoder, unsigned char *src, size_t len, Buffer *dst);
+typedef void (*PartialFinish)(void *decoder, Buffer *dst);
+
+/*
+ * Streaming compression in blocks. Input is given in chunks of any size and
+ * each block is compressed and appended to the output as soon as it is
+ * complete, so only the current block and the history before it are kept in
+ * memory. The stream starts with the block size and the history size, and
+ * each block is written as its decoded length, its compressed size and the
+ * compressed bytes. A zero length marks the end of the stream. Given a thread
+ * pool, the encoder collects several blocks and compresses them at once.
+ * An algorithm that codes its input as it arrives instead writes a block
+ * size of zero, and the output of each chunk as its size and bytes.
+ */
+typedef struct streamencoder_st {
+    BlockCodec codec;
+    PrimedCodec primed; // used instead of codec if set
+    size_t history;     // bytes before a block given to primed
+    size_t blockSize;
+    Buffer *window;     // the history followed by the input of the current block
+    size_t start;       // start of the current block in window
+    int started;        // nonzero once the header is written
+    ThreadPool *pool;   // compresses the blocks of a batch concurrently if set
+    size_t blocks;      // blocks per batch
+    PartialUpdate updateCoder; // code the input as it arrives if set, without blocks
+    PartialFinish finishCoder;
+    void *coder;        // the coder of the whole stream
+} StreamEncoder;
+
+enum stream_state {STREAM_HEADER = 0, STREAM_BLOCKS, STREAM_PARTIAL, STREAM_CHUNKS, STREAM_END};
+
+typedef struct streamdecoder_st {
+    BlockCodec codec;
+    PrimedCodec primed; // used instead of codec if history is nonzero
+    size_t history;
+    size_t blockSize;
+    Buffer *input;      // compressed bytes of the blocks not yet decoded
+    Buffer *window;     // the end of the decoded output
+    enum stream_state state;
+    PartialStart start; // decode blocks, or the chunks of the stream, as they arrive if set
+    PartialUpdate update;
+    PartialFinish finish;
+    int continuous;     // the stream is coded as it arrived, without blocks
+    void *block;        // decoder of the current block, or of the chunks of the stream
+    Buffer previous;    // the history given to it, in window
+    size_t remaining;   // compressed bytes of the current block or chunk still to come
+    size_t expected;    // decoded length of the current block
+    size_t produced;    // bytes of the current block decoded so far
+} StreamDecoder;
+
+StreamEncoder *new_streamencoder(BlockCodec compress, PrimedCodec primed, size_t history, size_t blockSize);
+void delete_streamencoder(StreamEncoder *enc);
+void streamencoder_setPool(StreamEncoder *enc, ThreadPool *pool, size_t blocks);
+void streamencoder_setPartial(StreamEncoder *enc, PartialStart start, PartialUpdate update, PartialFinish finish);
+size_t stream_budgetBlockSize(size_t budget, size_t history, size_t *blocks);
+void streamencoder_update(StreamEncoder *enc, unsigned char *data, size_t len, Buffer *dst);
+void streamencoder_finish(StreamEncoder *enc, Buffer *dst);
+StreamDecoder *new_streamdecoder(BlockCodec extract, PrimedCodec primed);
+void delete_streamdecoder(StreamDecoder *dec);
+void streamdecoder_setPartial(StreamDecoder *dec, PartialStart start, PartialUpdate update, PartialFinish finish);
+void streamdecoder_setContinuous(StreamDecoder *dec, PartialStart start, PartialUpdate update, PartialFinish finish);
+void streamdecoder_update(StreamDecoder *dec, unsigned char *data, size_t len, Buffer *dst);
+void streamdecoder_finish(StreamDecoder *dec);
+#endif
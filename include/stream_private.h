@@ -0,0 +1,14 @@
+#ifndef STREAM_PRIVATE_H
+#define STREAM_PRIVATE_H
+
+#include "stream.h"
+
+void writeStreamBlocks(StreamEncoder *enc, Buffer *dst);
+void writeStreamChunk(Buffer *chunk, Buffer *dst);
+int readStreamHeader(StreamDecoder *dec, BufferReader *reader);
+int readStreamBlock(StreamDecoder *dec, BufferReader *reader, Buffer *dst);
+int readPartialBlock(StreamDecoder *dec, BufferReader *reader, Buffer *dst);
+int readStreamChunk(StreamDecoder *dec, BufferReader *reader, Buffer *dst);
+void extendWindow(StreamDecoder *dec, unsigned char *data, size_t len);
+void keepWindow(Buffer *window, size_t len);
+#endif
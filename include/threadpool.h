@@ -0,0 +1,46 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "arena.h"
+#include <sys/types.h>
+#include <pthread.h>
+#define THREADPOOL_MAX_THREADS 256
+
+/*
+ * A set of threads that run batches of independent tasks. The tasks of a
+ * batch are divided evenly among the queues of the threads. Each thread
+ * takes tasks from the front of its own queue, and once it is empty steals
+ * from the back of the queues of the others, so a thread that was given
+ * small tasks helps with the large ones instead of waiting for them. The
+ * calling thread works as the first thread of the pool.
+ * Every thread has its own Arena, set as the current arena while it runs
+ * tasks, so scratch memory is reused from one task to the next.
+ */
+typedef void (*ThreadTask)(void *arg, size_t index);
+
+typedef struct taskqueue_st {
+    size_t first;         // next task the owner takes
+    size_t last;          // one past the task a thief takes
+    pthread_mutex_t lock; // protects first and last
+} TaskQueue;
+
+typedef struct threadpool_st {
+    int threads;
+    pthread_t *workers;   // the threads besides the calling one
+    TaskQueue *queues;    // one per thread
+    Arena **arenas;       // one per thread
+    ThreadTask task;
+    void *arg;
+    size_t remaining;     // tasks of the batch not yet finished
+    unsigned long batch;  // counts the batches, wakes the workers
+    int stop;
+    pthread_mutex_t lock; // protects remaining, batch and stop
+    pthread_cond_t wake;
+    pthread_cond_t done;
+} ThreadPool;
+
+int threadpool_cores();
+ThreadPool *new_threadpool(int threads);
+void delete_threadpool(ThreadPool *pool);
+void threadpool_run(ThreadPool *pool, size_t tasks, ThreadTask task, void *arg);
+#endif
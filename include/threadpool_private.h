@@ -0,0 +1,17 @@
+#ifndef THREADPOOL_PRIVATE_H
+#define THREADPOOL_PRIVATE_H
+
+#include "threadpool.h"
+
+/*
+ * Arguments of a worker thread
+ */
+typedef struct worker_st {
+    ThreadPool *pool;
+    int id;
+} Worker;
+
+void *runWorker(void *worker);
+void runTasks(ThreadPool *pool, int id);
+int takeTask(TaskQueue *queue, size_t *index, int steal);
+#endif
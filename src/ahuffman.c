@@ -0,0 +1,381 @@
+#include "../include/ahuffman.h"
+#include "../include/ahuffman_private.h"
+#include "../include/bitarray.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+
+/**
+ * Allocates a new adaptive Huffman coder. The tree initially consists of the
+ * NYT node only, placed at the root.
+ * @return the newly created coder
+ */
+AHuffman *new_ahuffman()
+{
+    AHuffman *ret = mmalloc(sizeof(AHuffman));
+    for (int i = 0; i < AHUFF_NODES; i++) {
+        ret->nodes[i].weight = 0;
+        ret->nodes[i].parent = -1;
+        ret->nodes[i].left = -1;
+        ret->nodes[i].right = -1;
+        ret->nodes[i].symbol = -1;
+    }
+    for (int i = 0; i < AHUFF_SYMBOLS; i++)
+        ret->leaves[i] = -1;
+    ret->nyt = AHUFF_NODES - 1;
+    return ret;
+}
+
+/**
+ * Frees memory allocated for an adaptive Huffman coder.
+ * @param coder the coder to delete
+ */
+void delete_ahuffman(AHuffman *coder)
+{
+    if (!coder)
+        err_quit("null pointer when deleting adaptive Huffman coder");
+    free(coder);
+}
+
+/**
+ * Encode a symbol with the current tree and update the tree. Symbols seen for
+ * the first time are sent as the code of the NYT node followed by the raw
+ * 9-bit symbol value.
+ * @param coder the coder state
+ * @param dst destination BitArray
+ * @param symbol the symbol to encode, a byte value or AHUFF_EOF
+ */
+void ahuffman_encode(AHuffman *coder, BitArray *dst, unsigned symbol)
+{
+    if (!coder || !dst)
+        err_quit("null pointer in ahuffman_encode");
+    if (symbol >= AHUFF_SYMBOLS)
+        err_quit("invalid symbol in ahuffman_encode");
+
+    int node = coder->leaves[symbol] >= 0 ? coder->leaves[symbol] : coder->nyt;
+    // collect the path from the leaf up to the root, then write it root first
+    unsigned char path[AHUFF_NODES];
+    int depth = 0;
+    while (coder->nodes[node].parent >= 0) {
+        int parent = coder->nodes[node].parent;
+        path[depth++] = coder->nodes[parent].right == node;
+        node = parent;
+    }
+    while (depth > 0)
+        bitarray_appendBits(dst, path[--depth], 1);
+    if (coder->leaves[symbol] < 0)
+        bitarray_appendBits(dst, symbol, AHUFF_SYMBOL_BITS);
+
+    updateAHufftree(coder, symbol);
+}
+
+/**
+ * Decode a symbol and update the tree. If the input runs out in the middle of
+ * a code, the reader is rewound to where it was, so decoding can be retried
+ * once more input is available.
+ * @param coder the coder state
+ * @param src reader for the source BitArray
+ * @return the decoded symbol, -1 if the input ran out
+ */
+ssize_t ahuffman_decode(AHuffman *coder, BitArrayReader *src)
+{
+    if (!coder || !src)
+        err_quit("null pointer in ahuffman_decode");
+
+    size_t start = src->pos;
+    int node = AHUFF_NODES - 1;
+    while (coder->nodes[node].left >= 0) {
+        int bit;
+        if (bitarrayreader_readBit(src, &bit) < 1) {
+            src->pos = start;
+            return -1;
+        }
+        node = bit ? coder->nodes[node].right : coder->nodes[node].left;
+    }
+
+    unsigned symbol;
+    if (node == coder->nyt) {
+        uint32_t bits;
+        if (bitarrayreader_readBits(src, AHUFF_SYMBOL_BITS, &bits) < 1) {
+            src->pos = start;
+            return -1;
+        }
+        if (bits >= AHUFF_SYMBOLS || coder->leaves[bits] >= 0)
+            err_quit("invalid symbol in adaptive Huffman stream");
+        symbol = bits;
+    } else {
+        symbol = coder->nodes[node].symbol;
+    }
+
+    updateAHufftree(coder, symbol);
+    return symbol;
+}
+
+/**
+ * Update the tree after coding a symbol (FGK algorithm). A new symbol splits
+ * the NYT node into a new NYT node and a leaf for the symbol. Then, walking
+ * from the symbol's leaf to the root, each node is swapped with the highest
+ * numbered node of the same weight before its weight is incremented, which
+ * keeps the tree a Huffman tree for the updated weights.
+ * @param coder the coder state
+ * @param symbol the symbol that was coded
+ */
+void updateAHufftree(AHuffman *coder, unsigned symbol)
+{
+    AHuffNode *nodes = coder->nodes;
+    int q = coder->leaves[symbol];
+    if (q < 0) {
+        // old NYT node becomes the parent of the new NYT node and the new leaf
+        int parent = coder->nyt;
+        q = parent - 1;
+        coder->nyt = parent - 2;
+        nodes[q].parent = parent;
+        nodes[q].symbol = symbol;
+        nodes[coder->nyt].parent = parent;
+        nodes[coder->nyt].symbol = -1;
+        nodes[parent].left = coder->nyt;
+        nodes[parent].right = q;
+        coder->leaves[symbol] = q;
+    }
+
+    while (q >= 0) {
+        // find the block leader: highest numbered node with the same weight
+        int leader = q;
+        while (leader + 1 < AHUFF_NODES && nodes[leader + 1].weight == nodes[q].weight)
+            leader++;
+        if (leader != q && leader != nodes[q].parent) {
+            swapAHuffNodes(coder, q, leader);
+            q = leader;
+        }
+        nodes[q].weight++;
+        q = nodes[q].parent;
+    }
+}
+
+/**
+ * Swap the subtrees at two node numbers. The nodes keep their positions in
+ * the tree, so only their contents and the links pointing to them change.
+ * @param coder the coder state
+ * @param a, b node numbers to swap
+ */
+void swapAHuffNodes(AHuffman *coder, int a, int b)
+{
+    AHuffNode *nodes = coder->nodes;
+    AHuffNode temp = nodes[a];
+    int parentA = nodes[a].parent;
+    int parentB = nodes[b].parent;
+    nodes[a] = nodes[b];
+    nodes[a].parent = parentA;
+    nodes[b] = temp;
+    nodes[b].parent = parentB;
+
+    int swapped[2] = {a, b};
+    for (int i = 0; i < 2; i++) {
+        int n = swapped[i];
+        if (nodes[n].left >= 0) {
+            nodes[nodes[n].left].parent = n;
+            nodes[nodes[n].right].parent = n;
+        } else if (nodes[n].symbol >= 0) {
+            coder->leaves[nodes[n].symbol] = n;
+        } else {
+            coder->nyt = n;
+        }
+    }
+}
+
+/**
+ * Compress a Buffer using adaptive Huffman coding. The input is coded in a
+ * single pass, so output can be produced as soon as input arrives, see
+ * ahuffman_startEncoder. The stream ends with the AHUFF_EOF symbol instead
+ * of starting with a length.
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *ahuffman_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in ahuffman_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    void *encoder = ahuffman_startEncoder(NULL);
+    Buffer *ret = new_buffer();
+    ahuffman_updateEncoder(encoder, src->data, src->len, ret);
+    ahuffman_finishEncoder(encoder, ret);
+    return ret;
+}
+
+/**
+ * Decompress a Buffer compressed with adaptive Huffman coding.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *ahuffman_extract(Buffer *src)
+{
+    if (src->len == 0)
+        err_quit("file is empty, skipping extraction");
+
+    void *decoder = ahuffman_startDecoder(NULL);
+    Buffer *ret = new_buffer();
+    ahuffman_updateDecoder(decoder, src->data, src->len, ret);
+    ahuffman_finishDecoder(decoder, ret);
+    return ret;
+}
+
+/**
+ * Allocates the state of an adaptive Huffman stream, with a new tree.
+ * @return the newly created AHuffStream
+ */
+AHuffStream *new_ahuffstream()
+{
+    AHuffStream *ret = mmalloc(sizeof(AHuffStream));
+    ret->coder = new_ahuffman();
+    ret->bits = new_bitarray();
+    ret->reader = bitarray_createReader(ret->bits);
+    ret->ended = 0;
+    return ret;
+}
+
+/**
+ * Frees the state of an adaptive Huffman stream.
+ * @param stream the AHuffStream to delete
+ */
+void delete_ahuffstream(AHuffStream *stream)
+{
+    if (!stream)
+        err_quit("null pointer when deleting adaptive Huffman stream");
+    delete_bitarrayreader(stream->reader);
+    delete_bitarray(stream->bits);
+    delete_ahuffman(stream->coder);
+    free(stream);
+}
+
+/**
+ * Start coding a stream given in chunks with adaptive Huffman coding.
+ * Together, the output of ahuffman_updateEncoder and ahuffman_finishEncoder
+ * is the same as that of ahuffman_compress for the whole input.
+ * @param history must be NULL, adaptive Huffman coding has no history
+ * @return the encoder
+ */
+void *ahuffman_startEncoder(Buffer *history)
+{
+    if (history)
+        err_quit("adaptive Huffman coding does not refer to earlier data");
+    return new_ahuffstream();
+}
+
+/**
+ * Code the next chunk of a stream and hand out the whole bytes of output.
+ * The bits of the last byte are kept until more follow, the tree until the
+ * end of the stream.
+ * @param encoder the encoder from ahuffman_startEncoder
+ * @param src the chunk
+ * @param len length of the chunk
+ * @param dst the Buffer to append the output to
+ */
+void ahuffman_updateEncoder(void *encoder, unsigned char *src, size_t len, Buffer *dst)
+{
+    AHuffStream *stream = encoder;
+    if (!stream || !dst || (!src && len > 0))
+        err_quit("null pointer in ahuffman_updateEncoder");
+
+    BitArray *bits = stream->bits;
+    for (size_t i = 0; i < len; i++)
+        ahuffman_encode(stream->coder, bits, src[i]);
+    size_t whole = bits->len / 8;
+    buffer_append(dst, bits->data->data, whole);
+    // the partial byte moves to the front, its unused bits are still zero
+    if (bits->len % 8)
+        bits->data->data[0] = bits->data->data[whole];
+    bits->data->len = bits->len % 8 ? 1 : 0;
+    bits->len %= 8;
+}
+
+/**
+ * End a stream with AHUFF_EOF, hand out the rest of the output and free the
+ * encoder.
+ * @param encoder the encoder from ahuffman_startEncoder
+ * @param dst the Buffer to append the output to
+ */
+void ahuffman_finishEncoder(void *encoder, Buffer *dst)
+{
+    AHuffStream *stream = encoder;
+    if (!stream || !dst)
+        err_quit("null pointer in ahuffman_finishEncoder");
+
+    ahuffman_encode(stream->coder, stream->bits, AHUFF_EOF);
+    buffer_append(dst, stream->bits->data->data, (stream->bits->len + 7) / 8);
+    delete_ahuffstream(stream);
+}
+
+/**
+ * Start decoding an adaptive Huffman stream given in chunks.
+ * @param history must be NULL, adaptive Huffman coding has no history
+ * @return the decoder
+ */
+void *ahuffman_startDecoder(Buffer *history)
+{
+    if (history)
+        err_quit("adaptive Huffman coding does not refer to earlier data");
+    return new_ahuffstream();
+}
+
+/**
+ * Decode the next chunk of an adaptive Huffman stream. The chunk may end in
+ * the middle of a code, which ahuffman_decode then rewinds to, so it is
+ * decoded once the rest arrives.
+ * @param decoder the decoder from ahuffman_startDecoder
+ * @param src the chunk
+ * @param len length of the chunk
+ * @param dst the Buffer to append the decoded output to
+ */
+void ahuffman_updateDecoder(void *decoder, unsigned char *src, size_t len, Buffer *dst)
+{
+    AHuffStream *stream = decoder;
+    if (!stream || !dst || (!src && len > 0))
+        err_quit("null pointer in ahuffman_updateDecoder");
+    if (stream->ended && len > 0)
+        err_quit("data after the end of the adaptive Huffman stream");
+
+    BitArray *bits = stream->bits;
+    BitArrayReader *reader = stream->reader;
+    if (len > 0)
+        buffer_append(bits->data, src, len);
+    bits->len = bits->data->len * 8;
+    ssize_t symbol;
+    while (!stream->ended && (symbol = ahuffman_decode(stream->coder, reader)) >= 0) {
+        if (symbol == AHUFF_EOF) {
+            stream->ended = 1;
+            break;
+        }
+        unsigned char byte = symbol;
+        buffer_append(dst, &byte, 1);
+    }
+    if (stream->ended && (reader->pos + 7) / 8 < bits->data->len)
+        err_quit("data after the end of the adaptive Huffman stream");
+
+    // drop the bytes decoded in full, a code cut short stays
+    size_t consumed = reader->pos / 8;
+    memmove(bits->data->data, bits->data->data + consumed, bits->data->len - consumed);
+    bits->data->len -= consumed;
+    bits->len = bits->data->len * 8;
+    reader->pos -= consumed * 8;
+}
+
+/**
+ * Check that an adaptive Huffman stream ended with AHUFF_EOF and free the
+ * decoder.
+ * @param decoder the decoder from ahuffman_startDecoder
+ * @param dst the Buffer to append the rest of the output to, all output is
+ * handed out by ahuffman_updateDecoder already
+ */
+void ahuffman_finishDecoder(void *decoder, Buffer *dst)
+{
+    AHuffStream *stream = decoder;
+    if (!stream || !dst)
+        err_quit("null pointer in ahuffman_finishDecoder");
+    if (!stream->ended)
+        err_quit("unexpected end of file while reading payload");
+    delete_ahuffstream(stream);
+}
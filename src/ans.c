@@ -0,0 +1,368 @@
+#include "../include/ans.h"
+#include "../include/ans_private.h"
+#include "../include/bitarray.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <string.h>
+
+int highBit(uint32_t val);
+
+/**
+ * Allocates an empty tANS table.
+ * @param tableLog base 2 logarithm of the amount of states
+ * @return the newly created ANSTable
+ */
+ANSTable *new_anstable(int tableLog)
+{
+    if (tableLog < ANS_MIN_TABLE_LOG || tableLog > ANS_MAX_TABLE_LOG)
+        err_quit("unsupported tANS table size");
+
+    ANSTable *ret = mmalloc(sizeof(ANSTable));
+    ret->tableLog = tableLog;
+    memset(ret->counts, 0, sizeof(ret->counts));
+    memset(ret->cumulative, 0, sizeof(ret->cumulative));
+    ret->encode = mcalloc(1 << tableLog, sizeof(uint16_t));
+    ret->decode = mcalloc(1 << tableLog, sizeof(ANSEntry));
+    return ret;
+}
+
+/**
+ * Frees memory allocated for ANSTable.
+ * @param table the ANSTable to delete
+ */
+void delete_anstable(ANSTable *table)
+{
+    if (!table)
+        err_quit("null pointer when deleting ANSTable");
+
+    free(table->encode);
+    free(table->decode);
+    free(table);
+}
+
+/**
+ * Position of the highest set bit.
+ * @param val a nonzero value
+ * @return floor(log2(val))
+ */
+int highBit(uint32_t val)
+{
+    int ret = 0;
+    while (val >>= 1)
+        ret++;
+    return ret;
+}
+
+/**
+ * Scale symbol frequencies to counts summing to the table size. Every symbol
+ * that occurs gets a count of at least 1. Rounding errors are corrected on
+ * the most frequent symbols, where they cost the least.
+ * @param table the table to initialize
+ * @param freqs frequency of each symbol, ANS_SYMBOLS entries
+ */
+void anstable_normalize(ANSTable *table, size_t *freqs)
+{
+    if (!table || !freqs)
+        err_quit("null pointer normalizing tANS counts");
+
+    size_t total = 0;
+    int used = 0;
+    for (int i = 0; i < ANS_SYMBOLS; i++) {
+        total += freqs[i];
+        used += freqs[i] > 0;
+    }
+    long size = 1 << table->tableLog;
+    if (total == 0 || used > size)
+        err_quit("cannot normalize tANS counts");
+
+    long sum = 0;
+    int largest = 0;
+    for (int i = 0; i < ANS_SYMBOLS; i++) {
+        long count = 0;
+        if (freqs[i] > 0) {
+            count = (freqs[i] * size + total / 2) / total;
+            if (count == 0)
+                count = 1;
+        }
+        table->counts[i] = count;
+        sum += count;
+        if (count > table->counts[largest])
+            largest = i;
+    }
+    if (sum < size)
+        table->counts[largest] += size - sum;
+    while (sum > size) {
+        // rounding up small counts took too many states
+        largest = 0;
+        for (int i = 1; i < ANS_SYMBOLS; i++)
+            if (table->counts[i] > table->counts[largest])
+                largest = i;
+        table->counts[largest]--;
+        sum--;
+    }
+}
+
+/**
+ * Build the encoding and decoding tables from the normalized counts. The
+ * states of each symbol are spread over the table with a fixed step, so
+ * that states of a symbol are evenly distributed, as in FSE.
+ * @param table the table to build
+ */
+void anstable_build(ANSTable *table)
+{
+    if (!table)
+        err_quit("null pointer building tANS table");
+
+    uint32_t size = 1 << table->tableLog;
+    uint32_t mask = size - 1;
+    uint32_t step = (size >> 1) + (size >> 3) + 3; // odd, visits every state
+    unsigned char *spread = mmalloc(size);
+    uint32_t pos = 0, cumulative = 0;
+    uint32_t next[ANS_SYMBOLS];
+    for (int i = 0; i < ANS_SYMBOLS; i++) {
+        table->cumulative[i] = cumulative;
+        cumulative += table->counts[i];
+        next[i] = table->counts[i];
+        for (int j = 0; j < table->counts[i]; j++) {
+            spread[pos] = i;
+            pos = (pos + step) & mask;
+        }
+    }
+    if (cumulative != size)
+        err_quit("invalid tANS counts");
+
+    for (uint32_t state = 0; state < size; state++) {
+        unsigned char symbol = spread[state];
+        // sub-states of a symbol run from its count to twice its count
+        uint32_t sub = next[symbol]++;
+        int bits = table->tableLog - highBit(sub);
+        table->decode[state].symbol = symbol;
+        table->decode[state].bits = bits;
+        table->decode[state].base = (sub << bits) - size;
+        table->encode[table->cumulative[symbol] + sub - table->counts[symbol]] = state + size;
+    }
+    free(spread);
+}
+
+/**
+ * Serialize normalized counts. Each count is gamma coded as count + 1, and
+ * a zero count is followed by the gamma coded length of the run of zeroes it
+ * starts, so unused symbols take little space.
+ * @param table the table to serialize
+ * @param dst destination BitArray
+ */
+void anstable_writeCounts(ANSTable *table, BitArray *dst)
+{
+    if (!table || !dst)
+        err_quit("null pointer writing tANS counts");
+
+    for (int i = 0; i < ANS_SYMBOLS;) {
+        bitarray_writeGamma(dst, table->counts[i] + 1);
+        if (table->counts[i] > 0) {
+            i++;
+            continue;
+        }
+        int run = 1;
+        while (i + run < ANS_SYMBOLS && table->counts[i + run] == 0)
+            run++;
+        bitarray_writeGamma(dst, run);
+        i += run;
+    }
+}
+
+/**
+ * Deserialize counts written by anstable_writeCounts and build the table.
+ * @param table the table to initialize
+ * @param src reader for the source BitArray
+ */
+void anstable_readCounts(ANSTable *table, BitArrayReader *src)
+{
+    if (!table || !src)
+        err_quit("null pointer reading tANS counts");
+
+    size_t size = 1 << table->tableLog, sum = 0;
+    for (int i = 0; i < ANS_SYMBOLS;) {
+        size_t count = bitarrayreader_readGamma(src);
+        if (count == 0 || count - 1 > size - sum)
+            err_quit("invalid tANS counts");
+        table->counts[i] = count - 1;
+        sum += count - 1;
+        if (count > 1) {
+            i++;
+            continue;
+        }
+        size_t run = bitarrayreader_readGamma(src);
+        if (run == 0 || run > (size_t)(ANS_SYMBOLS - i))
+            err_quit("invalid tANS counts");
+        memset(table->counts + i, 0, run * sizeof(uint16_t));
+        i += run;
+    }
+    anstable_build(table);
+}
+
+/**
+ * Choose the table size for a block: large enough to give every used symbol
+ * a state, and no larger than needed to represent the block's statistics.
+ * @param freqs frequency of each symbol
+ * @param len length of the block
+ * @return base 2 logarithm of the table size
+ */
+int chooseTableLog(size_t *freqs, size_t len)
+{
+    int used = 0;
+    for (int i = 0; i < ANS_SYMBOLS; i++)
+        used += freqs[i] > 0;
+    if (used <= 1)
+        return ANS_MIN_TABLE_LOG; // a lone symbol takes no bits with any table size
+    int minLog = highBit(used - 1) + 1;
+    int ret = len > 1 ? highBit(len - 1) + 1 : 0;
+    if (ret > ANS_MAX_TABLE_LOG)
+        ret = ANS_MAX_TABLE_LOG;
+    if (ret < minLog)
+        ret = minLog;
+    return ret < ANS_MIN_TABLE_LOG ? ANS_MIN_TABLE_LOG : ret;
+}
+
+/**
+ * Encode a block of input with its own tANS table. The block header holds
+ * the table size and the normalized counts, followed by the final encoder
+ * state. Symbols are encoded last to first so that the decoder can run
+ * forwards; the bits written for each symbol are buffered and output in
+ * reverse order for the same reason.
+ * @param data start of the block
+ * @param len length of the block in bytes
+ * @param dst the destination BitArray
+ * @return size of the block header in bits
+ */
+size_t encodeANSBlock(unsigned char *data, size_t len, BitArray *dst)
+{
+    if (!data || !dst)
+        err_quit("null pointer in encodeANSBlock");
+
+    size_t freqs[ANS_SYMBOLS] = {0};
+    for (size_t i = 0; i < len; i++)
+        freqs[data[i]]++;
+    size_t start = dst->len;
+    ANSTable *table = new_anstable(chooseTableLog(freqs, len));
+    anstable_normalize(table, freqs);
+    anstable_build(table);
+    bitarray_appendBits(dst, table->tableLog, ANS_TABLE_LOG_BITS);
+    anstable_writeCounts(table, dst);
+    size_t headerBits = dst->len - start;
+
+    // bits << 4 | amount of bits, for each symbol
+    uint32_t *out = mmalloc(len * sizeof(uint32_t));
+    uint32_t state = 1 << table->tableLog;
+    for (size_t i = len; i-- > 0;) {
+        unsigned char symbol = data[i];
+        uint32_t count = table->counts[symbol];
+        int bits = table->tableLog - highBit(count);
+        if ((state >> bits) < count)
+            bits--;
+        out[i] = (state & ((1u << bits) - 1)) << 4 | bits;
+        state = table->encode[table->cumulative[symbol] + (state >> bits) - count];
+    }
+    bitarray_appendBits(dst, state - (1 << table->tableLog), table->tableLog);
+    // the bits of the last symbol would only restore the initial state
+    for (size_t i = 0; i + 1 < len; i++)
+        bitarray_appendBits(dst, out[i] >> 4, out[i] & 0xf);
+
+    free(out);
+    delete_anstable(table);
+    return headerBits;
+}
+
+/**
+ * Decode a block written by encodeANSBlock. Each symbol takes one table
+ * lookup and one read of a known amount of bits.
+ * @param reader BitArrayReader positioned at the block header
+ * @param output the Buffer to append decoded bytes to
+ * @param len decoded length of the block in bytes
+ */
+void decodeANSBlock(BitArrayReader *reader, Buffer *output, size_t len)
+{
+    if (!reader || !output)
+        err_quit("null pointer in decodeANSBlock");
+    if (len > ANS_BLOCK_SIZE)
+        err_quit("tANS block too long");
+
+    uint32_t tableLog, state, bits;
+    if (bitarrayreader_readBits(reader, ANS_TABLE_LOG_BITS, &tableLog) < 0)
+        err_quit("unexpected end of file while reading block header");
+    ANSTable *table = new_anstable(tableLog);
+    anstable_readCounts(table, reader);
+    if (bitarrayreader_readBits(reader, tableLog, &state) < 0)
+        err_quit("unexpected end of file while reading block header");
+
+    size_t start = output->len;
+    buffer_pad(output, len);
+    for (size_t i = 0; i < len; i++) {
+        ANSEntry entry = table->decode[state];
+        output->data[start + i] = entry.symbol;
+        if (i + 1 == len)
+            break;
+        if (bitarrayreader_readBits(reader, entry.bits, &bits) < 0)
+            err_quit("unexpected end of file while reading payload");
+        state = entry.base + bits;
+    }
+    delete_anstable(table);
+}
+
+/**
+ * Compresses a Buffer using tANS coding. Like the Huffman variant, input is
+ * split into blocks of ANS_BLOCK_SIZE bytes, each with its own table.
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *ans_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in ans_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    BitArray *output = new_bitarray();
+    // encode unpacked length and block size
+    bitarray_writeInteger(output, src->len);
+    bitarray_writeInteger(output, ANS_BLOCK_SIZE);
+    size_t headerBits = 0;
+    for (size_t pos = 0; pos < src->len; pos += ANS_BLOCK_SIZE) {
+        size_t len = src->len - pos < ANS_BLOCK_SIZE ? src->len - pos : ANS_BLOCK_SIZE;
+        headerBits += encodeANSBlock(src->data + pos, len, output);
+    }
+    fprintf(stderr, "size of tANS tables: %lu bits (%lu bytes)\n", headerBits, (headerBits + 7) / 8);
+    return bitarray_deleteAndConvertToBuffer(output);
+}
+
+/**
+ * Decompress tANS compressed Buffer.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *ans_extract(Buffer *src)
+{
+    if (src->len == 0)
+        err_quit("file is empty, skipping extraction\n");
+
+    BitArray *data = bitarray_fromBuffer(src);
+    BitArrayReader *reader = bitarray_createReader(data);
+    // decode uncompressed length and block size
+    size_t decoded_length = bitarrayreader_readInteger(reader);
+    size_t block_size = bitarrayreader_readInteger(reader);
+    if (block_size == 0 || block_size > ANS_BLOCK_SIZE)
+        err_quit("failed to read header");
+    // a lone symbol takes no bits, so the length can't be checked against
+    // the input, but every block needs a header from it
+    Buffer *ret = new_buffer();
+    for (size_t pos = 0; pos < decoded_length; pos += block_size) {
+        if (reader->pos == data->len)
+            err_quit("unexpected end of file while reading block header");
+        size_t len = decoded_length - pos < block_size ? decoded_length - pos : block_size;
+        decodeANSBlock(reader, ret, len);
+    }
+    delete_bitarrayreader(reader);
+    delete_bitarrayPreserveContents(data);
+    return ret;
+}
@@ -0,0 +1,90 @@
+#include "../include/arena.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <stdlib.h>
+
+static _Thread_local Arena *current = NULL;
+
+/**
+ * Allocates an empty arena.
+ * @return the newly created Arena
+ */
+Arena *new_arena()
+{
+    return mcalloc(1, sizeof(Arena));
+}
+
+/**
+ * Frees an arena and the memory in its slots.
+ * @param arena the Arena to delete
+ */
+void delete_arena(Arena *arena)
+{
+    if (!arena)
+        err_quit("null pointer when deleting arena");
+
+    for (int i = 0; i < ARENA_SLOTS; i++)
+        free(arena->blocks[i]);
+    free(arena);
+}
+
+/**
+ * Get the arena of the calling thread.
+ * @return the Arena, NULL if the thread has none
+ */
+Arena *arena_current()
+{
+    return current;
+}
+
+/**
+ * Set the arena of the calling thread.
+ * @param arena the Arena, NULL for none
+ */
+void arena_setCurrent(Arena *arena)
+{
+    current = arena;
+}
+
+/**
+ * Allocate scratch memory from a slot of the current thread's arena. The
+ * contents are undefined. If the thread has no arena or the slot is already
+ * in use, the memory is allocated as usual.
+ * @param slot the slot to use
+ * @param size amount of bytes needed
+ * @return the memory, to be released with arena_free
+ */
+void *arena_alloc(int slot, size_t size)
+{
+    if (slot < 0 || slot >= ARENA_SLOTS)
+        err_quit("invalid arena slot");
+
+    Arena *arena = current;
+    if (!arena || arena->used[slot])
+        return mmalloc(size);
+    if (arena->sizes[slot] < size) {
+        // the old contents are not needed, so there is nothing to copy
+        free(arena->blocks[slot]);
+        arena->blocks[slot] = mmalloc(size);
+        arena->sizes[slot] = size;
+    }
+    arena->used[slot] = 1;
+    return arena->blocks[slot];
+}
+
+/**
+ * Release memory allocated with arena_alloc.
+ * @param slot the slot the memory was allocated from
+ * @param ptr the memory
+ */
+void arena_free(int slot, void *ptr)
+{
+    if (slot < 0 || slot >= ARENA_SLOTS)
+        err_quit("invalid arena slot");
+
+    Arena *arena = current;
+    if (arena && arena->used[slot] && arena->blocks[slot] == ptr)
+        arena->used[slot] = 0;
+    else
+        free(ptr);
+}
@@ -471,12 +471,145 @@ size_t bitarrayreader_readInteger(BitArrayReader *src)
     int offset = 0;
     while (!end) {
         unsigned char byte = 0;
+        if (offset >= 64)
+            err_quit("integer too long in decodeLength");
         if (bitarrayreader_readByte(src, &byte) != 8)
             err_quit("failed to read byte in decodeLength");
-        ret |= (byte << offset);
+        ret |= ((size_t)byte << offset);
         offset += 8;
         if (bitarrayreader_readBit(src, &end) != 1)
             err_quit("failed to read bit in decodeLength");
     }
     return ret;
 }
+
+/**
+ * Append up to 32 bits to BitArray in one go. Bits are taken from the least
+ * significant end of the value, so the first bit appended is bit 0.
+ * @param dst the BitArray to modify
+ * @param bits the bits to append
+ * @param count the amount of bits to append
+ */
+void bitarray_appendBits(BitArray *dst, uint32_t bits, int count)
+{
+    if (!dst)
+        err_quit("null pointer when appending bits to BitArray");
+    if (count < 0 || count > 32)
+        err_quit("invalid bit count when appending bits to BitArray");
+
+    while (count > 0) {
+        int offset = dst->len % 8;
+        int n = 8 - offset < count ? 8 - offset : count;
+        // make sure the byte being written to exists
+        while (dst->data->len <= dst->len / 8)
+            buffer_pad(dst->data, 1);
+        dst->data->data[dst->len / 8] |= (bits & ((1u << n) - 1)) << offset;
+        bits = n < 32 ? bits >> n : 0;
+        count -= n;
+        dst->len += n;
+    }
+}
+
+/**
+ * Look at the next bits in the BitArray without moving the reader. Bits past
+ * the end of the array are read as zeroes.
+ * @param reader the reader to use
+ * @param count the amount of bits to look at, at most 32
+ * @return the bits, first bit in the least significant position
+ */
+uint32_t bitarrayreader_peekBits(BitArrayReader *br, int count)
+{
+    if (!br)
+        err_quit("null pointer accessing bitarrayreader");
+    if (count < 0 || count > 32)
+        err_quit("invalid bit count when reading bits from BitArray");
+
+    size_t byte = br->pos / 8;
+    int offset = br->pos % 8;
+    size_t end = (br->data->len + 7) / 8;
+    uint64_t window = 0;
+    for (int i = 0; i * 8 < offset + count && byte + i < end; i++)
+        window |= (uint64_t) br->data->data->data[byte + i] << (8 * i);
+    return (window >> offset) & (((uint64_t) 1 << count) - 1);
+}
+
+/**
+ * Read up to 32 bits from the BitArray, first bit in the least significant
+ * position.
+ * @param reader the reader to use
+ * @param count the amount of bits to read
+ * @param dst pointer to the destination integer
+ * @return amount of bits read; count if read succeeded, -1 otherwise
+ */
+int bitarrayreader_readBits(BitArrayReader *br, int count, uint32_t *dst)
+{
+    if (!br || !dst)
+        err_quit("null pointer accessing bitarrayreader");
+    if (br->pos + count > br->data->len)
+        return -1;
+
+    *dst = bitarrayreader_peekBits(br, count);
+    br->pos += count;
+    return count;
+}
+
+/**
+ * Encode a positive integer using the Elias gamma code: n zero bits followed
+ * by the n + 1 bit value, where n is the position of its highest set bit.
+ * Small values take few bits, 1 takes a single bit.
+ * @param dst destination BitArray
+ * @param val the value to encode, at least 1
+ */
+void bitarray_writeGamma(BitArray *dst, size_t val)
+{
+    if (val == 0)
+        err_quit("zero can not be gamma coded");
+
+    int n = bitarray_gammaLength(val) / 2;
+    for (int i = n; i > 0; i -= 32)
+        bitarray_appendBits(dst, 0, i < 32 ? i : 32);
+    bitarray_appendBits(dst, 1, 1);
+    for (int i = 0; i < n; i += 32)
+        bitarray_appendBits(dst, (val >> i) & 0xffffffff, n - i < 32 ? n - i : 32);
+}
+
+/**
+ * Decode an Elias gamma coded integer.
+ * @param src source BitArray
+ * @return the integer that was read
+ */
+size_t bitarrayreader_readGamma(BitArrayReader *src)
+{
+    int n = 0;
+    int bit = 0;
+    for (;;) {
+        if (bitarrayreader_readBit(src, &bit) != 1)
+            err_quit("failed to read bit in readGamma");
+        if (bit)
+            break;
+        if (++n >= (int) (sizeof(size_t) * 8))
+            err_quit("gamma code too long");
+    }
+    size_t ret = (size_t) 1 << n;
+    for (int i = 0; i < n; i += 32) {
+        uint32_t bits = 0;
+        int count = n - i < 32 ? n - i : 32;
+        if (bitarrayreader_readBits(src, count, &bits) != count)
+            err_quit("failed to read bits in readGamma");
+        ret |= (size_t) bits << i;
+    }
+    return ret;
+}
+
+/**
+ * Calculate the length of the Elias gamma code of an integer.
+ * @param val the value, at least 1
+ * @return amount of bits written by bitarray_writeGamma
+ */
+size_t bitarray_gammaLength(size_t val)
+{
+    int n = 0;
+    while (val >> (n + 1))
+        n++;
+    return 2 * n + 1;
+}
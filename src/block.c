@@ -0,0 +1,290 @@
+#include "../include/block.h"
+#include "../include/block_private.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+
+/**
+ * Compress a Buffer in blocks of BLOCK_SIZE bytes, each with the given
+ * algorithm as if it was a file of its own. The blocks are divided among the
+ * threads and written in order after a header: the decoded length, the block
+ * size, the history size, the amount of blocks and a table of the decoded and
+ * the compressed size of each block, as variable length integers. With the
+ * table, the place of every block is known before any of them is decoded.
+ * @param src the source Buffer
+ * @param compress the algorithm to compress each block with
+ * @param pool the ThreadPool to run on
+ * @return the compressed blocks
+ */
+Buffer *block_compress(Buffer *src, BlockCodec compress, ThreadPool *pool)
+{
+    if (!src || !compress || !pool)
+        err_quit("null pointer in block_compress");
+
+    BlockJob job = {compress, NULL, 0, src, BLOCK_SIZE};
+    return compressBlocks(&job, pool);
+}
+
+/**
+ * Compress a Buffer in blocks like block_compress, but give each block the
+ * bytes before it as history, so that references can cross the boundary
+ * with the previous block as if the input was compressed in one piece. The
+ * blocks are still compressed concurrently, as the history is part of the
+ * input. Decoding a block needs the end of the previous one, though, so the
+ * blocks are extracted in order. The first block gets no history, so it may
+ * use the preset dictionary.
+ * @param src the source Buffer
+ * @param compress the algorithm to compress each block with
+ * @param history the amount of bytes before each block to give as history
+ * @param pool the ThreadPool to run on
+ * @return the compressed blocks
+ */
+Buffer *block_compressPrimed(Buffer *src, PrimedCodec compress, size_t history, ThreadPool *pool)
+{
+    if (!src || !compress || !pool)
+        err_quit("null pointer in block_compressPrimed");
+
+    BlockJob job = {NULL, compress, history, src, BLOCK_SIZE};
+    return compressBlocks(&job, pool);
+}
+
+/**
+ * Compress a Buffer as a single block on the calling thread, for output in
+ * the block format of input that is not split.
+ * @param src the source Buffer
+ * @param compress the algorithm to compress with
+ * @return the compressed block
+ */
+Buffer *block_compressWhole(Buffer *src, BlockCodec compress)
+{
+    if (!src || !compress)
+        err_quit("null pointer in block_compressWhole");
+
+    BlockJob job = {compress, NULL, 0, src, src->len > 0 ? src->len : 1};
+    return compressBlocks(&job, NULL);
+}
+
+/**
+ * Compress the blocks of a job and write them after the header. The history
+ * size is zero if the blocks are independent.
+ * @param job the BlockJob, without results
+ * @param pool the ThreadPool to run on, NULL to compress on the calling thread
+ * @return the compressed blocks
+ */
+Buffer *compressBlocks(BlockJob *job, ThreadPool *pool)
+{
+    Buffer *src = job->src;
+    size_t count = (src->len + job->blockSize - 1) / job->blockSize;
+    job->results = mcalloc(count + 1, sizeof(Buffer *));
+    if (pool) {
+        threadpool_run(pool, count, compressBlock, job);
+    } else {
+        for (size_t i = 0; i < count; i++)
+            compressBlock(job, i);
+    }
+
+    Buffer *ret = new_buffer();
+    buffer_appendVarint(ret, src->len);
+    buffer_appendVarint(ret, job->blockSize);
+    buffer_appendVarint(ret, job->history);
+    buffer_appendVarint(ret, count);
+    for (size_t i = 0; i < count; i++) {
+        size_t start = i * job->blockSize;
+        buffer_appendVarint(ret, src->len - start < job->blockSize ? src->len - start : job->blockSize);
+        buffer_appendVarint(ret, job->results[i]->len);
+    }
+    for (size_t i = 0; i < count; i++) {
+        buffer_append(ret, job->results[i]->data, job->results[i]->len);
+        delete_buffer(job->results[i]);
+    }
+    free(job->results);
+    if (pool)
+        fprintf(stderr, "compressed %lu blocks on %d threads\n", count, pool->threads);
+    return ret;
+}
+
+/**
+ * Task function: compress one block of a job.
+ * @param job the BlockJob
+ * @param index the block to compress
+ */
+void compressBlock(void *job, size_t index)
+{
+    BlockJob *j = job;
+    size_t start = j->first + index * j->blockSize;
+    size_t len = j->src->len - start < j->blockSize ? j->src->len - start : j->blockSize;
+    // the codecs only read their input, so the block is used in place
+    Buffer block = {len, len, j->src->data + start};
+    if (!j->primed) {
+        j->results[index] = j->codec(&block);
+        return;
+    }
+    size_t reach = start < j->history ? start : j->history;
+    Buffer history = {reach, reach, j->src->data + start - reach};
+    j->results[index] = j->primed(&block, reach > 0 ? &history : NULL);
+}
+
+/**
+ * Read the header and the table of compressed blocks and check that they
+ * match the input.
+ * @param src compressed input
+ * @return the BlockTable
+ */
+BlockTable *block_readTable(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in block_readTable");
+
+    BlockTable *table = mcalloc(1, sizeof(BlockTable));
+    BufferReader *reader = buffer_createReader(src);
+    if (bufferreader_readVarint(reader, &table->decodedLength) < 1
+            || bufferreader_readVarint(reader, &table->blockSize) < 1 || table->blockSize == 0
+            || bufferreader_readVarint(reader, &table->history) < 1
+            || bufferreader_readVarint(reader, &table->count) < 1 || table->count > src->len)
+        err_quit("failed to read block header");
+    table->offsets = mmalloc((table->count + 1) * sizeof(size_t));
+    table->starts = mmalloc((table->count + 1) * sizeof(size_t));
+    size_t total = 0, decoded = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        size_t length, size;
+        if (bufferreader_readVarint(reader, &length) < 1 || length > table->blockSize
+                || length > table->decodedLength - decoded
+                || bufferreader_readVarint(reader, &size) < 1 || size > src->len)
+            err_quit("failed to read block header");
+        table->starts[i] = decoded;
+        table->offsets[i] = total;
+        decoded += length;
+        total += size;
+    }
+    if (decoded != table->decodedLength)
+        err_quit("block lengths do not match the decoded length");
+    if (total != src->len - reader->pos)
+        err_quit("block sizes do not match the input");
+    for (size_t i = 0; i < table->count; i++)
+        table->offsets[i] += reader->pos;
+    table->offsets[table->count] = src->len;
+    table->starts[table->count] = decoded;
+    delete_bufferreader(reader);
+    return table;
+}
+
+/**
+ * Frees a BlockTable.
+ * @param table the BlockTable to delete
+ */
+void delete_blocktable(BlockTable *table)
+{
+    if (!table)
+        err_quit("null pointer when deleting block table");
+
+    free(table->offsets);
+    free(table->starts);
+    free(table);
+}
+
+/**
+ * Decode one block of compressed input and skip the others, which the table
+ * allows for independent blocks.
+ * @param src compressed input
+ * @param table the BlockTable of the input
+ * @param index the block to decode
+ * @param extract the algorithm the blocks were compressed with
+ * @return the decoded block
+ */
+Buffer *block_extractBlock(Buffer *src, BlockTable *table, size_t index, BlockCodec extract)
+{
+    if (!src || !table || !extract)
+        err_quit("null pointer in block_extractBlock");
+    if (index >= table->count)
+        err_quit("no such block");
+    if (table->history > 0 && index > 0)
+        err_quit("the block refers to the ones before it, which have to be decoded first");
+
+    ExtractJob job = {extract, NULL, src, table, NULL};
+    return decodeBlock(&job, index);
+}
+
+/**
+ * Decompress a Buffer compressed by block_compress, block_compressPrimed or
+ * block_compressWhole. The output is allocated at once and each block is
+ * copied into its place as it is decoded, or returned as it is if there is
+ * only one; the codecs allocate their own output, so they can't decode into
+ * the output directly.
+ * Independent blocks are divided among the threads, while blocks with
+ * history are decoded in order, as each one needs the end of the previous.
+ * @param src compressed input
+ * @param extract the algorithm the blocks were compressed with
+ * @param primedExtract the same for blocks with history, NULL if the
+ * algorithm does not support it
+ * @param pool the ThreadPool to decode independent blocks on, NULL to decode
+ * them on the calling thread
+ * @return decompressed Buffer
+ */
+Buffer *block_extract(Buffer *src, BlockCodec extract, PrimedCodec primedExtract, ThreadPool *pool)
+{
+    if (!src || !extract)
+        err_quit("null pointer in block_extract");
+
+    BlockTable *table = block_readTable(src);
+    if (table->history > 0 && !primedExtract)
+        err_quit("blocks refer to each other, which the algorithm does not support");
+
+    ExtractJob job = {extract, primedExtract, src, table, NULL};
+    Buffer *ret;
+    if (table->count == 1) {
+        // a single block is returned as it is decoded, without copying it into place
+        ret = decodeBlock(&job, 0);
+    } else {
+        ret = new_buffer();
+        buffer_pad(ret, table->decodedLength);
+        job.dst = ret;
+        if (table->history > 0 || !pool) {
+            for (size_t i = 0; i < table->count; i++)
+                extractBlock(&job, i);
+        } else {
+            threadpool_run(pool, table->count, extractBlock, &job);
+        }
+    }
+    delete_blocktable(table);
+    return ret;
+}
+
+/**
+ * Task function: decode one block of a job and copy it into its place in
+ * the output.
+ * @param job the ExtractJob
+ * @param index the block to decode
+ */
+void extractBlock(void *job, size_t index)
+{
+    ExtractJob *j = job;
+    Buffer *decoded = decodeBlock(j, index);
+    memcpy(j->dst->data + j->table->starts[index], decoded->data, decoded->len);
+    delete_buffer(decoded);
+}
+
+/**
+ * Decode one block of a job and check its length. A block with history is
+ * given the end of the output before it, which must be decoded by then.
+ * @param job the ExtractJob
+ * @param index the block to decode
+ * @return the decoded block
+ */
+Buffer *decodeBlock(ExtractJob *job, size_t index)
+{
+    BlockTable *table = job->table;
+    size_t size = table->offsets[index + 1] - table->offsets[index];
+    Buffer block = {size, size, job->src->data + table->offsets[index]};
+    size_t start = table->starts[index];
+    Buffer *decoded;
+    if (table->history > 0 && start > 0) {
+        size_t reach = start < table->history ? start : table->history;
+        Buffer previous = {reach, reach, job->dst->data + start - reach};
+        decoded = job->primed(&block, &previous);
+    } else {
+        // without history before it, a primed block decodes like any other
+        decoded = job->codec(&block);
+    }
+    if (decoded->len != table->starts[index + 1] - start)
+        err_quit("block decoded to the wrong length");
+    return decoded;
+}
@@ -1,7 +1,9 @@
 #include "../include/buffer.h"
 #include "../include/ealloc.h"
+#include <stdint.h>
 
 void buffer_resize(Buffer *buf, size_t new_size);
+void buffer_reserve(Buffer *buf, size_t len);
 
 /**
  * Create an empty buffer with a BUFSIZE initial size
@@ -72,17 +74,33 @@ void buffer_pad(Buffer *buf, size_t len)
     if (!buf)
         err_quit("null pointer when resizing buffer");
 
-    size_t newSize = buf->size;
-    while (buf->len + len > newSize)
-        newSize *= 2;
-
-    if (newSize > buf->size) {
-        buffer_resize(buf, newSize);
-    }
+    buffer_reserve(buf, len);
     memset(buf->data + buf->len, 0, len);
     buf->len += len;
 }
 
+/**
+ * Pad a Buffer that is being decoded into. The Buffer doubles each time, up
+ * to the decoded length, so it only grows as fast as the input decodes.
+ * @param buf the buffer to modify
+ * @param len the least amount of bytes to append
+ * @param limit the length the buffer may grow to
+ */
+void buffer_grow(Buffer *buf, size_t len, size_t limit)
+{
+    if (!buf)
+        err_quit("null pointer when resizing buffer");
+    if (len > limit - buf->len)
+        err_quit("buffer grows past its limit");
+
+    size_t grow = buf->len > BUFSIZE ? buf->len : BUFSIZE;
+    if (grow < len)
+        grow = len;
+    if (grow > limit - buf->len)
+        grow = limit - buf->len;
+    buffer_pad(buf, grow);
+}
+
 /**
  * Truncate Buffer to only the last character. Useful when looking ahead in
  * another data set.
@@ -111,17 +129,32 @@ void buffer_append(Buffer *dest, unsigned char *src, size_t len)
     if (!dest || !src)
         err_quit("null pointer when appending to buffer");
 
-    size_t newSize = dest->size;
-    while (dest->len + len > newSize)
-        newSize *= 2;
-
-    if (newSize > dest->size)
-        buffer_resize(dest, newSize);
-
+    buffer_reserve(dest, len);
     memcpy(dest->data + dest->len, src, len);
     dest->len += len;
 }
 
+/**
+ * Make room for more bytes at the end of a Buffer. The size is doubled until
+ * it is BUFFER_MAX_GROWTH, and grows by that much after, so that a large
+ * buffer does not take up to twice the memory it needs.
+ * @param buf the Buffer
+ * @param len the amount of bytes to make room for
+ */
+void buffer_reserve(Buffer *buf, size_t len)
+{
+    if (len > SIZE_MAX - buf->len)
+        err_quit("buffer too large");
+
+    size_t newSize = buf->size;
+    while (buf->len + len > newSize) {
+        size_t growth = newSize < BUFFER_MAX_GROWTH ? newSize : BUFFER_MAX_GROWTH;
+        newSize = newSize > SIZE_MAX - growth ? SIZE_MAX : newSize + growth;
+    }
+    if (newSize > buf->size)
+        buffer_resize(buf, newSize);
+}
+
 void buffer_resize(Buffer *buf, size_t newSize)
 {
     if (!buf)
@@ -188,3 +221,47 @@ int bufferreader_isFinal(BufferReader *reader)
 
     return reader->pos >= reader->data->len;
 }
+
+/**
+ * Append an unsigned integer in variable length format: 7 bits per byte,
+ * least significant bits first, high bit set on every byte but the last.
+ * @param dst the destination Buffer
+ * @param val the integer to append
+ */
+void buffer_appendVarint(Buffer *dst, size_t val)
+{
+    if (!dst)
+        err_quit("null pointer when appending integer to buffer");
+
+    unsigned char byte;
+    while (val >= 0x80) {
+        byte = (val & 0x7f) | 0x80;
+        buffer_append(dst, &byte, 1);
+        val >>= 7;
+    }
+    byte = val;
+    buffer_append(dst, &byte, 1);
+}
+
+/**
+ * Read an unsigned integer written by buffer_appendVarint.
+ * @param reader the reader to use
+ * @param dst pointer to the destination integer
+ * @return number of bytes read, -1 if the input ended or the integer is too long
+ */
+int bufferreader_readVarint(BufferReader *reader, size_t *dst)
+{
+    if (!reader || !dst)
+        err_quit("null pointer on bufferreader_readVarint");
+
+    size_t val = 0;
+    for (int i = 0; reader->pos < reader->data->len && 7 * i < 64; i++) {
+        unsigned char byte = reader->data->data[reader->pos++];
+        val |= (size_t)(byte & 0x7f) << (7 * i);
+        if (!(byte & 0x80)) {
+            *dst = val;
+            return i + 1;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,96 @@
+#include "../include/chunkqueue.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+void waitForQueue(int *tries);
+
+/**
+ * Creates an empty queue.
+ * @param capacity the amount of chunks the queue holds at most
+ * @return the newly created ChunkQueue
+ */
+ChunkQueue *new_chunkqueue(size_t capacity)
+{
+    if (capacity == 0)
+        err_quit("invalid chunk queue capacity");
+
+    ChunkQueue *ret = mmalloc(sizeof(ChunkQueue));
+    ret->slots = mcalloc(capacity, sizeof(void *));
+    ret->capacity = capacity;
+    atomic_init(&ret->head, 0);
+    atomic_init(&ret->tail, 0);
+    return ret;
+}
+
+/**
+ * Frees a queue. Chunks left in it are not freed.
+ * @param queue the ChunkQueue to delete
+ */
+void delete_chunkqueue(ChunkQueue *queue)
+{
+    if (!queue)
+        err_quit("null pointer when deleting chunk queue");
+
+    free(queue->slots);
+    free(queue);
+}
+
+/**
+ * Put a chunk in the queue, waiting while it is full. Only one thread may
+ * push to a queue.
+ * @param queue the ChunkQueue
+ * @param chunk the chunk, NULL to mark the end of the data
+ */
+void chunkqueue_push(ChunkQueue *queue, void *chunk)
+{
+    if (!queue)
+        err_quit("null pointer pushing to chunk queue");
+
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    int tries = 0;
+    while (tail - atomic_load_explicit(&queue->head, memory_order_acquire) == queue->capacity)
+        waitForQueue(&tries);
+    queue->slots[tail % queue->capacity] = chunk;
+    // publishes the slot to the consumer
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Take the oldest chunk from the queue, waiting while it is empty. Only one
+ * thread may pop from a queue.
+ * @param queue the ChunkQueue
+ * @return the chunk, NULL at the end of the data
+ */
+void *chunkqueue_pop(ChunkQueue *queue)
+{
+    if (!queue)
+        err_quit("null pointer popping from chunk queue");
+
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    int tries = 0;
+    while (atomic_load_explicit(&queue->tail, memory_order_acquire) == head)
+        waitForQueue(&tries);
+    void *chunk = queue->slots[head % queue->capacity];
+    // hands the slot back to the producer
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return chunk;
+}
+
+/**
+ * Let the other side of a queue run: yield for the first tries, as a chunk
+ * is often about to arrive, then sleep so that a stage waiting for a much
+ * slower one does not keep a core busy.
+ * @param tries amount of tries so far, incremented
+ */
+void waitForQueue(int *tries)
+{
+    if ((*tries)++ < CHUNKQUEUE_SPINS) {
+        sched_yield();
+        return;
+    }
+    struct timespec delay = {0, 100000};
+    nanosleep(&delay, NULL);
+}
@@ -0,0 +1,49 @@
+#include "../include/container.h"
+#include "../include/error.h"
+
+/**
+ * Append a container header to a Buffer.
+ * @param dst the destination Buffer
+ * @param header the ContainerHeader to write
+ */
+void container_writeHeader(Buffer *dst, ContainerHeader *header)
+{
+    if (!dst || !header)
+        err_quit("null pointer writing container header");
+    if (header->algorithm < 0 || header->algorithm > 0xff)
+        err_quit("invalid algorithm ID");
+
+    unsigned char bytes[CONTAINER_HEADER_SIZE] = {0};
+    memcpy(bytes, CONTAINER_MAGIC, CONTAINER_MAGIC_SIZE);
+    bytes[4] = CONTAINER_VERSION;
+    bytes[5] = header->algorithm;
+    bytes[6] = header->distanceBits;
+    bytes[7] = header->lengthBits;
+    bytes[8] = header->flags;
+    buffer_append(dst, bytes, CONTAINER_HEADER_SIZE);
+}
+
+/**
+ * Read a container header from the start of the input. Input that does not
+ * start with the magic number is not a container, such as the raw output of
+ * an algorithm, and is left to the caller.
+ * @param src the input
+ * @param len length of the input
+ * @param header destination for the fields of the header
+ * @return size of the header, 0 if the input is not a container
+ */
+size_t container_readHeader(unsigned char *src, size_t len, ContainerHeader *header)
+{
+    if (!src || !header)
+        err_quit("null pointer reading container header");
+    if (len < CONTAINER_HEADER_SIZE || memcmp(src, CONTAINER_MAGIC, CONTAINER_MAGIC_SIZE) != 0)
+        return 0;
+    if (src[4] != CONTAINER_VERSION)
+        err_quit("unsupported container version");
+
+    header->algorithm = src[5];
+    header->distanceBits = src[6];
+    header->lengthBits = src[7];
+    header->flags = src[8];
+    return CONTAINER_HEADER_SIZE;
+}
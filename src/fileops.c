@@ -1,4 +1,10 @@
 #include "../include/fileops.h"
+#include "../include/ealloc.h"
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+
+int compareNames(const void *a, const void *b);
 
 Buffer *readFile(char *filename)
 {
@@ -6,43 +12,98 @@ Buffer *readFile(char *filename)
      * create buffer and read file specified by filename to buffer
      */
     Buffer *ret = new_buffer();
-    int fd = 0; // setting stdin as default file descriptor
-    if (strcmp(filename, "-") != 0) {
-        fd = open(filename, O_RDONLY);
-        if (fd <= 2)
-            err_quit("failed to open file for reading");
-    }
-
-    unsigned char buf[READBUF];
-    size_t len;
-    do { // read READBUF bytes at a time
-        len = read(fd, buf, READBUF);
-        buffer_append(ret, buf, len);
-    } while (len == READBUF); // stop when less than READBUF bytes are retrieved
+    int fd = openInput(filename);
+    readInto(fd, ret);
     if (fd > 2)
         close(fd);
 
     return ret;
 }
 
+void readInto(int fd, Buffer *dst)
+{
+    /*
+     * append the rest of an open file descriptor to buffer dst
+     */
+    unsigned char buf[READBUF];
+    ssize_t len;
+    // read READBUF bytes at a time, pipes may return less before the end
+    while ((len = read(fd, buf, READBUF)) > 0)
+        buffer_append(dst, buf, len);
+    if (len < 0)
+        err_quit("reading from file failed");
+}
+
+size_t readUpTo(int fd, Buffer *dst, size_t count)
+{
+    /*
+     * append up to count bytes of an open file descriptor to buffer dst,
+     * fewer only at the end of the file
+     */
+    unsigned char buf[READBUF];
+    size_t total = 0;
+    ssize_t len = 1;
+    while (total < count && len > 0) {
+        len = read(fd, buf, MIN(READBUF, count - total));
+        if (len < 0)
+            err_quit("reading from file failed");
+        buffer_append(dst, buf, len);
+        total += len;
+    }
+    return total;
+}
+
 void writeFile(Buffer *src, char *filename)
 {
     /*
      * write buffer src to file specified by filename
      */
-    int fd = 1; // setting stdout as default file descriptor
     if (!src) {
         err_quit("null pointer passed to writeFile");
     }
+    int fd = openOutput(filename);
+    if (src->len == 0) {
+        err_quit("buffer is empty, skipping write");
+    }
+    fprintf(stderr, "writing %ld bytes\n", src->len);
+    writeBuffer(src, fd);
+    if (fd > 2)
+        close(fd);
+}
+
+int openInput(char *filename)
+{
+    /*
+     * open file specified by filename for reading, - for stdin
+     */
+    int fd = 0; // setting stdin as default file descriptor
+    if (strcmp(filename, "-") != 0) {
+        fd = open(filename, O_RDONLY);
+        if (fd <= 2)
+            err_quit("failed to open file for reading");
+    }
+    return fd;
+}
+
+int openOutput(char *filename)
+{
+    /*
+     * create or truncate file specified by filename for writing, - for stdout
+     */
+    int fd = 1; // setting stdout as default file descriptor
     if (strcmp(filename, "-") != 0) {
         fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
         if (fd <= 2)
             err_quit("failed to open file for writing");
     }
-    if (src->len == 0) {
-        err_quit("buffer is empty, skipping write");
-    }
-    fprintf(stderr, "writing %ld bytes\n", src->len);
+    return fd;
+}
+
+void writeBuffer(Buffer *src, int fd)
+{
+    /*
+     * write the contents of buffer src to an open file descriptor
+     */
     unsigned char *ptr = src->data; // use a pointer to move in the buffer
     unsigned char *endptr = src->data + src->len;
     while (ptr < endptr) {
@@ -51,6 +112,49 @@ void writeFile(Buffer *src, char *filename)
             err_quit("writing to file failed");
         ptr += READBUF;
     }
-    if (fd > 2)
-        close(fd);
+}
+
+Buffer **readDirectory(char *path, size_t *count)
+{
+    /*
+     * read every regular file in directory path to a buffer, in order of
+     * file name
+     */
+    DIR *dir = opendir(path);
+    if (!dir)
+        err_quit("failed to open directory for reading");
+
+    size_t n = 0, capacity = 16;
+    char **names = mmalloc(capacity * sizeof(char *));
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char *name = mmalloc(strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(name, "%s/%s", path, entry->d_name);
+        struct stat st;
+        if (stat(name, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(name);
+            continue;
+        }
+        if (n == capacity) {
+            capacity *= 2;
+            names = mrealloc(names, capacity * sizeof(char *));
+        }
+        names[n++] = name;
+    }
+    closedir(dir);
+    qsort(names, n, sizeof(char *), compareNames);
+
+    Buffer **ret = mmalloc((n > 0 ? n : 1) * sizeof(Buffer *));
+    for (size_t i = 0; i < n; i++) {
+        ret[i] = readFile(names[i]);
+        free(names[i]);
+    }
+    free(names);
+    *count = n;
+    return ret;
+}
+
+int compareNames(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
 }
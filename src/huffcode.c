@@ -0,0 +1,325 @@
+#include "../include/huffcode.h"
+#include "../include/huffnode.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <stdint.h>
+#include <string.h>
+
+int measureDepths(HuffNode *node, unsigned char *lengths, int depth);
+uint32_t reverseBits(uint32_t code, int length);
+
+/**
+ * Allocates an empty canonical Huffman code table.
+ * @param symbols size of the alphabet
+ * @return the newly created HuffCode
+ */
+HuffCode *new_huffcode(size_t symbols)
+{
+    if (symbols == 0 || symbols > 0xfff)
+        err_quit("unsupported alphabet size for Huffman code");
+
+    HuffCode *ret = mmalloc(sizeof(HuffCode));
+    ret->symbols = symbols;
+    ret->lengths = mcalloc(symbols, sizeof(unsigned char));
+    ret->codes = mcalloc(symbols, sizeof(uint32_t));
+    ret->sorted = mcalloc(symbols, sizeof(uint16_t));
+    ret->lookup = mcalloc(1 << HUFFCODE_LOOKUP_BITS, sizeof(uint16_t));
+    memset(ret->counts, 0, sizeof(ret->counts));
+    ret->single = -1;
+    return ret;
+}
+
+/**
+ * Frees memory allocated for HuffCode.
+ * @param code the HuffCode to delete
+ */
+void delete_huffcode(HuffCode *code)
+{
+    if (!code)
+        err_quit("null pointer when deleting HuffCode");
+
+    free(code->lengths);
+    free(code->codes);
+    free(code->sorted);
+    free(code->lookup);
+    free(code);
+}
+
+/**
+ * Build a length-limited canonical code from symbol frequencies. A Huffman
+ * tree is built first; if it is deeper than HUFFCODE_MAX_LENGTH, the
+ * frequencies are flattened and the tree is rebuilt until it fits.
+ * @param code the HuffCode to initialize
+ * @param freqs frequency of each symbol, code->symbols entries
+ */
+void huffcode_fromFrequencies(HuffCode *code, size_t *freqs)
+{
+    if (!code || !freqs)
+        err_quit("null pointer building Huffman code");
+
+    unsigned char *lengths = mcalloc(code->symbols, sizeof(unsigned char));
+    size_t *scaled = mmalloc(code->symbols * sizeof(size_t));
+    memcpy(scaled, freqs, code->symbols * sizeof(size_t));
+    for (;;) {
+        memset(lengths, 0, code->symbols);
+        HuffNode *tree = huffnode_buildTree(scaled, code->symbols);
+        int depth = 0;
+        if (tree) {
+            if (huffnode_isLeaf(tree))
+                lengths[tree->value] = 1; // a lone symbol still needs a length
+            else
+                depth = measureDepths(tree, lengths, 0);
+            delete_huffnode(tree);
+        }
+        if (depth <= HUFFCODE_MAX_LENGTH)
+            break;
+        // halve the frequencies, keeping every used symbol nonzero
+        for (size_t i = 0; i < code->symbols; i++)
+            scaled[i] = (scaled[i] + 1) / 2;
+    }
+    huffcode_fromLengths(code, lengths);
+    free(scaled);
+    free(lengths);
+}
+
+/**
+ * Store the depth of each leaf of a Huffman tree as the code length of its
+ * symbol.
+ * @param node the tree to traverse
+ * @param lengths the destination length table
+ * @param depth current depth
+ * @return depth of the deepest leaf
+ */
+int measureDepths(HuffNode *node, unsigned char *lengths, int depth)
+{
+    if (huffnode_isLeaf(node)) {
+        lengths[node->value] = depth > 0xff ? 0xff : depth;
+        return depth;
+    }
+    int left = measureDepths(node->left, lengths, depth + 1);
+    int right = measureDepths(node->right, lengths, depth + 1);
+    return left > right ? left : right;
+}
+
+/**
+ * Reverse the order of the lowest bits of a code.
+ * @param code the code to reverse
+ * @param length amount of bits in the code
+ * @return the reversed code
+ */
+uint32_t reverseBits(uint32_t code, int length)
+{
+    uint32_t ret = 0;
+    for (int i = 0; i < length; i++) {
+        ret = (ret << 1) | (code & 1);
+        code >>= 1;
+    }
+    return ret;
+}
+
+/**
+ * Assign canonical codes to symbols using their code lengths and build the
+ * decoding tables. Codes are assigned in order of length, and symbols of the
+ * same length in order of value, as in DEFLATE.
+ * @param code the HuffCode to initialize
+ * @param lengths code length of each symbol, code->symbols entries
+ */
+void huffcode_fromLengths(HuffCode *code, unsigned char *lengths)
+{
+    if (!code || !lengths)
+        err_quit("null pointer building Huffman code");
+
+    memset(code->counts, 0, sizeof(code->counts));
+    code->single = -1;
+    size_t used = 0;
+    for (size_t i = 0; i < code->symbols; i++) {
+        if (lengths[i] > HUFFCODE_MAX_LENGTH)
+            err_quit("Huffman code length out of range");
+        code->lengths[i] = lengths[i];
+        if (lengths[i] > 0) {
+            code->counts[lengths[i]]++;
+            code->single = i;
+            used++;
+        }
+    }
+    if (used != 1)
+        code->single = -1;
+
+    // check that the lengths make up a valid prefix code
+    long left = 1;
+    for (int len = 1; len <= HUFFCODE_MAX_LENGTH; len++) {
+        left <<= 1;
+        left -= code->counts[len];
+        if (left < 0)
+            err_quit("invalid Huffman code lengths");
+    }
+
+    // first code and first sorted index of each length
+    uint32_t next[HUFFCODE_MAX_LENGTH + 1] = {0};
+    size_t offsets[HUFFCODE_MAX_LENGTH + 1] = {0};
+    uint32_t c = 0;
+    for (int len = 1; len <= HUFFCODE_MAX_LENGTH; len++) {
+        c = (c + (len > 1 ? code->counts[len - 1] : 0)) << 1;
+        next[len] = c;
+        if (len > 1)
+            offsets[len] = offsets[len - 1] + code->counts[len - 1];
+    }
+    memset(code->lookup, 0, (1 << HUFFCODE_LOOKUP_BITS) * sizeof(uint16_t));
+    for (size_t i = 0; i < code->symbols; i++) {
+        int len = code->lengths[i];
+        if (len == 0)
+            continue;
+        code->codes[i] = reverseBits(next[len]++, len);
+        code->sorted[offsets[len]++] = i;
+        if (len <= HUFFCODE_LOOKUP_BITS) {
+            // every table index starting with the code decodes to the symbol
+            for (uint32_t k = code->codes[i]; k < (1 << HUFFCODE_LOOKUP_BITS); k += 1 << len)
+                code->lookup[k] = i << 4 | len;
+        }
+    }
+}
+
+/**
+ * Calculate the amount of bits needed to encode symbols using the code.
+ * @param code the code to use
+ * @param freqs frequency of each symbol
+ * @return amount of bits, SIZE_MAX if a symbol has no code
+ */
+size_t huffcode_cost(HuffCode *code, size_t *freqs)
+{
+    if (!code || !freqs)
+        err_quit("null pointer calculating Huffman code cost");
+
+    size_t total = 0;
+    for (size_t i = 0; i < code->symbols; i++) {
+        if (freqs[i] == 0)
+            continue;
+        if (code->lengths[i] == 0)
+            return SIZE_MAX;
+        if (code->single < 0)
+            total += freqs[i] * code->lengths[i];
+    }
+    return total;
+}
+
+/**
+ * Calculate the size of the serialized code lengths.
+ * @param code the code to serialize
+ * @return amount of bits written by huffcode_writeLengths
+ */
+size_t huffcode_tableCost(HuffCode *code)
+{
+    if (!code)
+        err_quit("null pointer calculating Huffman table cost");
+
+    size_t total = 0;
+    for (size_t i = 0; i < code->symbols;) {
+        size_t run = 1;
+        while (i + run < code->symbols && code->lengths[i + run] == code->lengths[i])
+            run++;
+        total += HUFFCODE_LENGTH_BITS + bitarray_gammaLength(run);
+        i += run;
+    }
+    return total;
+}
+
+/**
+ * Serialize code lengths. Lengths are written as runs of equal values: the
+ * 4-bit length followed by the gamma coded length of the run. Unused symbols
+ * form long runs of zeroes, so sparse alphabets take little space.
+ * @param code the code to serialize
+ * @param dst destination BitArray
+ */
+void huffcode_writeLengths(HuffCode *code, BitArray *dst)
+{
+    if (!code || !dst)
+        err_quit("null pointer writing Huffman code lengths");
+
+    for (size_t i = 0; i < code->symbols;) {
+        size_t run = 1;
+        while (i + run < code->symbols && code->lengths[i + run] == code->lengths[i])
+            run++;
+        bitarray_appendBits(dst, code->lengths[i], HUFFCODE_LENGTH_BITS);
+        bitarray_writeGamma(dst, run);
+        i += run;
+    }
+}
+
+/**
+ * Deserialize code lengths written by huffcode_writeLengths and rebuild the
+ * code from them.
+ * @param code the HuffCode to initialize
+ * @param src reader for the source BitArray
+ */
+void huffcode_readLengths(HuffCode *code, BitArrayReader *src)
+{
+    if (!code || !src)
+        err_quit("null pointer reading Huffman code lengths");
+
+    unsigned char *lengths = mmalloc(code->symbols);
+    for (size_t i = 0; i < code->symbols;) {
+        uint32_t length;
+        if (bitarrayreader_readBits(src, HUFFCODE_LENGTH_BITS, &length) < 1)
+            err_quit("unexpected end of file while reading Huffman code lengths");
+        size_t run = bitarrayreader_readGamma(src);
+        if (run > code->symbols - i)
+            err_quit("invalid Huffman code lengths");
+        memset(lengths + i, length, run);
+        i += run;
+    }
+    huffcode_fromLengths(code, lengths);
+    free(lengths);
+}
+
+/**
+ * Write the code of a symbol. Codes with a single symbol take no space.
+ * @param code the code to use
+ * @param dst destination BitArray
+ * @param symbol the symbol to encode
+ */
+void huffcode_encode(HuffCode *code, BitArray *dst, unsigned symbol)
+{
+    if (symbol >= code->symbols || code->lengths[symbol] == 0)
+        err_quit("invalid input, symbol has no Huffman code");
+    if (code->single >= 0)
+        return;
+    bitarray_appendBits(dst, code->codes[symbol], code->lengths[symbol]);
+}
+
+/**
+ * Read a symbol. Codes up to HUFFCODE_LOOKUP_BITS long are resolved with a
+ * single table lookup, longer ones by walking the canonical code bit by bit.
+ * @param code the code to use
+ * @param src reader for the source BitArray
+ * @return the decoded symbol, -1 on invalid code or end of input
+ */
+ssize_t huffcode_decode(HuffCode *code, BitArrayReader *src)
+{
+    if (code->single >= 0)
+        return code->single;
+
+    uint16_t entry = code->lookup[bitarrayreader_peekBits(src, HUFFCODE_LOOKUP_BITS)];
+    if (entry & 0xf) {
+        if (src->pos + (entry & 0xf) > src->data->len)
+            return -1;
+        src->pos += entry & 0xf;
+        return entry >> 4;
+    }
+
+    // long code: the first codes of each length are consecutive, so the code
+    // can be resolved by comparing it against the amount of codes per length
+    long c = 0, first = 0, index = 0;
+    for (int len = 1; len <= HUFFCODE_MAX_LENGTH; len++) {
+        int bit;
+        if (bitarrayreader_readBit(src, &bit) < 1)
+            return -1;
+        c |= bit;
+        long count = code->counts[len];
+        if (c - first < count)
+            return code->sorted[index + c - first];
+        index += count;
+        first = (first + count) << 1;
+        c <<= 1;
+    }
+    return -1;
+}
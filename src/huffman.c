@@ -3,52 +3,228 @@
 #include "../include/priorityqueue.h"
 #include "../include/huffnode.h"
 #include "../include/bitarray.h"
+#include "../include/huffcode.h"
+#include "../include/huffman_tables.h"
+#include <stdint.h>
 
 /**
  * compresses a Buffer using the Huffman algorithm.
- * 1. frequency counting:
- * 2. tree building and encoding
- *      - encode tree using depth first recursion:
- *      b:(cccccccc) where b is the leaf bit and c are character bits
+ * The input is split into blocks of HUFFMAN_BLOCK_SIZE bytes, each coded
+ * with the cheapest of its own canonical Huffman code, the previous block's
+ * code or one of the static tables:
+ * 1. frequency counting for the block
+ * 2. code building and table selection, see encodeHuffmanBlock
  * 3. character encoding
  * @param src the source buffer to compress
  * @return compressed version of the given buffer
  */
 Buffer *huffman_compress(Buffer *src)
 {
-    // building tree
     if (!src)
         err_quit("null pointer in huffman_compress");
     if (src->len == 0) {
         fputs("file is empty, skipping compression\n", stderr);
         return src;
     }
-    HuffNode *tree = buildHufftree(src);
 
-    // storing codes into a lookup table
-    BitArray *codes[MAX_LEAVES] = {NULL}; // Huffman coded characters
-    char code[MAX_LEAVES + 1] = {'\0'};
-    cacheHuffcodes(tree, codes, code, 0);
-
-    // encoding input data using Huffman coded characters
     BitArray *output = new_bitarray();
-    // encode unpacked length
+    // encode unpacked length and block size
     bitarray_writeInteger(output, src->len);
-    // encode tree
-    size_t diff = output->len;
-    huffnode_serialize(tree, output);
-    diff = output->len - diff;
-    fprintf(stderr, "size of serialized Huffman tree: %lu bits (%lu bytes)\n", diff, (diff - 1) / 8 + 1);
-    // encode payload
-    encodeHuffmanPayload(src, output, codes);
-
-    Buffer *ret = bitarray_deleteAndConvertToBuffer(output);
-    delete_huffnode(tree);
-    for (int i = 0; i < MAX_LEAVES; i++) {
-        if (codes[i])
-            delete_bitarray(codes[i]);
+    bitarray_writeInteger(output, HUFFMAN_BLOCK_SIZE);
+    // encode blocks
+    HuffCode *previous = NULL;
+    size_t tableBits = 0, blocks = 0;
+    size_t modes[HUFFMAN_TABLE_MODES] = {0};
+    for (size_t pos = 0; pos < src->len; pos += HUFFMAN_BLOCK_SIZE) {
+        size_t len = src->len - pos < HUFFMAN_BLOCK_SIZE ? src->len - pos : HUFFMAN_BLOCK_SIZE;
+        int mode;
+        tableBits += encodeHuffmanBlock(src->data + pos, len, output, &previous, &mode);
+        modes[mode]++;
+        blocks++;
+    }
+    fprintf(stderr, "size of Huffman tables: %lu bits (%lu bytes), %lu of %lu blocks reused previous table, %lu used a static table\n",
+            tableBits, (tableBits + 7) / 8, modes[HUFFMAN_TABLE_REUSE], blocks, modes[HUFFMAN_TABLE_STATIC]);
+
+    if (previous)
+        delete_huffcode(previous);
+    return bitarray_deleteAndConvertToBuffer(output);
+}
+
+/**
+ * Encode a block of input. The block header starts with the table mode:
+ * - HUFFMAN_TABLE_NEW: the code lengths of a new code follow
+ * - HUFFMAN_TABLE_REUSE: the last new code is used again
+ * - HUFFMAN_TABLE_STATIC: the ID of a static table follows, and for the user
+ *   table its ID from huffman_tableId, so that a different table is not used
+ *   for extracting
+ * The mode that codes the block in the fewest bits, header included, is
+ * chosen. Small blocks usually end up with a static table, as a table of
+ * their own costs more than it saves.
+ * @param data start of the block
+ * @param len length of the block in bytes
+ * @param dst the destination BitArray
+ * @param previous the last new code, replaced if a new code is stored
+ * @param mode destination for the chosen table mode
+ * @return size of the stored code table in bits, 0 if none was stored
+ */
+size_t encodeHuffmanBlock(unsigned char *data, size_t len, BitArray *dst, HuffCode **previous, int *mode)
+{
+    if (!data || !dst || !previous || !mode)
+        err_quit("null pointer in encodeHuffmanBlock");
+
+    size_t freqs[MAX_LEAVES] = {0};
+    for (size_t i = 0; i < len; i++)
+        freqs[data[i]]++;
+    return encodeCountedHuffmanBlock(data, len, freqs, dst, previous, mode);
+}
+
+/**
+ * Encode a block of input like encodeHuffmanBlock, with the frequencies of
+ * its bytes already counted by the caller.
+ * @param data start of the block
+ * @param len length of the block in bytes
+ * @param freqs the frequency of each byte value in the block
+ * @param dst the destination BitArray
+ * @param previous the last new code, replaced if a new code is stored
+ * @param mode destination for the chosen table mode
+ * @return size of the stored code table in bits, 0 if none was stored
+ */
+size_t encodeCountedHuffmanBlock(unsigned char *data, size_t len, size_t *freqs, BitArray *dst,
+        HuffCode **previous, int *mode)
+{
+    if (!data || !freqs || !dst || !previous || !mode)
+        err_quit("null pointer in encodeCountedHuffmanBlock");
+
+    HuffCode *own = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(own, freqs);
+    size_t tableBits = huffcode_tableCost(own);
+    HuffCode *code = own;
+    size_t bestCost = tableBits + huffcode_cost(own, freqs);
+    int id = 0;
+    *mode = HUFFMAN_TABLE_NEW;
+
+    size_t cost = *previous ? huffcode_cost(*previous, freqs) : SIZE_MAX;
+    if (cost <= bestCost) {
+        code = *previous;
+        bestCost = cost;
+        *mode = HUFFMAN_TABLE_REUSE;
+    }
+    for (int i = 0; i < HUFFMAN_STATIC_TABLES; i++) {
+        HuffCode *table = huffman_staticTable(i);
+        if (!table)
+            continue;
+        cost = huffcode_cost(table, freqs);
+        if (cost != SIZE_MAX && i == HUFFMAN_TABLE_USER)
+            cost += HUFFMAN_TABLE_HASH_BITS;
+        if (cost != SIZE_MAX && cost + HUFFMAN_TABLE_ID_BITS < bestCost) {
+            code = table;
+            bestCost = cost + HUFFMAN_TABLE_ID_BITS;
+            id = i;
+            *mode = HUFFMAN_TABLE_STATIC;
+        }
+    }
+
+    bitarray_appendBits(dst, *mode, HUFFMAN_TABLE_MODE_BITS);
+    if (*mode == HUFFMAN_TABLE_NEW) {
+        huffcode_writeLengths(own, dst);
+        if (*previous)
+            delete_huffcode(*previous);
+        *previous = own;
+    } else {
+        delete_huffcode(own);
+        tableBits = 0;
+        if (*mode == HUFFMAN_TABLE_STATIC)
+            bitarray_appendBits(dst, id, HUFFMAN_TABLE_ID_BITS);
+        if (*mode == HUFFMAN_TABLE_STATIC && id == HUFFMAN_TABLE_USER)
+            bitarray_appendBits(dst, huffman_tableId(code), HUFFMAN_TABLE_HASH_BITS);
+    }
+
+    for (size_t i = 0; i < len; i++)
+        huffcode_encode(code, dst, data[i]);
+    return tableBits;
+}
+
+/**
+ * Decode a block written by encodeHuffmanBlock.
+ * @param reader BitArrayReader positioned at the block header
+ * @param output the Buffer to append decoded bytes to
+ * @param len decoded length of the block in bytes
+ * @param previous the last new code, replaced if the block has a new code
+ */
+void decodeHuffmanBlock(BitArrayReader *reader, Buffer *output, size_t len, HuffCode **previous)
+{
+    if (!reader || !output || !previous)
+        err_quit("null pointer in decodeHuffmanBlock");
+
+    HuffCode *code = readHuffmanBlockHeader(reader, previous);
+    size_t start = output->len;
+    buffer_pad(output, len);
+    decodeHuffmanSymbols(reader, code, output->data + start, len);
+}
+
+/**
+ * Read the header of a block written by encodeHuffmanBlock.
+ * @param reader BitArrayReader positioned at the block header
+ * @param previous the last new code, replaced if the block has a new code
+ * @return the code of the block
+ */
+HuffCode *readHuffmanBlockHeader(BitArrayReader *reader, HuffCode **previous)
+{
+    if (!reader || !previous)
+        err_quit("null pointer reading Huffman block header");
+
+    uint32_t mode, id, tableId;
+    HuffCode *code = NULL;
+    if (bitarrayreader_readBits(reader, HUFFMAN_TABLE_MODE_BITS, &mode) < 1)
+        err_quit("unexpected end of file while reading block header");
+    switch (mode) {
+        case HUFFMAN_TABLE_NEW:
+            if (!*previous)
+                *previous = new_huffcode(MAX_LEAVES);
+            huffcode_readLengths(*previous, reader);
+            code = *previous;
+            break;
+        case HUFFMAN_TABLE_REUSE:
+            if (!*previous)
+                err_quit("failed to read header, no Huffman table to reuse");
+            code = *previous;
+            break;
+        case HUFFMAN_TABLE_STATIC:
+            if (bitarrayreader_readBits(reader, HUFFMAN_TABLE_ID_BITS, &id) < 1)
+                err_quit("unexpected end of file while reading block header");
+            code = huffman_staticTable(id);
+            if (!code && id == HUFFMAN_TABLE_USER)
+                err_quit("input was compressed with a user Huffman table, but none was loaded");
+            if (!code)
+                err_quit("failed to read header, unknown static Huffman table");
+            if (id != HUFFMAN_TABLE_USER)
+                break;
+            if (bitarrayreader_readBits(reader, HUFFMAN_TABLE_HASH_BITS, &tableId) < HUFFMAN_TABLE_HASH_BITS)
+                err_quit("unexpected end of file while reading block header");
+            if (huffman_tableId(code) != tableId)
+                err_quit("Huffman table does not match the one used for compressing");
+            break;
+        default:
+            err_quit("failed to read header, unknown Huffman table mode");
+    }
+    return code;
+}
+
+/**
+ * Decode bytes of a block. A block may be decoded in several parts.
+ * @param reader BitArrayReader positioned at the bytes
+ * @param code the code of the block
+ * @param dst destination with room for the bytes
+ * @param len amount of bytes to decode
+ */
+void decodeHuffmanSymbols(BitArrayReader *reader, HuffCode *code, unsigned char *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        ssize_t symbol = huffcode_decode(code, reader);
+        if (symbol < 0)
+            err_quit("unexpected end of file while reading payload");
+        dst[i] = symbol;
     }
-    return ret;
 }
 
 /**
@@ -74,9 +250,7 @@ void encodeHuffmanPayload(Buffer *src, BitArray *dst, BitArray **codes)
 /**
  * Building Huffman tree:
  * - calculate frequencies of each symbol
- * - push frequency-value pairs into min heap as leaf nodes
- * - pop two nodes and push a new internal node pointing to the two leaf
- *   nodes into heap, smaller on the left
+ * - build a tree out of the frequencies, see huffnode_buildTree
  * @params src the source Buffer
  * @return the Huffman tree built using the Buffer
  */
@@ -86,25 +260,7 @@ HuffNode *buildHufftree(Buffer *src)
     for (size_t i = 0; i < src->len; i++) {
         freqs[(int)src->data[i]]++;
     }
-
-    PriorityQueue *queue = new_queue(huffnode_compare);
-    for (int i = 0; i < MAX_LEAVES; i++) {
-        if (freqs[i] == 0)
-            continue;
-        HuffNode *new_leaf = huffnode_createLeaf(freqs[i], i);
-        queue_insert(queue, new_leaf);
-    }
-    while (queue_size(queue) > 1) {
-        HuffNode *a = queue_pop(queue);
-        HuffNode *b = queue_pop(queue);
-        HuffNode *parent = huffnode_createParent(a, b);
-        queue_insert(queue, parent);
-    }
-    HuffNode *root = NULL;
-    if (queue_size(queue) == 1)
-        root = queue_pop(queue);
-    delete_queue(queue);
-    return root;
+    return huffnode_buildTree(freqs, MAX_LEAVES);
 }
 
 /**
@@ -148,7 +304,8 @@ Buffer *decodeHuffmanPayload(BitArrayReader *reader, HuffNode *tree, size_t deco
     HuffNode *node = tree;
     while (total < decoded_length) {
         if (huffnode_isLeaf(node)) {
-            buffer_append(output, &(node->value), 1);
+            unsigned char byte = node->value;
+            buffer_append(output, &byte, 1);
             node = tree;
             total++;
         } else {
@@ -177,16 +334,22 @@ Buffer *huffman_extract(Buffer *src)
     BitArray *data = bitarray_fromBuffer(src);
     // create reader for BitArray
     BitArrayReader *reader = bitarray_createReader(data);
-    // decode uncompressed length
+    // decode uncompressed length and block size
     size_t decoded_length = bitarrayreader_readInteger(reader);
-    // deserialize tree
-    HuffNode *tree = huffnode_deserialize(reader);
-    if (!huffnode_isValid(tree))
+    size_t block_size = bitarrayreader_readInteger(reader);
+    if (block_size == 0 || block_size > HUFFMAN_BLOCK_SIZE)
         err_quit("failed to read header");
-    // decode Huffman coded payload
-    Buffer *ret = decodeHuffmanPayload(reader, tree, decoded_length);
+    // decode blocks; the length is not checked, but every block needs a
+    // header from the input, so the output only grows a block at a time
+    Buffer *ret = new_buffer();
+    HuffCode *previous = NULL;
+    for (size_t pos = 0; pos < decoded_length; pos += block_size) {
+        size_t len = decoded_length - pos < block_size ? decoded_length - pos : block_size;
+        decodeHuffmanBlock(reader, ret, len, &previous);
+    }
+    if (previous)
+        delete_huffcode(previous);
     delete_bitarrayreader(reader);
-    delete_huffnode(tree);
     delete_bitarrayPreserveContents(data);
     return ret;
 }
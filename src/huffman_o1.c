@@ -0,0 +1,310 @@
+#include "../include/huffman.h"
+#include "../include/huffman_o1.h"
+#include "../include/huffman_o1_private.h"
+#include "../include/huffcode.h"
+#include "../include/bitarray.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <stdint.h>
+
+/**
+ * Compresses a Buffer using order-1 context Huffman coding. Every byte is
+ * coded with a Huffman code chosen by the byte before it. To keep the header
+ * small, contexts with similar statistics share a code, so at most
+ * O1_MAX_TABLES code tables and a table index for each context are stored.
+ * 1. frequency counting for each context
+ * 2. clustering the contexts into 1, 2, 4 or 8 tables, keeping the smallest
+ * 3. character encoding
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *huffman_o1_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in huffman_o1_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    size_t *freqs = countContextFrequencies(src);
+    HuffCode *codes[O1_MAX_TABLES] = {NULL};
+    unsigned char map[O1_CONTEXTS];
+    int tables = 0;
+    size_t bestBits = SIZE_MAX;
+    for (int target = 1; target <= O1_MAX_TABLES; target *= 2) {
+        HuffCode *candidate[O1_MAX_TABLES] = {NULL};
+        unsigned char candidateMap[O1_CONTEXTS];
+        int count = clusterContexts(freqs, target, candidateMap);
+        size_t bits = buildContextCodes(freqs, candidateMap, count, candidate);
+        if (bits < bestBits) {
+            // replace the previous best
+            for (int i = 0; i < tables; i++)
+                delete_huffcode(codes[i]);
+            memcpy(codes, candidate, sizeof(candidate));
+            memcpy(map, candidateMap, O1_CONTEXTS);
+            tables = count;
+            bestBits = bits;
+        } else {
+            for (int i = 0; i < count; i++)
+                delete_huffcode(candidate[i]);
+        }
+        if (count < target)
+            break; // there were too few contexts to use more tables
+    }
+    free(freqs);
+
+    BitArray *output = new_bitarray();
+    // encode unpacked length
+    bitarray_writeInteger(output, src->len);
+    // encode tables and context map
+    size_t diff = output->len;
+    bitarray_appendBits(output, tables - 1, O1_TABLE_BITS);
+    for (int i = 0; i < tables; i++)
+        huffcode_writeLengths(codes[i], output);
+    int mapBits = contextMapBits(tables);
+    for (int i = 0; i < O1_CONTEXTS; i++)
+        bitarray_appendBits(output, map[i], mapBits);
+    diff = output->len - diff;
+    fprintf(stderr, "%d Huffman tables for %d contexts, size of tables and context map: %lu bits (%lu bytes)\n",
+            tables, O1_CONTEXTS, diff, (diff + 7) / 8);
+    // encode payload
+    unsigned char prev = 0;
+    for (size_t i = 0; i < src->len; i++) {
+        huffcode_encode(codes[map[prev]], output, src->data[i]);
+        prev = src->data[i];
+    }
+
+    for (int i = 0; i < tables; i++)
+        delete_huffcode(codes[i]);
+    return bitarray_deleteAndConvertToBuffer(output);
+}
+
+/**
+ * Count how often each byte follows each other byte. The first byte of the
+ * input is counted in the context of a zero byte.
+ * @param src the source Buffer
+ * @return frequency table, O1_CONTEXTS rows of MAX_LEAVES entries
+ */
+size_t *countContextFrequencies(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer counting context frequencies");
+
+    size_t *freqs = mcalloc(O1_CONTEXTS * MAX_LEAVES, sizeof(size_t));
+    unsigned char prev = 0;
+    for (size_t i = 0; i < src->len; i++) {
+        freqs[prev * MAX_LEAVES + src->data[i]]++;
+        prev = src->data[i];
+    }
+    return freqs;
+}
+
+/**
+ * Group contexts with similar statistics together (k-means clustering). The
+ * most frequent contexts are used as the initial clusters. Then, each round,
+ * a Huffman code is built from the combined frequencies of every cluster,
+ * and every context is moved to the cluster whose code codes it in the
+ * fewest bits. Cluster frequencies are smoothed so that every symbol has a
+ * code and any context can be costed against any cluster.
+ * @param freqs frequency table from countContextFrequencies
+ * @param tables the amount of clusters to aim for
+ * @param map destination for the cluster of each context
+ * @return the amount of clusters in use
+ */
+int clusterContexts(size_t *freqs, int tables, unsigned char *map)
+{
+    if (!freqs || !map)
+        err_quit("null pointer clustering contexts");
+    if (tables < 1 || tables > O1_MAX_TABLES)
+        err_quit("invalid amount of context tables");
+
+    // order contexts by frequency
+    size_t totals[O1_CONTEXTS] = {0};
+    int order[O1_CONTEXTS];
+    int used = 0;
+    for (int i = 0; i < O1_CONTEXTS; i++) {
+        for (int j = 0; j < MAX_LEAVES; j++)
+            totals[i] += freqs[i * MAX_LEAVES + j];
+        if (totals[i] == 0)
+            continue;
+        int pos = used++;
+        while (pos > 0 && totals[order[pos - 1]] < totals[i]) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = i;
+    }
+    memset(map, 0, O1_CONTEXTS);
+    if (used == 0)
+        return 1;
+    if (tables > used)
+        tables = used;
+
+    size_t *sums = mcalloc(tables * MAX_LEAVES, sizeof(size_t));
+    size_t smoothed[MAX_LEAVES];
+    HuffCode *codes[O1_MAX_TABLES];
+    for (int c = 0; c < tables; c++) {
+        codes[c] = new_huffcode(MAX_LEAVES);
+        for (int j = 0; j < MAX_LEAVES; j++)
+            sums[c * MAX_LEAVES + j] = freqs[order[c] * MAX_LEAVES + j];
+    }
+
+    for (int round = 0; round < O1_ITERATIONS; round++) {
+        for (int c = 0; c < tables; c++) {
+            for (int j = 0; j < MAX_LEAVES; j++)
+                smoothed[j] = 2 * sums[c * MAX_LEAVES + j] + 1;
+            huffcode_fromFrequencies(codes[c], smoothed);
+        }
+        // move every context to its cheapest cluster
+        int changed = 0;
+        for (int i = 0; i < used; i++) {
+            int context = order[i];
+            int best = 0;
+            size_t bestCost = SIZE_MAX;
+            for (int c = 0; c < tables; c++) {
+                size_t cost = huffcode_cost(codes[c], freqs + context * MAX_LEAVES);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    best = c;
+                }
+            }
+            if (round == 0 || map[context] != best)
+                changed++;
+            map[context] = best;
+        }
+        if (!changed)
+            break;
+        memset(sums, 0, tables * MAX_LEAVES * sizeof(size_t));
+        for (int i = 0; i < used; i++)
+            for (int j = 0; j < MAX_LEAVES; j++)
+                sums[map[order[i]] * MAX_LEAVES + j] += freqs[order[i] * MAX_LEAVES + j];
+    }
+
+    // renumber clusters, leaving out the ones that ended up empty
+    int members[O1_MAX_TABLES] = {0};
+    int renumbered[O1_MAX_TABLES];
+    int count = 0;
+    for (int i = 0; i < used; i++)
+        members[map[order[i]]]++;
+    for (int c = 0; c < tables; c++)
+        renumbered[c] = members[c] > 0 ? count++ : 0;
+    for (int i = 0; i < used; i++)
+        map[order[i]] = renumbered[map[order[i]]];
+
+    for (int c = 0; c < tables; c++)
+        delete_huffcode(codes[c]);
+    free(sums);
+    return count;
+}
+
+/**
+ * Build the Huffman code of each table from the combined frequencies of the
+ * contexts mapped to it.
+ * @param freqs frequency table from countContextFrequencies
+ * @param map the table of each context
+ * @param tables the amount of tables
+ * @param codes destination for the codes
+ * @return size of the tables, context map and payload in bits
+ */
+size_t buildContextCodes(size_t *freqs, unsigned char *map, int tables, HuffCode **codes)
+{
+    if (!freqs || !map || !codes)
+        err_quit("null pointer building context codes");
+
+    size_t total = O1_TABLE_BITS + O1_CONTEXTS * contextMapBits(tables);
+    for (int c = 0; c < tables; c++) {
+        size_t sums[MAX_LEAVES] = {0};
+        for (int i = 0; i < O1_CONTEXTS; i++) {
+            if (map[i] != c)
+                continue;
+            for (int j = 0; j < MAX_LEAVES; j++)
+                sums[j] += freqs[i * MAX_LEAVES + j];
+        }
+        // a lone symbol would get a code of no bits, and the decoder could
+        // not bound the output by its input, so pair it with another symbol
+        int used = 0, last = 0;
+        for (int j = 0; j < MAX_LEAVES; j++) {
+            if (sums[j] > 0) {
+                used++;
+                last = j;
+            }
+        }
+        if (used == 1)
+            sums[last ^ 1] = 1;
+        codes[c] = new_huffcode(MAX_LEAVES);
+        huffcode_fromFrequencies(codes[c], sums);
+        if (used == 1)
+            sums[last ^ 1] = 0;
+        total += huffcode_tableCost(codes[c]) + huffcode_cost(codes[c], sums);
+    }
+    return total;
+}
+
+/**
+ * Calculate the amount of bits needed for a table index.
+ * @param tables the amount of tables
+ * @return bits per context map entry
+ */
+int contextMapBits(int tables)
+{
+    int bits = 0;
+    while ((1 << bits) < tables)
+        bits++;
+    return bits;
+}
+
+/**
+ * Decompress order-1 Huffman compressed Buffer.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *huffman_o1_extract(Buffer *src)
+{
+    if (src->len == 0)
+        err_quit("file is empty, skipping extraction");
+
+    BitArray *data = bitarray_fromBuffer(src);
+    BitArrayReader *reader = bitarray_createReader(data);
+    // decode uncompressed length
+    size_t decoded_length = bitarrayreader_readInteger(reader);
+    // decode tables and context map
+    uint32_t tables;
+    if (bitarrayreader_readBits(reader, O1_TABLE_BITS, &tables) < 1)
+        err_quit("failed to read header");
+    tables++;
+    HuffCode *codes[O1_MAX_TABLES] = {NULL};
+    for (uint32_t i = 0; i < tables; i++) {
+        codes[i] = new_huffcode(MAX_LEAVES);
+        huffcode_readLengths(codes[i], reader);
+        if (codes[i]->single >= 0)
+            err_quit("invalid Huffman table in header");
+    }
+    HuffCode *contexts[O1_CONTEXTS];
+    int mapBits = contextMapBits(tables);
+    for (int i = 0; i < O1_CONTEXTS; i++) {
+        uint32_t table = 0;
+        if (bitarrayreader_readBits(reader, mapBits, &table) < 0 || table >= tables)
+            err_quit("failed to read header");
+        contexts[i] = codes[table];
+    }
+    // every symbol takes at least one bit, so the length can't exceed the
+    // bits left in the input
+    if (decoded_length > data->len - reader->pos)
+        err_quit("invalid uncompressed length in header");
+    Buffer *ret = new_buffer();
+    buffer_pad(ret, decoded_length);
+    unsigned char prev = 0;
+    for (size_t i = 0; i < decoded_length; i++) {
+        ssize_t symbol = huffcode_decode(contexts[prev], reader);
+        if (symbol < 0)
+            err_quit("unexpected end of file while reading payload");
+        ret->data[i] = prev = symbol;
+    }
+
+    for (uint32_t i = 0; i < tables; i++)
+        delete_huffcode(codes[i]);
+    delete_bitarrayreader(reader);
+    delete_bitarrayPreserveContents(data);
+    return ret;
+}
@@ -0,0 +1,190 @@
+#include "../include/huffman.h"
+#include "../include/huffman_tables.h"
+#include "../include/bitarray.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <pthread.h>
+
+void buildBuiltInTables();
+
+/*
+ * Code lengths of the built-in tables. The text table was trained on English
+ * prose, Markdown and C source, the binary table on x86-64 executables and
+ * shared libraries. Every byte value has a code, so any block can use them.
+ */
+static const unsigned char textLengths[MAX_LEAVES] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 10, 6, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    3, 12, 10, 8, 13, 14, 14, 9, 7, 7, 6, 12, 9, 7, 6, 5,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 10, 10, 10, 9, 14,
+    11, 9, 10, 9, 10, 9, 10, 10, 10, 9, 11, 11, 9, 9, 9, 10,
+    10, 14, 9, 9, 9, 11, 10, 11, 13, 11, 13, 7, 8, 7, 15, 9,
+    6, 5, 6, 5, 5, 4, 6, 6, 5, 5, 7, 8, 5, 6, 5, 4,
+    6, 11, 5, 5, 4, 6, 8, 8, 9, 8, 11, 10, 12, 10, 15, 15,
+    13, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 14, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 14,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 14, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 12, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    13, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 13, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15
+};
+
+static const unsigned char binaryLengths[MAX_LEAVES] = {
+    2, 6, 7, 8, 7, 7, 9, 8, 7, 9, 8, 9, 9, 9, 6, 5,
+    7, 9, 9, 10, 9, 9, 10, 10, 8, 10, 10, 11, 10, 10, 11, 7,
+    6, 10, 10, 11, 6, 9, 11, 10, 8, 9, 11, 10, 10, 9, 9, 10,
+    8, 8, 11, 11, 10, 9, 11, 11, 9, 8, 10, 10, 9, 9, 11, 10,
+    8, 6, 8, 9, 7, 8, 10, 9, 5, 7, 10, 10, 7, 9, 10, 10,
+    9, 11, 10, 9, 8, 9, 10, 10, 10, 11, 11, 9, 9, 9, 10, 8,
+    9, 8, 9, 8, 8, 8, 7, 10, 9, 8, 11, 10, 8, 9, 8, 8,
+    9, 11, 8, 8, 7, 8, 9, 10, 9, 10, 11, 11, 9, 10, 10, 9,
+    8, 9, 10, 6, 7, 7, 9, 10, 9, 5, 11, 6, 10, 7, 10, 10,
+    9, 11, 11, 11, 10, 10, 11, 11, 10, 11, 11, 11, 11, 11, 11, 11,
+    10, 11, 12, 11, 11, 11, 11, 12, 10, 11, 11, 11, 11, 11, 11, 11,
+    10, 11, 11, 11, 11, 11, 9, 11, 9, 10, 9, 11, 10, 10, 9, 10,
+    7, 9, 9, 8, 9, 8, 9, 8, 9, 9, 10, 11, 10, 11, 11, 11,
+    9, 10, 9, 10, 10, 11, 10, 10, 10, 11, 10, 10, 11, 11, 10, 9,
+    9, 10, 10, 11, 10, 11, 10, 10, 7, 7, 10, 9, 9, 9, 9, 9,
+    9, 10, 10, 9, 9, 10, 8, 9, 8, 9, 8, 9, 9, 8, 8, 4
+};
+
+static HuffCode *staticTables[HUFFMAN_STATIC_TABLES];
+static pthread_once_t builtInTablesOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Get a static table by its ID. The built-in tables are built on first use,
+ * once even if several threads compress at the same time.
+ * @param id the table ID
+ * @return the table, NULL if there is no table with the ID
+ */
+HuffCode *huffman_staticTable(int id)
+{
+    if (id < 0 || id >= HUFFMAN_STATIC_TABLES)
+        return NULL;
+    if (id != HUFFMAN_TABLE_USER)
+        pthread_once(&builtInTablesOnce, buildBuiltInTables);
+    return staticTables[id];
+}
+
+/**
+ * Calculate the ID of a table, stored in the table file and in the header of
+ * blocks coded with the user table. The ID is the 32-bit FNV-1a hash of the
+ * code lengths, which fully describe the code.
+ * @param code the table
+ * @return the table ID
+ */
+uint32_t huffman_tableId(HuffCode *code)
+{
+    if (!code)
+        err_quit("null pointer calculating Huffman table ID");
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < code->symbols; i++) {
+        hash ^= code->lengths[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Build the built-in tables from their code lengths.
+ */
+void buildBuiltInTables()
+{
+    unsigned char lengths[MAX_LEAVES];
+    memcpy(lengths, textLengths, MAX_LEAVES);
+    staticTables[HUFFMAN_TABLE_TEXT] = new_huffcode(MAX_LEAVES);
+    huffcode_fromLengths(staticTables[HUFFMAN_TABLE_TEXT], lengths);
+    memcpy(lengths, binaryLengths, MAX_LEAVES);
+    staticTables[HUFFMAN_TABLE_BINARY] = new_huffcode(MAX_LEAVES);
+    huffcode_fromLengths(staticTables[HUFFMAN_TABLE_BINARY], lengths);
+}
+
+/**
+ * Set the user table. The table is owned by the module afterwards and
+ * replaces any previously set user table.
+ * @param code the table to use, NULL to remove the user table
+ */
+void huffman_setUserTable(HuffCode *code)
+{
+    if (code && code->symbols != MAX_LEAVES)
+        err_quit("invalid alphabet size for user Huffman table");
+    if (staticTables[HUFFMAN_TABLE_USER])
+        delete_huffcode(staticTables[HUFFMAN_TABLE_USER]);
+    staticTables[HUFFMAN_TABLE_USER] = code;
+}
+
+/**
+ * Train a table from sample data. Every byte value is given a code, even if
+ * it does not appear in the samples, so the table can code any input.
+ * @param src the sample data
+ * @return the trained table
+ */
+HuffCode *huffman_trainTable(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer when training Huffman table");
+
+    size_t freqs[MAX_LEAVES];
+    for (int i = 0; i < MAX_LEAVES; i++)
+        freqs[i] = 1;
+    for (size_t i = 0; i < src->len; i++)
+        freqs[src->data[i]]++;
+    HuffCode *ret = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(ret, freqs);
+    return ret;
+}
+
+/**
+ * Serialize a table for saving to a file: HUFFMAN_TABLE_MAGIC, the table ID
+ * and the code lengths as written by huffcode_writeLengths.
+ * @param code the table to serialize
+ * @return the serialized table
+ */
+Buffer *huffman_serializeTable(HuffCode *code)
+{
+    if (!code)
+        err_quit("null pointer when serializing Huffman table");
+
+    BitArray *lengths = new_bitarray();
+    bitarray_appendBits(lengths, huffman_tableId(code), HUFFMAN_TABLE_HASH_BITS);
+    huffcode_writeLengths(code, lengths);
+    Buffer *ret = new_buffer();
+    buffer_append(ret, (unsigned char *)HUFFMAN_TABLE_MAGIC, strlen(HUFFMAN_TABLE_MAGIC));
+    buffer_append(ret, lengths->data->data, (lengths->len + 7) / 8);
+    delete_bitarray(lengths);
+    return ret;
+}
+
+/**
+ * Deserialize a table written by huffman_serializeTable. The stored ID is
+ * checked against the code lengths read, so a damaged file is not used to
+ * compress anything.
+ * @param src the serialized table
+ * @return the table
+ */
+HuffCode *huffman_deserializeTable(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer when deserializing Huffman table");
+    size_t magic = strlen(HUFFMAN_TABLE_MAGIC);
+    if (src->len <= magic || memcmp(src->data, HUFFMAN_TABLE_MAGIC, magic) != 0)
+        err_quit("not a Huffman table file");
+
+    Buffer *lengths = new_buffer();
+    buffer_append(lengths, src->data + magic, src->len - magic);
+    BitArray *data = bitarray_fromBuffer(lengths);
+    BitArrayReader *reader = bitarray_createReader(data);
+    uint32_t id;
+    if (bitarrayreader_readBits(reader, HUFFMAN_TABLE_HASH_BITS, &id) < HUFFMAN_TABLE_HASH_BITS)
+        err_quit("not a Huffman table file");
+    HuffCode *ret = new_huffcode(MAX_LEAVES);
+    huffcode_readLengths(ret, reader);
+    if (huffman_tableId(ret) != id)
+        err_quit("Huffman table file is damaged, its ID does not match its code lengths");
+    delete_bitarrayreader(reader);
+    delete_bitarray(data);
+    return ret;
+}
@@ -2,6 +2,7 @@
 #include "../include/bitarray.h"
 #include "../include/error.h"
 #include "../include/ealloc.h"
+#include "../include/priorityqueue.h"
 
 int huffnode_compare(void *left, void *right)
 {
@@ -72,7 +73,7 @@ void delete_huffnode(HuffNode *node)
     free(node);
 }
 
-HuffNode *new_huffnode(HuffNode *left, HuffNode *right, ssize_t key, unsigned char value)
+HuffNode *new_huffnode(HuffNode *left, HuffNode *right, ssize_t key, unsigned short value)
 {
     HuffNode *ret = mmalloc(sizeof(HuffNode));
 
@@ -83,7 +84,7 @@ HuffNode *new_huffnode(HuffNode *left, HuffNode *right, ssize_t key, unsigned ch
     return ret;
 }
 
-HuffNode *huffnode_createLeaf(ssize_t key, unsigned char value)
+HuffNode *huffnode_createLeaf(ssize_t key, unsigned short value)
 {
     HuffNode *ret = new_huffnode(NULL, NULL, key, value);
     return ret;
@@ -141,3 +142,37 @@ HuffNode *huffnode_deserialize(BitArrayReader *src)
         return huffnode_createParent(left, right);
     }
 }
+
+/**
+ * Build a Huffman tree from a frequency table:
+ * - push frequency-value pairs into min heap as leaf nodes
+ * - pop two nodes and push a new internal node pointing to the two leaf
+ *   nodes into heap, smaller on the left
+ * @param freqs frequency of each symbol
+ * @param symbols size of the frequency table
+ * @return the root of the tree, or NULL if all frequencies are zero
+ */
+HuffNode *huffnode_buildTree(size_t *freqs, size_t symbols)
+{
+    if (!freqs)
+        err_quit("null pointer building Huffman tree");
+
+    PriorityQueue *queue = new_queue(huffnode_compare);
+    for (size_t i = 0; i < symbols; i++) {
+        if (freqs[i] == 0)
+            continue;
+        HuffNode *new_leaf = huffnode_createLeaf(freqs[i], i);
+        queue_insert(queue, new_leaf);
+    }
+    while (queue_size(queue) > 1) {
+        HuffNode *a = queue_pop(queue);
+        HuffNode *b = queue_pop(queue);
+        HuffNode *parent = huffnode_createParent(a, b);
+        queue_insert(queue, parent);
+    }
+    HuffNode *root = NULL;
+    if (queue_size(queue) == 1)
+        root = queue_pop(queue);
+    delete_queue(queue);
+    return root;
+}
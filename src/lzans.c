@@ -0,0 +1,34 @@
+#include "../include/lzans.h"
+#include "../include/lzss_byte.h"
+#include "../include/ans.h"
+#include "../include/error.h"
+
+/**
+ * Compresses a Buffer with LZSS-byte and codes the result with tANS, which
+ * spends less than a bit on the very frequent bytes of repetitive input.
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *lzans_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in lzans_compress");
+
+    Buffer *lzss_compressed = lzss_byte_compress(src);
+    Buffer *output = ans_compress(lzss_compressed);
+    delete_buffer(lzss_compressed);
+    return output;
+}
+
+/**
+ * Decompress a Buffer compressed with lzans_compress.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *lzans_extract(Buffer *src)
+{
+    Buffer *ans_extracted = ans_extract(src);
+    Buffer *output = lzss_byte_extract(ans_extracted);
+    delete_buffer(ans_extracted);
+    return output;
+}
@@ -0,0 +1,196 @@
+#include "../include/lzdict.h"
+#include "../include/lzdict_private.h"
+#include "../include/lzss_common.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <string.h>
+
+int compareSegments(const void *a, const void *b);
+
+/**
+ * Calculate the ID of a dictionary, stored in the header of streams
+ * compressed with it. The ID is the 32-bit FNV-1a hash of its contents.
+ * @param dictionary the dictionary
+ * @return the dictionary ID
+ */
+uint32_t lzdict_id(Buffer *dictionary)
+{
+    if (!dictionary)
+        err_quit("null pointer calculating dictionary ID");
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < dictionary->len; i++) {
+        hash ^= dictionary->data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Check that the dictionary given for extracting is the one a stream was
+ * compressed with.
+ * @param dictionary the dictionary, NULL if none was given
+ * @param id the dictionary ID from the stream header
+ * @return the dictionary
+ */
+Buffer *lzdict_check(Buffer *dictionary, uint32_t id)
+{
+    if (!dictionary)
+        err_quit("input was compressed with a dictionary or a reference, set it with -D or --patch-from");
+    if (lzdict_id(dictionary) != id)
+        err_quit("dictionary or reference does not match the one used for compressing");
+    return dictionary;
+}
+
+/**
+ * Build a dictionary from sample inputs. Substrings common to many samples
+ * are what a dictionary is good for, so the trainer counts in how many
+ * samples each LZDICT_KMER byte substring occurs, as in the COVER algorithm
+ * of Zstandard. The samples are then split into as many epochs as the
+ * dictionary has segments, and the segment of each epoch whose substrings
+ * are the most common is chosen. Substrings of a chosen segment no longer
+ * count, so that later segments add something new. The best segments are
+ * placed last, where the distances to them are the shortest.
+ * @param samples the sample inputs
+ * @param count amount of samples
+ * @param size maximum size of the dictionary
+ * @return the dictionary, empty if the samples have nothing in common
+ */
+Buffer *lzdict_train(Buffer **samples, size_t count, size_t size)
+{
+    if (!samples)
+        err_quit("null pointer training dictionary");
+    if (size == 0)
+        err_quit("invalid dictionary size");
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += samples[i]->len;
+    uint32_t *occurrences = countSubstrings(samples, count);
+    size_t segments = (size + LZDICT_SEGMENT - 1) / LZDICT_SEGMENT;
+    size_t epoch = total / segments < LZDICT_SEGMENT ? LZDICT_SEGMENT : total / segments;
+    DictSegment *chosen = mmalloc(segments * sizeof(DictSegment));
+    size_t n = 0;
+    for (size_t from = 0; from < total && n < segments; from += epoch) {
+        DictSegment *segment = &chosen[n];
+        if (!findBestSegment(samples, count, occurrences, from, from + epoch, segment))
+            continue;
+        unsigned char *data = samples[segment->sample]->data + segment->pos;
+        for (size_t i = 0; i + LZDICT_KMER <= segment->len; i++)
+            occurrences[hashSubstring(data + i)] = 0;
+        n++;
+    }
+    qsort(chosen, n, sizeof(DictSegment), compareSegments);
+
+    Buffer *ret = new_buffer();
+    for (size_t i = 0; i < n; i++)
+        buffer_append(ret, samples[chosen[i].sample]->data + chosen[i].pos, chosen[i].len);
+    if (ret->len > size) {
+        // drop the least useful segments from the beginning
+        memmove(ret->data, ret->data + ret->len - size, size);
+        ret->len = size;
+    }
+    free(chosen);
+    free(occurrences);
+    return ret;
+}
+
+/**
+ * Count in how many samples each substring occurs. Substrings are counted
+ * by hash, so unrelated ones may share a count.
+ * @param samples the sample inputs
+ * @param count amount of samples
+ * @return table of 1 << LZDICT_HASH_BITS counts, to be freed by the caller
+ */
+uint32_t *countSubstrings(Buffer **samples, size_t count)
+{
+    size_t entries = (size_t)1 << LZDICT_HASH_BITS;
+    uint32_t *occurrences = mcalloc(entries, sizeof(uint32_t));
+    size_t *seen = mcalloc(entries, sizeof(size_t)); // latest sample + 1
+    for (size_t i = 0; i < count; i++) {
+        for (size_t pos = 0; pos + LZDICT_KMER <= samples[i]->len; pos++) {
+            size_t hash = hashSubstring(samples[i]->data + pos);
+            if (seen[hash] != i + 1) {
+                seen[hash] = i + 1;
+                occurrences[hash]++;
+            }
+        }
+    }
+    free(seen);
+    return occurrences;
+}
+
+/**
+ * Find the segment with the most common substrings starting in a range of
+ * the samples, taken as if they were concatenated. A segment is scored by
+ * the sum of the counts of its substrings found in more than one sample.
+ * Segments do not cross sample boundaries.
+ * @param samples the sample inputs
+ * @param count amount of samples
+ * @param occurrences counts from countSubstrings
+ * @param from the first position of the range
+ * @param to the position after the range
+ * @param best destination for the segment
+ * @return 1 if a segment with a nonzero score was found, 0 otherwise
+ */
+int findBestSegment(Buffer **samples, size_t count, uint32_t *occurrences, size_t from, size_t to,
+        DictSegment *best)
+{
+    best->score = 0;
+    size_t base = 0;
+    for (size_t i = 0; i < count && base < to; base += samples[i++]->len) {
+        size_t len = samples[i]->len;
+        if (base + len <= from || len < LZDICT_KMER)
+            continue;
+        size_t segmentLen = len < LZDICT_SEGMENT ? len : LZDICT_SEGMENT;
+        size_t kmers = segmentLen - LZDICT_KMER + 1;
+        size_t first = from > base ? from - base : 0;
+        size_t last = to - base < len - segmentLen ? to - base : len - segmentLen;
+        if (first > last)
+            continue;
+        // sliding sum of the substring scores in the segment
+        size_t score = 0;
+        for (size_t k = 0; k < kmers; k++) {
+            uint32_t c = occurrences[hashSubstring(samples[i]->data + first + k)];
+            score += c > 1 ? c : 0;
+        }
+        for (size_t pos = first;; pos++) {
+            if (score > best->score) {
+                best->sample = i;
+                best->pos = pos;
+                best->len = segmentLen;
+                best->score = score;
+            }
+            if (pos == last)
+                break;
+            uint32_t out = occurrences[hashSubstring(samples[i]->data + pos)];
+            uint32_t in = occurrences[hashSubstring(samples[i]->data + pos + kmers)];
+            score -= out > 1 ? out : 0;
+            score += in > 1 ? in : 0;
+        }
+    }
+    return best->score > 0;
+}
+
+/**
+ * Hash the LZDICT_KMER bytes at a position.
+ * @param data pointer to the position
+ * @return hash value of LZDICT_HASH_BITS bits
+ */
+size_t hashSubstring(unsigned char *data)
+{
+    uint64_t val;
+    memcpy(&val, data, sizeof(val));
+    return (val * 0x9e3779b97f4a7c15u) >> (64 - LZDICT_HASH_BITS);
+}
+
+/**
+ * Order segments by increasing score, for qsort.
+ * @param a, b the segments to compare
+ * @return negative, zero or positive as a scores lower, the same or higher
+ */
+int compareSegments(const void *a, const void *b)
+{
+    size_t x = ((DictSegment *)a)->score, y = ((DictSegment *)b)->score;
+    return x < y ? -1 : x > y;
+}
@@ -0,0 +1,283 @@
+#include "../include/lzfast.h"
+#include "../include/lzfast_private.h"
+#include "../include/arena.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <stdint.h>
+
+uint32_t read32(unsigned char *p);
+uint64_t read64(unsigned char *p);
+size_t hashFast(unsigned char *p);
+unsigned char *writeRunLength(unsigned char *dst, size_t len);
+
+/**
+ * Compresses Buffer with a fast LZ77 variant writing LZ4-like sequences.
+ * Speed is preferred over ratio: matches are looked up with a single probe
+ * of a hash table, and the search steps further ahead the longer it goes
+ * without finding a match, so incompressible data is skipped quickly.
+ * The output starts with the decoded length as a variable length integer.
+ * @param src input Buffer
+ * @return compressed output
+ */
+Buffer *lzfast_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in lzfast_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    Buffer *compressed = new_buffer();
+    buffer_appendVarint(compressed, src->len);
+    size_t header = compressed->len;
+    // worst case: all literals, with a length byte for every 255 of them
+    buffer_pad(compressed, src->len + src->len / 255 + 32);
+    compressed->len = header + encodeFastSequences(src->data, src->len, compressed->data + header);
+    return compressed;
+}
+
+/**
+ * Read 4 bytes as an integer, without alignment requirements.
+ * @param p pointer to the bytes
+ * @return the bytes as a native integer
+ */
+uint32_t read32(unsigned char *p)
+{
+    uint32_t ret;
+    memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+/**
+ * Read 8 bytes as an integer, without alignment requirements.
+ * @param p pointer to the bytes
+ * @return the bytes as a native integer
+ */
+uint64_t read64(unsigned char *p)
+{
+    uint64_t ret;
+    memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+/**
+ * Hash FAST_MINMATCH bytes.
+ * @param p pointer to the bytes
+ * @return hash value of FAST_HASH_BITS bits
+ */
+size_t hashFast(unsigned char *p)
+{
+    return (read32(p) * 2654435761u) >> (32 - FAST_HASH_BITS);
+}
+
+/**
+ * Write the part of a length that does not fit in its 4-bit token field:
+ * bytes of 255 followed by the remainder.
+ * @param dst the destination
+ * @param len the length minus 15
+ * @return pointer past the written bytes
+ */
+unsigned char *writeRunLength(unsigned char *dst, size_t len)
+{
+    while (len >= 255) {
+        *dst++ = 255;
+        len -= 255;
+    }
+    *dst++ = len;
+    return dst;
+}
+
+/**
+ * Encode input as sequences. A sequence is a token byte holding the literal
+ * run length in the high 4 bits and the match length - FAST_MINMATCH in the
+ * low 4 bits, extra literal length bytes, the literals, a little-endian
+ * 16-bit match offset and extra match length bytes. Length fields of 15
+ * continue in extra bytes, added up until a byte below 255. The last
+ * sequence has literals only.
+ * @param src the input
+ * @param len length of the input
+ * @param dst destination with room for the worst case output
+ * @return amount of bytes written
+ */
+size_t encodeFastSequences(unsigned char *src, size_t len, unsigned char *dst)
+{
+    if (!src || !dst)
+        err_quit("null pointer in encodeFastSequences");
+
+    // positions are stored modulo 2^32, which is enough to recover any
+    // position within FAST_MAX_OFFSET and keeps the table in the L1 cache
+    uint32_t *table = arena_alloc(ARENA_FAST_TABLE, ((size_t)1 << FAST_HASH_BITS) * sizeof(uint32_t));
+    memset(table, 0, ((size_t)1 << FAST_HASH_BITS) * sizeof(uint32_t));
+    unsigned char *out = dst;
+    size_t anchor = 0, pos = 1;
+    size_t matchLimit = len > FAST_MATCH_LIMIT ? len - FAST_MATCH_LIMIT : 0;
+    size_t endLimit = len > FAST_LAST_LITERALS ? len - FAST_LAST_LITERALS : 0;
+
+    while (pos < matchLimit) {
+        // find a match, stepping ahead faster after repeated misses
+        size_t candidate, attempts = 1 << FAST_SKIP_STRENGTH;
+        size_t step = 1;
+        for (;;) {
+            size_t hash = hashFast(src + pos);
+            uint32_t distance = (uint32_t)pos - table[hash];
+            table[hash] = pos;
+            candidate = pos - distance;
+            if (distance - 1 < FAST_MAX_OFFSET && read32(src + candidate) == read32(src + pos))
+                break;
+            pos += step;
+            step = attempts++ >> FAST_SKIP_STRENGTH;
+            if (pos >= matchLimit)
+                goto last_literals;
+        }
+        // extend the match backwards over literals
+        while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+            pos--;
+            candidate--;
+        }
+        size_t matchLen = FAST_MINMATCH;
+        while (pos + matchLen + 8 <= endLimit && read64(src + pos + matchLen) == read64(src + candidate + matchLen))
+            matchLen += 8;
+        while (pos + matchLen < endLimit && src[pos + matchLen] == src[candidate + matchLen])
+            matchLen++;
+
+        size_t literals = pos - anchor;
+        unsigned char *token = out++;
+        *token = (literals < 15 ? literals : 15) << 4;
+        if (literals >= 15)
+            out = writeRunLength(out, literals - 15);
+        if (literals <= 16 && anchor + 16 <= len)
+            memcpy(out, src + anchor, 16); // the extra bytes get overwritten
+        else
+            memcpy(out, src + anchor, literals);
+        out += literals;
+        size_t offset = pos - candidate;
+        *out++ = offset & 0xff;
+        *out++ = offset >> 8;
+        size_t extra = matchLen - FAST_MINMATCH;
+        *token |= extra < 15 ? extra : 15;
+        if (extra >= 15)
+            out = writeRunLength(out, extra - 15);
+
+        pos += matchLen;
+        anchor = pos;
+        if (pos < matchLimit)
+            table[hashFast(src + pos - 2)] = pos - 2;
+    }
+
+last_literals:;
+    size_t literals = len - anchor;
+    *out++ = (literals < 15 ? literals : 15) << 4;
+    if (literals >= 15)
+        out = writeRunLength(out, literals - 15);
+    memcpy(out, src + anchor, literals);
+    out += literals;
+    arena_free(ARENA_FAST_TABLE, table);
+    return out - dst;
+}
+
+/**
+ * Decode sequences written by encodeFastSequences. Short literal runs are
+ * copied as a fixed 16 bytes and references in chunks of 8 or 16 bytes, so up
+ * to FAST_WILDCOPY bytes past the end of the output may be written.
+ * @param src the compressed sequences
+ * @param srcLen length of the sequences
+ * @param dst destination, with room for len + FAST_WILDCOPY bytes
+ * @param len decoded length
+ * @return amount of bytes decoded
+ */
+size_t decodeFastSequences(unsigned char *src, size_t srcLen, unsigned char *dst, size_t len)
+{
+    if (!src || !dst)
+        err_quit("null pointer in decodeFastSequences");
+
+    unsigned char *in = src, *end = src + srcLen;
+    unsigned char *out = dst, *outEnd = dst + len;
+    for (;;) {
+        if (in >= end)
+            err_quit("unexpected end of file while reading payload");
+        unsigned token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            unsigned char byte;
+            do {
+                if (in >= end)
+                    err_quit("unexpected end of file while reading payload");
+                byte = *in++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if (literals > (size_t)(end - in) || literals > (size_t)(outEnd - out))
+            err_quit("literal run out of bounds");
+        if (literals <= 16 && end - in >= 16)
+            memcpy(out, in, 16);
+        else
+            memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        if (out == outEnd)
+            break;
+
+        if (end - in < 2)
+            err_quit("unexpected end of file while reading payload");
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t matchLen = (token & 15) + FAST_MINMATCH;
+        if ((token & 15) == 15) {
+            unsigned char byte;
+            do {
+                if (in >= end)
+                    err_quit("unexpected end of file while reading payload");
+                byte = *in++;
+                matchLen += byte;
+            } while (byte == 255);
+        }
+        if (offset == 0 || offset > (size_t)(out - dst) || matchLen > (size_t)(outEnd - out))
+            err_quit("token string out of bounds");
+
+        unsigned char *match = out - offset;
+        if (offset >= 16) {
+            memcpy(out, match, 16);
+            for (size_t i = 16; i < matchLen; i += 16)
+                memcpy(out + i, match + i, 16);
+        } else if (offset >= 8) {
+            memcpy(out, match, 8);
+            memcpy(out + 8, match + 8, 8);
+            for (size_t i = 16; i < matchLen; i += 8)
+                memcpy(out + i, match + i, 8);
+        } else {
+            // the reference repeats with the period of the offset: copy one
+            // period of at least 8 bytes, then continue from a period back
+            size_t period = offset * ((8 + offset - 1) / offset);
+            size_t head = matchLen < period ? matchLen : period;
+            for (size_t i = 0; i < head; i++)
+                out[i] = match[i];
+            for (size_t i = head; i < matchLen; i += 8)
+                memcpy(out + i, out + i - period, 8);
+        }
+        out += matchLen;
+    }
+    return out - dst;
+}
+
+/**
+ * Decompress a Buffer compressed with lzfast_compress.
+ * @param src compressed source Buffer
+ * @return decompressed Buffer
+ */
+Buffer *lzfast_extract(Buffer *src)
+{
+    if (!src || src->len == 0)
+        err_quit("file is empty, skipping extraction\n");
+
+    BufferReader *reader = buffer_createReader(src);
+    size_t decoded_length;
+    if (bufferreader_readVarint(reader, &decoded_length) < 1)
+        err_quit("failed to read header");
+    Buffer *decompressed = new_buffer();
+    buffer_pad(decompressed, decoded_length + FAST_WILDCOPY);
+    decompressed->len = decodeFastSequences(src->data + reader->pos, src->len - reader->pos,
+            decompressed->data, decoded_length);
+    delete_bufferreader(reader);
+    return decompressed;
+}
@@ -0,0 +1,420 @@
+#include "../include/lzhf.h"
+#include "../include/lzhf_private.h"
+#include "../include/lzss_common.h"
+#include "../include/lzss_byte_private.h"
+#include "../include/huffman_private.h"
+#include "../include/huffcode.h"
+#include "../include/bitarray.h"
+#include "../include/chunkqueue.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <pthread.h>
+
+static int pipelined = 1;
+
+/**
+ * Set whether lzhf may run its two stages on threads of their own. Callers
+ * that compress or extract blocks on a thread pool turn this off, as the
+ * other threads are busy with blocks of their own; the stages then take
+ * turns on the calling thread.
+ * @param enabled 1 to run the stages at the same time, 0 to take turns
+ */
+void lzhf_setPipelined(int enabled)
+{
+    pipelined = enabled != 0;
+}
+
+/**
+ * Compresses a Buffer with byte-level LZSS followed by Huffman coding of the
+ * lzss-byte stream, in the same format as lzss_byte_compress followed by
+ * huffman_compress.
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *lzhf_compress(Buffer *src)
+{
+    return lzhf_compressWithHistory(src, NULL);
+}
+
+/**
+ * Compresses a Buffer with lzhf, with the given data in place of the preset
+ * dictionary. The two stages run at the same time: the LZSS stage hands the
+ * lzss-byte stream to the Huffman stage in Huffman blocks as it parses, so
+ * the stream is never held in full and the time taken is about that of the
+ * slower stage, unless turned off with lzhf_setPipelined.
+ * @param src the source buffer to compress
+ * @param history data preceding the input, NULL for the preset dictionary
+ * @return compressed version of the given buffer
+ */
+Buffer *lzhf_compressWithHistory(Buffer *src, Buffer *history)
+{
+    if (!src)
+        err_quit("null pointer in lzhf_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    EncodeStage stage = {NULL, new_bitarray(), NULL, 0, 0, 0, {0}};
+    pthread_t thread;
+    if (pipelined) {
+        stage.queue = new_chunkqueue(LZHF_QUEUE_CHUNKS);
+        if (pthread_create(&thread, NULL, runEncodeStage, &stage) != 0)
+            err_quit("failed to create thread");
+    }
+    encodeByteChunks(src, history, HUFFMAN_BLOCK_SIZE, pipelined ? queueChunk : encodeChunk, &stage);
+    if (pipelined) {
+        chunkqueue_push(stage.queue, NULL);
+        pthread_join(thread, NULL);
+        delete_chunkqueue(stage.queue);
+    }
+    fprintf(stderr, "size of Huffman tables: %lu bits (%lu bytes), %lu of %lu blocks reused previous table, %lu used a static table\n",
+            stage.tableBits, (stage.tableBits + 7) / 8, stage.modes[HUFFMAN_TABLE_REUSE], stage.blocks,
+            stage.modes[HUFFMAN_TABLE_STATIC]);
+
+    // the header holds the length of the stream, known only now
+    BitArray *output = new_bitarray();
+    bitarray_writeInteger(output, stage.length);
+    bitarray_writeInteger(output, HUFFMAN_BLOCK_SIZE);
+    bitarray_appendString(output, stage.payload->data->data, stage.payload->len);
+    delete_bitarray(stage.payload);
+    if (stage.previous)
+        delete_huffcode(stage.previous);
+    return bitarray_deleteAndConvertToBuffer(output);
+}
+
+/**
+ * Chunk sink of the LZSS stage: pass a Huffman block on to the Huffman
+ * stage.
+ * @param chunk the lzss-byte data of the block
+ * @param stage the EncodeStage
+ */
+void queueChunk(ByteChunk *chunk, void *stage)
+{
+    chunkqueue_push(((EncodeStage *)stage)->queue, chunk);
+}
+
+/**
+ * Chunk sink: Huffman code a block of the lzss-byte stream and free it. The
+ * byte frequencies were counted by the LZSS stage while writing the block.
+ * @param chunk the lzss-byte data of the block
+ * @param stage the EncodeStage
+ */
+void encodeChunk(ByteChunk *chunk, void *stage)
+{
+    EncodeStage *s = stage;
+    int mode;
+    s->tableBits += encodeCountedHuffmanBlock(chunk->data->data, chunk->data->len, chunk->freqs,
+            s->payload, &s->previous, &mode);
+    s->modes[mode]++;
+    s->blocks++;
+    s->length += chunk->data->len;
+    delete_bytechunk(chunk);
+}
+
+/**
+ * Thread function: code the blocks from the queue of the Huffman stage
+ * until the end marker.
+ * @param stage the EncodeStage
+ * @return NULL
+ */
+void *runEncodeStage(void *stage)
+{
+    ByteChunk *chunk;
+    while ((chunk = chunkqueue_pop(((EncodeStage *)stage)->queue)))
+        encodeChunk(chunk, stage);
+    return NULL;
+}
+
+/**
+ * Decompress a Buffer compressed with lzhf_compress.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *lzhf_extract(Buffer *src)
+{
+    return lzhf_extractWithHistory(src, NULL);
+}
+
+/**
+ * Decompress a Buffer compressed with lzhf_compressWithHistory. Like when
+ * compressing, one thread Huffman decodes the lzss-byte stream while the
+ * other expands it. The stream is passed on in pieces of LZHF_PIECE_SIZE
+ * from a small ring, so neither the stream nor a whole block of it is held
+ * at once. Unless pipelined, each piece is expanded right after decoding.
+ * @param src compressed input
+ * @param history data preceding the output, NULL for the preset dictionary
+ * @return decompressed Buffer
+ */
+Buffer *lzhf_extractWithHistory(Buffer *src, Buffer *history)
+{
+    if (!src)
+        err_quit("null pointer in lzhf_extract");
+    if (src->len == 0)
+        err_quit("file is empty, skipping extraction\n");
+
+    BitArray *data = bitarray_fromBuffer(src);
+    DecodeStage stage = {NULL, NULL, bitarray_createReader(data), NULL, NULL, 0, 0, 0};
+    stage.length = bitarrayreader_readInteger(stage.reader);
+    stage.blockSize = bitarrayreader_readInteger(stage.reader);
+    if (stage.blockSize == 0)
+        err_quit("failed to read header");
+    ByteDecoder *decoder = new_bytedecoder(history);
+    if (pipelined) {
+        pthread_t thread;
+        unsigned char *ring = mmalloc(LZHF_RING_PIECES * LZHF_PIECE_SIZE);
+        Buffer pieces[LZHF_RING_PIECES];
+        for (int i = 0; i < LZHF_RING_PIECES; i++)
+            pieces[i] = (Buffer){0, LZHF_PIECE_SIZE, ring + i * LZHF_PIECE_SIZE};
+        stage.pieces = pieces;
+        stage.queue = new_chunkqueue(LZHF_QUEUE_CHUNKS);
+        if (pthread_create(&thread, NULL, runDecodeStage, &stage) != 0)
+            err_quit("failed to create thread");
+        Buffer *piece;
+        while ((piece = chunkqueue_pop(stage.queue)))
+            bytedecoder_update(decoder, piece->data, piece->len);
+        pthread_join(thread, NULL);
+        delete_chunkqueue(stage.queue);
+        free(ring);
+    } else {
+        unsigned char piece[LZHF_PIECE_SIZE];
+        size_t len;
+        while ((len = decodePiece(&stage, piece)) > 0)
+            bytedecoder_update(decoder, piece, len);
+    }
+
+    if (stage.previous)
+        delete_huffcode(stage.previous);
+    delete_bitarrayreader(stage.reader);
+    delete_bitarrayPreserveContents(data);
+    return bytedecoder_finish(decoder);
+}
+
+/**
+ * Huffman decode the next piece of the lzss-byte stream, reading the
+ * header of a block when one starts. A piece does not cross blocks.
+ * @param stage the DecodeStage
+ * @param dst destination with room for LZHF_PIECE_SIZE bytes
+ * @return amount of bytes decoded, 0 at the end of the stream
+ */
+size_t decodePiece(DecodeStage *stage, unsigned char *dst)
+{
+    if (stage->pos >= stage->length)
+        return 0;
+    size_t offset = stage->pos % stage->blockSize;
+    if (offset == 0)
+        stage->code = readHuffmanBlockHeader(stage->reader, &stage->previous);
+    size_t len = stage->blockSize - offset;
+    if (len > stage->length - stage->pos)
+        len = stage->length - stage->pos;
+    if (len > LZHF_PIECE_SIZE)
+        len = LZHF_PIECE_SIZE;
+    decodeHuffmanSymbols(stage->reader, stage->code, dst, len);
+    stage->pos += len;
+    return len;
+}
+
+/**
+ * Thread function: decode the stream of the Huffman stage into the pieces
+ * of the ring and pass them on through the queue, followed by the end
+ * marker. A piece is reused once the queue is full past it, by which time
+ * the LZSS stage has expanded it.
+ * @param stage the DecodeStage
+ * @return NULL
+ */
+void *runDecodeStage(void *stage)
+{
+    DecodeStage *s = stage;
+    for (size_t i = 0;; i++) {
+        Buffer *piece = &s->pieces[i % LZHF_RING_PIECES];
+        if ((piece->len = decodePiece(s, piece->data)) == 0)
+            break;
+        chunkqueue_push(s->queue, piece);
+    }
+    chunkqueue_push(s->queue, NULL);
+    return NULL;
+}
+
+/**
+ * Compresses a Buffer using LZ77 with Huffman coded tokens, as in DEFLATE.
+ * 1. the input is parsed into literals and references with a hash chain
+ *    match finder and lazy matching
+ * 2. tokens are split into blocks of LZHF_BLOCK_TOKENS
+ * 3. each block gets two canonical Huffman codes: one for literals, lengths
+ *    and the end of block marker, and one for distances
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *lzhf2_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in lzhf2_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    MatchFinder *mf = new_matchfinder(src->data, src->len, LZHF_WINDOW_SIZE, LZHF_MAXLEN, LZHF_CHAIN_LIMIT);
+    size_t count;
+    LZToken *tokens = parseTokens(mf, 0, &count);
+    delete_matchfinder(mf);
+
+    BitArray *output = new_bitarray();
+    bitarray_writeInteger(output, src->len);
+    size_t tableBits = 0, blocks = 0;
+    for (size_t i = 0; i < count; i += LZHF_BLOCK_TOKENS) {
+        size_t n = count - i < LZHF_BLOCK_TOKENS ? count - i : LZHF_BLOCK_TOKENS;
+        tableBits += encodeLZHFBlock(tokens + i, n, output);
+        blocks++;
+    }
+    fprintf(stderr, "%lu tokens in %lu blocks, size of Huffman tables: %lu bits (%lu bytes)\n",
+            count, blocks, tableBits, (tableBits + 7) / 8);
+
+    free(tokens);
+    return bitarray_deleteAndConvertToBuffer(output);
+}
+
+/**
+ * Encode a block of tokens. The block header holds the code lengths of the
+ * literal/length code and the distance code. A reference is written as its
+ * length bucket, the extra length bits, the distance bucket and the extra
+ * distance bits. The block ends with LZHF_END_OF_BLOCK.
+ * @param tokens the tokens of the block
+ * @param count amount of tokens
+ * @param dst the destination BitArray
+ * @return size of the code tables in bits
+ */
+size_t encodeLZHFBlock(LZToken *tokens, size_t count, BitArray *dst)
+{
+    if (!tokens || !dst)
+        err_quit("null pointer in encodeLZHFBlock");
+
+    size_t litlenFreqs[LZHF_LITLEN_SYMBOLS] = {0};
+    size_t distanceFreqs[LZHF_DISTANCE_SYMBOLS] = {0};
+    int extra;
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].distance == 0) {
+            litlenFreqs[tokens[i].length]++;
+        } else {
+            litlenFreqs[LZHF_END_OF_BLOCK + 1 + valueToBucket(tokens[i].length - MATCH_MIN, &extra)]++;
+            distanceFreqs[valueToBucket(tokens[i].distance - 1, &extra)]++;
+        }
+    }
+    litlenFreqs[LZHF_END_OF_BLOCK]++;
+
+    HuffCode *litlen = new_huffcode(LZHF_LITLEN_SYMBOLS);
+    HuffCode *distances = new_huffcode(LZHF_DISTANCE_SYMBOLS);
+    huffcode_fromFrequencies(litlen, litlenFreqs);
+    huffcode_fromFrequencies(distances, distanceFreqs);
+    size_t start = dst->len;
+    huffcode_writeLengths(litlen, dst);
+    huffcode_writeLengths(distances, dst);
+    size_t tableBits = dst->len - start;
+
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].distance == 0) {
+            huffcode_encode(litlen, dst, tokens[i].length);
+            continue;
+        }
+        size_t value = tokens[i].length - MATCH_MIN;
+        int bucket = valueToBucket(value, &extra);
+        huffcode_encode(litlen, dst, LZHF_END_OF_BLOCK + 1 + bucket);
+        bitarray_appendBits(dst, value - bucketBase(bucket, &extra), extra);
+        value = tokens[i].distance - 1;
+        bucket = valueToBucket(value, &extra);
+        huffcode_encode(distances, dst, bucket);
+        bitarray_appendBits(dst, value - bucketBase(bucket, &extra), extra);
+    }
+    huffcode_encode(litlen, dst, LZHF_END_OF_BLOCK);
+
+    delete_huffcode(litlen);
+    delete_huffcode(distances);
+    return tableBits;
+}
+
+/**
+ * Decode a block written by encodeLZHFBlock. Literals and references are
+ * decoded straight into the output, without an intermediate token stream.
+ * @param reader BitArrayReader positioned at the block header
+ * @param output the Buffer to append decoded bytes to
+ * @param limit decoded length of the whole stream
+ * @return amount of bytes decoded after the block
+ */
+size_t decodeLZHFBlock(BitArrayReader *reader, Buffer *output, size_t limit)
+{
+    if (!reader || !output)
+        err_quit("null pointer in decodeLZHFBlock");
+
+    HuffCode *litlen = new_huffcode(LZHF_LITLEN_SYMBOLS);
+    HuffCode *distances = new_huffcode(LZHF_DISTANCE_SYMBOLS);
+    huffcode_readLengths(litlen, reader);
+    huffcode_readLengths(distances, reader);
+    // every block has the end of block symbol and a token, so each token
+    // takes at least a bit of the input
+    if (litlen->single >= 0)
+        err_quit("invalid Huffman table in block header");
+
+    size_t pos = output->len;
+    for (;;) {
+        ssize_t symbol = huffcode_decode(litlen, reader);
+        if (symbol < 0)
+            err_quit("unexpected end of file while reading payload");
+        if (symbol < LZHF_END_OF_BLOCK) {
+            if (pos >= limit)
+                err_quit("literal out of bounds");
+            if (pos == output->len)
+                buffer_grow(output, 1, limit);
+            output->data[pos++] = symbol;
+            continue;
+        }
+        if (symbol == LZHF_END_OF_BLOCK)
+            break;
+
+        int extra;
+        uint32_t bits = 0;
+        size_t length = bucketBase(symbol - LZHF_END_OF_BLOCK - 1, &extra) + MATCH_MIN;
+        if (bitarrayreader_readBits(reader, extra, &bits) < 0)
+            err_quit("unexpected end of file while reading payload");
+        length += bits;
+        symbol = huffcode_decode(distances, reader);
+        if (symbol < 0)
+            err_quit("unexpected end of file while reading payload");
+        size_t distance = bucketBase(symbol, &extra) + 1;
+        if (bitarrayreader_readBits(reader, extra, &bits) < 0)
+            err_quit("unexpected end of file while reading payload");
+        distance += bits;
+        if (distance > pos || length > limit - pos)
+            err_quit("token string out of bounds");
+        if (length > output->len - pos)
+            buffer_grow(output, pos + length - output->len, limit);
+        // byte by byte, as the reference may overlap the bytes being written
+        unsigned char *data = output->data;
+        for (size_t i = 0; i < length; i++, pos++)
+            data[pos] = data[pos - distance];
+    }
+    output->len = pos;
+    delete_huffcode(litlen);
+    delete_huffcode(distances);
+    return pos;
+}
+
+/**
+ * Decompress a Buffer compressed with lzhf2_compress.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *lzhf2_extract(Buffer *src)
+{
+    if (src->len == 0)
+        err_quit("file is empty, skipping extraction\n");
+
+    BitArray *data = bitarray_fromBuffer(src);
+    BitArrayReader *reader = bitarray_createReader(data);
+    size_t decoded_length = bitarrayreader_readInteger(reader);
+    Buffer *ret = new_buffer();
+    while (ret->len < decoded_length)
+        decodeLZHFBlock(reader, ret, decoded_length);
+    delete_bitarrayreader(reader);
+    delete_bitarrayPreserveContents(data);
+    return ret;
+}
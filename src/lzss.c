@@ -3,18 +3,35 @@
 #include "../include/ealloc.h"
 #include "../include/error.h"
 #include "../include/lzss_private.h"
+#include "../include/lzdict.h"
 #include "../include/bitarray.h"
 #include "../include/ringbuffer.h"
 #include "../include/buffer.h"
 #include <stdint.h>
+#include <string.h>
 
 /**
  * Compresses Buffer using the LZSS (Lempel-Ziv-Storer-Szymanski algorithm.
- * Bit-level variant.
+ * Bit-level variant. The token layout set with lzss_setParameters is written
+ * after the output length, followed by a bit telling whether a preset
+ * dictionary was used and, if so, its 32-bit ID.
  * @param src input Buffer
  * @return LZSS-compressed output
  */
 Buffer *lzss_compress(Buffer *src)
+{
+    return lzss_compressWithHistory(src, NULL);
+}
+
+/**
+ * Compresses Buffer using LZSS, with the given data in place of the preset
+ * dictionary. Used for blocks that may refer to the end of the block before
+ * them.
+ * @param src input Buffer
+ * @param history data preceding the input, NULL for the preset dictionary
+ * @return LZSS-compressed output
+ */
+Buffer *lzss_compressWithHistory(Buffer *src, Buffer *history)
 {
 
     if (!src)
@@ -24,10 +41,17 @@ Buffer *lzss_compress(Buffer *src)
         return src;
     }
 
+    LZSSParams params = lzss_getParameters();
     BitArray *compressed = new_bitarray();
-    // write output length
+    // write output length and token layout
     bitarray_writeInteger(compressed, src->len);
-    encodeLZSSPayloadBitLevel(src, compressed);
+    bitarray_appendBits(compressed, params.distanceBits, LZSS_PARAM_BITS);
+    bitarray_appendBits(compressed, params.lengthBits, LZSS_PARAM_BITS);
+    Buffer *dictionary = history ? history : lzss_getDictionary();
+    bitarray_append(compressed, dictionary != NULL);
+    if (dictionary)
+        bitarray_appendBits(compressed, lzdict_id(dictionary), 32);
+    encodeLZSSPayloadBitLevel(src, dictionary, compressed, params);
     Buffer *ret = bitarray_deleteAndConvertToBuffer(compressed);
 
     return ret;
@@ -35,109 +59,349 @@ Buffer *lzss_compress(Buffer *src)
 
 /**
  * Encode LZSS payload. Bit-level implementation. Each byte literal is prefixed
- * by a 'zero' bit, while two-byte tokens are prefixed by 'one' bits.
+ * by a 'zero' bit, while tokens are prefixed by 'one' bits. Matches are found
+ * with the hash chain match finder, within the window and length limits of
+ * the token layout. Variable-length tokens are preceded by the amount of
+ * distance bits they store as is, whether they use repeat matches and whether
+ * long-range references follow. The parse for them favours recent distances,
+ * which are cheap to refer to when the data has a regular structure.
  * @param src the source Buffer
+ * @param history data preceding the source, such as a preset dictionary,
+ * that references may point into, or NULL
  * @param dst the destination BitArray
+ * @param params the token layout
  */
-void encodeLZSSPayloadBitLevel(Buffer *src, BitArray *dst)
-{
-    RingBuffer *dictionary = new_ringbuffer(WINDOW_SIZE);
-    Buffer *search = new_buffer();
-    Buffer *searchPrev = new_buffer();
-    int searchIndexPrev = -1;
-    size_t i;
-    size_t symbols_output = 0;
-
-    for (i = 0; i < src->len; i++) {
-        // read byte from input
-        unsigned char c = src->data[i];
-        // append to search buffer and look up current lookahead string in the
-        // ring buffer
-        buffer_append(search, &c, 1);
-        int searchIndex = findMatchKMP(dictionary, search);
-
-        // If string match fails, check if previous match succeeded.
-        if (searchPrev->len == TOKEN_MAXLEN || searchIndex == -1 || i == src->len - 1) {
-            if (i == src->len - 1 && searchIndex != -1) {
-                buffer_append(searchPrev, &c, 1);
-                searchIndexPrev = searchIndex;
+void encodeLZSSPayloadBitLevel(Buffer *src, Buffer *history, BitArray *dst, LZSSParams params)
+{
+    if (!src || !dst)
+        err_quit("null pointer when encoding LZSS payload");
+    if (!lzss_validParameters(params))
+        err_quit("invalid LZSS window or length bits");
+
+    Buffer *data = src;
+    size_t start = 0;
+    if (history && history->len > 0) {
+        data = new_buffer();
+        buffer_append(data, history->data, history->len);
+        buffer_append(data, src->data, src->len);
+        start = history->len;
+    }
+    int variable = params.lengthBits == LZSS_VARIABLE_LENGTH;
+    size_t maxLen = variable ? LZSS_VARIABLE_MAXLEN : ((size_t)1 << params.lengthBits) - 1;
+    MatchFinder *mf = new_matchfinder(data->data, data->len, (size_t)1 << params.distanceBits,
+            maxLen, LZSS_CHAIN_LIMIT);
+    if (variable)
+        mf->repeats = MATCH_REPS;
+    matchfinder_skip(mf, 0, start);
+    size_t count, longCount = 0;
+    LongMatch *longs = NULL;
+    if (params.longRange)
+        longs = findLongMatches(data->data, data->len, start, mf->window, &longCount);
+    LZToken *tokens = parseAroundLongMatches(mf, start, longs, longCount, &count);
+    VariableCoder coder = {0};
+    if (variable) {
+        coder.longRange = longCount > 0;
+        chooseDistanceBits(tokens, count, params.distanceBits, &coder);
+        bitarray_appendBits(dst, coder.lowBits, LZSS_PARAM_BITS);
+        bitarray_append(dst, coder.repeats);
+        bitarray_append(dst, coder.longRange);
+    }
+    writeLZSSItems(dst, data->data, start, tokens, count, longs, longCount, &coder, params);
+    free(longs);
+    free(tokens);
+    delete_matchfinder(mf);
+    if (data != src)
+        delete_buffer(data);
+}
+
+/**
+ * Write the tokens of a parse and the long-range matches between them. A
+ * match that takes more bits than its literals is written as literals,
+ * except with repeat matches: the parser made its distance a recent one, so
+ * it is coded as a reference to keep the recent distances the same as the
+ * parser's, and a later match at the distance is coded as a repeat.
+ * @param dst destination BitArray
+ * @param data the data the tokens were parsed from
+ * @param pos position of the first token in data
+ * @param tokens the tokens
+ * @param count amount of tokens
+ * @param longs the long-range matches in order of position, may be NULL
+ * @param longCount amount of long-range matches
+ * @param coder the token coding of variable-length tokens, recent distances
+ * are updated
+ * @param params the token layout
+ */
+void writeLZSSItems(BitArray *dst, unsigned char *data, size_t pos, LZToken *tokens, size_t count,
+        LongMatch *longs, size_t longCount, VariableCoder *coder, LZSSParams params)
+{
+    if (!dst || !data || !tokens || !coder)
+        err_quit("null pointer writing LZSS items");
+
+    int variable = params.lengthBits == LZSS_VARIABLE_LENGTH;
+    size_t next = 0;
+    for (size_t i = 0; i <= count; i++) {
+        while (next < longCount && longs[next].pos == pos) {
+            writeLongToken(dst, longs[next].distance, longs[next].length);
+            pos += longs[next++].length;
+        }
+        if (i == count)
+            break;
+        LZToken *token = &tokens[i];
+        if (token->distance > 0) {
+            size_t tokenBits = variable ? variableTokenLength(token->distance, token->length, coder)
+                : 1 + params.distanceBits + params.lengthBits;
+            if (token->length * 9 > tokenBits || (variable && coder->repeats)) {
+                if (variable)
+                    writeVariableToken(dst, token->distance, token->length, coder);
+                else
+                    writeTokenWidth(dst, token->distance, token->length, params);
+                pos += token->length;
+                continue;
             }
+        }
+        // literal, or a match cheaper to store as literals
+        size_t literals = token->distance > 0 ? token->length : 1;
+        for (size_t j = 0; j < literals; j++) {
+            bitarray_append(dst, 0);
+            bitarray_appendByte(dst, data[pos++]);
+        }
+    }
+}
 
-            // calculate token information
-            int distance = searchIndexPrev - searchPrev->len + 1;
-            int length = searchPrev->len;
-            if (length > 1 && distance > length && distance + length < symbols_output) {
-                // skip encoding token if the amount of bytes represented is
-                // smaller than the length of the token itself
-                writeToken(dst, distance, length);
-            } else {
-                writeString(dst, searchPrev);
+/**
+ * Parse the data between long-range matches with the match finder. The
+ * positions covered by a long-range match are not coded, but the last window
+ * of them is inserted as history for the data that follows.
+ * @param mf the match finder over the data
+ * @param start the first position to code, earlier ones must be inserted
+ * @param longs the long-range matches in order of position, may be NULL
+ * @param longCount amount of long-range matches
+ * @param count destination for the amount of tokens
+ * @return the tokens of all the gaps in order, to be freed by the caller
+ */
+LZToken *parseAroundLongMatches(MatchFinder *mf, size_t start, LongMatch *longs, size_t longCount, size_t *count)
+{
+    if (!mf || !count)
+        err_quit("null pointer parsing tokens");
+
+    size_t len = mf->len, n = 0;
+    LZToken *ret = NULL;
+    for (size_t i = 0; i <= longCount; i++) {
+        size_t end = i < longCount ? longs[i].pos : len;
+        if (end > start) {
+            size_t gap;
+            mf->len = end;
+            LZToken *tokens = parseTokens(mf, start, &gap);
+            mf->len = len;
+            ret = mrealloc(ret, (n + gap) * sizeof(LZToken));
+            memcpy(ret + n, tokens, gap * sizeof(LZToken));
+            free(tokens);
+            n += gap;
+        }
+        if (i == longCount)
+            break;
+        start = longs[i].pos + longs[i].length;
+        matchfinder_skip(mf, longs[i].pos, start);
+    }
+    if (!ret)
+        ret = mmalloc(sizeof(LZToken));
+    *count = n;
+    return ret;
+}
+
+/**
+ * Reassemble a token value from the bits following a token flag. Tokens are
+ * written most significant byte first, see writeTokenWidth.
+ * @param bits the token bits as read, first bit in the least significant position
+ * @param tokenBits width of the token
+ * @return the token value
+ */
+static inline uint32_t tokenValue(uint32_t bits, const int tokenBits)
+{
+    int first = tokenBits % 8 ? tokenBits % 8 : 8;
+    uint32_t val = bits & ((1u << first) - 1);
+    bits >>= first;
+    for (int left = tokenBits - first; left > 0; left -= 8) {
+        val = val << 8 | (bits & 0xff);
+        bits >>= 8;
+    }
+    return val;
+}
+
+/**
+ * Decode items until the output is full. Called with constant layouts for
+ * the common cases, so that the compiler can specialize the loop for them.
+ * @param reader BitArrayReader for reading input stream
+ * @param output destination holding the history, grown as items are decoded
+ * @param len length of the output in bytes, history included
+ * @param distanceBits bits for the distance of a reference
+ * @param lengthBits bits for the length of a reference
+ */
+static inline void decodeBitItems(BitArrayReader *reader, Buffer *output, size_t len,
+        const int distanceBits, const int lengthBits)
+{
+    const int itemBits = 1 + distanceBits + lengthBits;
+    unsigned char *out = output->data;
+    size_t pos = output->len;
+    while (pos < len) {
+        // a flag bit and either a literal or a token, first bit lowest
+        uint32_t bits = bitarrayreader_peekBits(reader, itemBits);
+        if ((bits & 1) == 0) {
+            if (reader->pos + 9 > reader->data->len)
+                err_quit("unexpected end of file while reading payload literal");
+            reader->pos += 9;
+            if (pos == output->len) {
+                buffer_grow(output, 1, len);
+                out = output->data;
             }
-            // add up the amount of amount of bytes written
-            symbols_output += searchPrev->len;
-            // clear search buffers when done
-            buffer_clear(searchPrev);
-            buffer_truncate(search);
+            out[pos++] = bits >> 1;
+            continue;
+        }
+        if (reader->pos + itemBits > reader->data->len)
+            err_quit("unexpected end of file while reading payload token");
+        reader->pos += itemBits;
+        uint32_t val = tokenValue(bits >> 1, itemBits - 1);
+        size_t distance = val >> lengthBits;
+        size_t length = val & ((1u << lengthBits) - 1);
+        if (distance == 0 || distance > pos || length == 0 || length > len - pos) {
+            fprintf(stderr, "distance:%5lu, length:%3lu, file length: %lu\n", distance, length, pos);
+            err_quit("token string out of bounds");
         }
-        // store current search result for next iteration
-        searchIndexPrev = searchIndex;
-        buffer_append(searchPrev, &c, 1);
-        // append to dictionary buffer
-        ringbuffer_append(dictionary, c);
+        if (length > output->len - pos) {
+            buffer_grow(output, pos + length - output->len, len);
+            out = output->data;
+        }
+        // byte by byte, as the reference may overlap the bytes being written
+        for (size_t i = 0; i < length; i++)
+            out[pos + i] = out[pos - distance + i];
+        pos += length;
     }
-    // if some bytes are still left in the search buffer, append them to output
-    if (symbols_output < i && search->len > 0)
-        writeString(dst, search);
+}
 
-    delete_buffer(searchPrev);
-    delete_buffer(search);
-    delete_ringbuffer(dictionary);
+/**
+ * Choose the amount of low distance bits of variable-length tokens that
+ * gives the smallest output. Data with mostly near references does best with
+ * few, data with references all over the window with many. Repeat matches
+ * cost every other token a bit, so they are only used when they pay off,
+ * which is the case for tables, images and other data made of records.
+ * @param tokens the tokens to code
+ * @param count amount of tokens
+ * @param distanceBits bits of the largest distance
+ * @param coder the coder to set lowBits and repeats of
+ */
+void chooseDistanceBits(LZToken *tokens, size_t count, int distanceBits, VariableCoder *coder)
+{
+    size_t bestCost = SIZE_MAX;
+    VariableCoder best = *coder;
+    for (int repeats = 0; repeats <= 1; repeats++) {
+        for (int lowBits = 0; lowBits <= distanceBits; lowBits++) {
+            VariableCoder candidate = {lowBits, repeats, coder->longRange, {0}};
+            size_t cost = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (tokens[i].distance == 0)
+                    continue;
+                size_t bits = variableTokenLength(tokens[i].distance, tokens[i].length, &candidate);
+                // with repeats every match is a reference, as writeLZSSItems codes it
+                if (repeats) {
+                    cost += bits;
+                    updateRepeats(candidate.reps, tokens[i].distance);
+                } else {
+                    cost += bits < tokens[i].length * 9 ? bits : tokens[i].length * 9;
+                }
+            }
+            if (cost < bestCost) {
+                bestCost = cost;
+                best = candidate;
+            }
+        }
+    }
+    coder->lowBits = best.lowBits;
+    coder->repeats = best.repeats;
+}
+
+/**
+ * Decode items with variable-length tokens until the output is full.
+ * @param reader BitArrayReader for reading input stream
+ * @param output destination holding the history, grown as items are decoded
+ * @param len length of the output in bytes, history included
+ */
+void decodeVariableItems(BitArrayReader *reader, Buffer *output, size_t len)
+{
+    uint32_t lowBits;
+    VariableCoder coder = {0};
+    if (bitarrayreader_readBits(reader, LZSS_PARAM_BITS, &lowBits) < 0 || lowBits > LZSS_MAX_DISTANCE_BITS
+            || bitarrayreader_readBit(reader, &coder.repeats) < 1
+            || bitarrayreader_readBit(reader, &coder.longRange) < 1)
+        err_quit("failed to read header");
+    coder.lowBits = lowBits;
+    unsigned char *out = output->data;
+    size_t pos = output->len;
+    while (pos < len) {
+        uint32_t bits = bitarrayreader_peekBits(reader, 9);
+        if ((bits & 1) == 0) {
+            if (reader->pos + 9 > reader->data->len)
+                err_quit("unexpected end of file while reading payload literal");
+            reader->pos += 9;
+            if (pos == output->len) {
+                buffer_grow(output, 1, len);
+                out = output->data;
+            }
+            out[pos++] = bits >> 1;
+            continue;
+        }
+        reader->pos++;
+        size_t distance, length;
+        if (readVariableToken(reader, &distance, &length, &coder) < 0)
+            err_quit("unexpected end of file while reading payload token");
+        if (distance == 0 || distance > pos || length > len - pos) {
+            fprintf(stderr, "distance:%5lu, length:%3lu, file length: %lu\n", distance, length, pos);
+            err_quit("token string out of bounds");
+        }
+        if (length > output->len - pos) {
+            buffer_grow(output, pos + length - output->len, len);
+            out = output->data;
+        }
+        for (size_t i = 0; i < length; i++)
+            out[pos + i] = out[pos - distance + i];
+        pos += length;
+    }
 }
 
 /**
  * Decode LZSS payload.
  * @param reader BitArrayReader for reading input stream.
+ * @param history the history the payload was encoded with, or NULL
  * @param decoded_length length of decoded output in bytes
- * @return Buffer containing decoded output
+ * @param params the token layout
+ * @return Buffer containing decoded output, without the history
  */
-Buffer *decodeLZSSPayloadBitLevel(BitArrayReader *reader, size_t decoded_length)
+Buffer *decodeLZSSPayloadBitLevel(BitArrayReader *reader, Buffer *history, size_t decoded_length,
+        LZSSParams params)
 {
     if (!reader)
         err_quit("null pointer when decoding LZSS payload");
+    if (!lzss_validParameters(params))
+        err_quit("invalid LZSS window or length bits");
 
-    // output and temp buffers
+    size_t start = history ? history->len : 0, len = start + decoded_length;
+    if (len < start)
+        err_quit("invalid uncompressed length");
     Buffer *output = new_buffer();
-    Buffer *temp = new_buffer();
-    while (output->len < decoded_length) {
-        int bit = 0;
-
-        // read a bit to check if next byte is a literal or part of a token
-        if (bitarrayreader_readBit(reader, &bit) < 1)
-            err_quit("unexpected end of file while reading payload bit");
-
-        if (bit == 1) {
-            // token bit set, the next two bytes will contain a token
-            unsigned distance = 0;
-            unsigned length = 0;
-            if (readToken(reader, &distance, &length) < 16)
-                err_quit("unexpected end of file while reading payload token");
-            // copy string indicated by token
-            if (distance > output->len || output->len - distance + length > output->len) {
-                fprintf(stderr, "distance:%5u, length:%3u, file length: %lu\n", distance, length, output->len);
-                err_quit("token string out of bounds");
-            }
-            buffer_append(temp, &output->data[output->len - distance], length);
-            buffer_concatl(output, temp, length);
-            buffer_clear(temp);
-        } else {
-            // token bit unset, next byte will be a literal
-            unsigned char byte = 0;
-            if (bitarrayreader_readByte(reader, &byte) < 8)
-                err_quit("unexpected end of file while reading payload literal");
-            buffer_append(output, &byte, 1);
-        }
+    if (history)
+        buffer_append(output, history->data, start);
+    // the output grows as items are decoded, not by the length in the header
+    if (params.lengthBits == LZSS_VARIABLE_LENGTH)
+        decodeVariableItems(reader, output, len);
+    else if (params.distanceBits == 12 && params.lengthBits == 4)
+        decodeBitItems(reader, output, len, 12, 4);
+    else if (params.distanceBits == 16 && params.lengthBits == 8)
+        decodeBitItems(reader, output, len, 16, 8);
+    else
+        decodeBitItems(reader, output, len, params.distanceBits, params.lengthBits);
+    if (start > 0) {
+        memmove(output->data, output->data + start, decoded_length);
+        output->len = decoded_length;
     }
-    delete_buffer(temp);
 
     return output;
 }
@@ -168,19 +432,15 @@ void writeToken(BitArray *dst, unsigned distance, unsigned length)
 {
     if (!dst)
         err_quit("null pointer in writeToken");
-    if ((distance >> TOKEN_DISTANCE_BITS) > 0) {
+    if ((distance >> LZSS_DEFAULT_DISTANCE_BITS) > 0) {
         fprintf(stderr, "distance:%5u, length:%3u\n", distance, length);
         err_quit("invalid reference token distance");
     }
-    if ((length >> TOKEN_LENGTH_BITS) > 0) {
+    if ((length >> LZSS_DEFAULT_LENGTH_BITS) > 0) {
         fprintf(stderr, "distance:%5u, length:%3u\n", distance, length);
         err_quit("invalid reference token length");
     }
-    if (distance < length) {
-        fprintf(stderr, "distance:%5u, length:%3u\n", distance, length);
-        err_quit("invalid reference token distance");
-    }
-    uint32_t val = (distance << TOKEN_LENGTH_BITS);
+    uint32_t val = (distance << LZSS_DEFAULT_LENGTH_BITS);
     val |= length;
     bitarray_append(dst, 1); // mark the beginning of a token
     bitarray_appendByte(dst, val >> 8);
@@ -205,17 +465,199 @@ int readToken(BitArrayReader *reader, unsigned *distance, unsigned *length)
     val = temp << 8;
     ret += bitarrayreader_readByte(reader, &temp);
     val |= temp;
-    *distance = val >> TOKEN_LENGTH_BITS;
-    *length = val & ((1 << TOKEN_LENGTH_BITS) - 1);
+    *distance = val >> LZSS_DEFAULT_LENGTH_BITS;
+    *length = val & ((1 << LZSS_DEFAULT_LENGTH_BITS) - 1);
     return ret;
 }
 
+/**
+ * Write LZSS reference token with any token layout. The value
+ * distance << lengthBits | length is written most significant byte first,
+ * starting with the bits that do not fill a whole byte, so the default
+ * layout gives the same bits as writeToken.
+ * @param dst destination BitArray
+ * @param distance distance of the referenced string from current position
+ * @param length length of referenced string
+ * @param params the token layout
+ */
+void writeTokenWidth(BitArray *dst, unsigned distance, unsigned length, LZSSParams params)
+{
+    if (!dst)
+        err_quit("null pointer in writeTokenWidth");
+    if ((distance >> params.distanceBits) > 0 || distance == 0)
+        err_quit("invalid reference token distance");
+    if ((length >> params.lengthBits) > 0 || length == 0)
+        err_quit("invalid reference token length");
+
+    int bits = params.distanceBits + params.lengthBits;
+    uint32_t val = (uint32_t)distance << params.lengthBits | length;
+    int first = bits % 8 ? bits % 8 : 8;
+    bitarray_append(dst, 1); // mark the beginning of a token
+    bitarray_appendBits(dst, val >> (bits - first), first);
+    for (int shift = bits - first - 8; shift >= 0; shift -= 8)
+        bitarray_appendBits(dst, (val >> shift) & 0xff, 8);
+}
+
+/**
+ * Read LZSS reference token written by writeTokenWidth.
+ * @param reader reader for source BitArray
+ * @param distance pointer to distance variable
+ * @param length pointer to length variable
+ * @param params the token layout
+ * @return amount of bits read, -1 if the input ran out
+ */
+int readTokenWidth(BitArrayReader *reader, unsigned *distance, unsigned *length, LZSSParams params)
+{
+    if (!reader || !distance || !length)
+        err_quit("null pointer in readTokenWidth");
+
+    int bits = params.distanceBits + params.lengthBits;
+    uint32_t raw;
+    if (bitarrayreader_readBits(reader, bits, &raw) < 0)
+        return -1;
+    uint32_t val = tokenValue(raw, bits);
+    *distance = val >> params.lengthBits;
+    *length = val & ((1u << params.lengthBits) - 1);
+    return bits;
+}
+
+/**
+ * Write a variable-length LZSS reference token. The length is gamma coded
+ * over MATCH_MIN - 1, so three byte matches take a single bit, or over
+ * MATCH_MIN - 2 in streams with long-range references, which use the code of
+ * one. With repeat matches, a bit then tells whether the distance is one of
+ * the MATCH_REPS most recent ones, in which case only its index follows.
+ * Otherwise the distance is coded as an exponential Golomb code: distance - 1
+ * without its lowest bits is gamma coded, followed by those bits as is. Near
+ * references stay cheap, while long and far ones remain possible.
+ * @param dst destination BitArray
+ * @param distance distance of the referenced string from current position
+ * @param length length of referenced string, at least MATCH_MIN
+ * @param coder the token coding, recent distances are updated
+ */
+void writeVariableToken(BitArray *dst, size_t distance, size_t length, VariableCoder *coder)
+{
+    if (!dst || !coder)
+        err_quit("null pointer in writeVariableToken");
+    if (distance == 0)
+        err_quit("invalid reference token distance");
+    if (length < MATCH_MIN)
+        err_quit("invalid reference token length");
+
+    bitarray_append(dst, 1); // mark the beginning of a token
+    bitarray_writeGamma(dst, length - MATCH_MIN + 1 + coder->longRange);
+    if (coder->repeats) {
+        int repeat = updateRepeats(coder->reps, distance);
+        bitarray_append(dst, repeat >= 0);
+        if (repeat >= 0) {
+            bitarray_appendBits(dst, repeat, MATCH_REP_BITS);
+            return;
+        }
+    }
+    int lowBits = coder->lowBits;
+    bitarray_writeGamma(dst, ((distance - 1) >> lowBits) + 1);
+    bitarray_appendBits(dst, (distance - 1) & ((1u << lowBits) - 1), lowBits);
+}
+
+/**
+ * Write a long-range reference token, which has the length code of one. The
+ * length over LONG_MIN_MATCH - 1 and the distance follow as gamma codes.
+ * Only valid in streams with long-range references.
+ * @param dst destination BitArray
+ * @param distance distance of the referenced string, any size
+ * @param length length of referenced string, at least LONG_MIN_MATCH
+ */
+void writeLongToken(BitArray *dst, size_t distance, size_t length)
+{
+    if (!dst)
+        err_quit("null pointer in writeLongToken");
+    if (distance == 0 || length < LONG_MIN_MATCH)
+        err_quit("invalid long-range reference");
+
+    bitarray_append(dst, 1);
+    bitarray_writeGamma(dst, 1);
+    bitarray_writeGamma(dst, length - LONG_MIN_MATCH + 1);
+    bitarray_writeGamma(dst, distance);
+}
+
+/**
+ * Read a variable-length LZSS reference token written by writeVariableToken
+ * or writeLongToken.
+ * @param reader reader for source BitArray
+ * @param distance pointer to distance variable, 0 for an unused repeat
+ * @param length pointer to length variable
+ * @param coder the token coding, recent distances are updated
+ * @return amount of bits read, -1 if the input ran out
+ */
+int readVariableToken(BitArrayReader *reader, size_t *distance, size_t *length, VariableCoder *coder)
+{
+    if (!reader || !distance || !length || !coder)
+        err_quit("null pointer in readVariableToken");
+
+    size_t start = reader->pos;
+    size_t code = bitarrayreader_readGamma(reader);
+    if (coder->longRange && code == 1) {
+        *length = bitarrayreader_readGamma(reader) + LONG_MIN_MATCH - 1;
+        *distance = bitarrayreader_readGamma(reader);
+        return reader->pos - start;
+    }
+    *length = code + MATCH_MIN - 1 - coder->longRange;
+    int repeat = 0;
+    if (coder->repeats && bitarrayreader_readBit(reader, &repeat) < 1)
+        return -1;
+    if (repeat) {
+        uint32_t index;
+        if (bitarrayreader_readBits(reader, MATCH_REP_BITS, &index) < 0)
+            return -1;
+        *distance = coder->reps[index];
+    } else {
+        size_t high = bitarrayreader_readGamma(reader) - 1;
+        uint32_t low;
+        if (bitarrayreader_readBits(reader, coder->lowBits, &low) < 0)
+            return -1;
+        *distance = (high << coder->lowBits | low) + 1;
+    }
+    if (coder->repeats)
+        updateRepeats(coder->reps, *distance);
+    return reader->pos - start;
+}
+
+/**
+ * Calculate the size of a variable-length token.
+ * @param distance distance of the referenced string
+ * @param length length of referenced string
+ * @param coder the token coding
+ * @return amount of bits written by writeVariableToken
+ */
+size_t variableTokenLength(size_t distance, size_t length, VariableCoder *coder)
+{
+    size_t bits = 1 + bitarray_gammaLength(length - MATCH_MIN + 1 + coder->longRange);
+    if (coder->repeats) {
+        if (findRepeat(coder->reps, distance) >= 0)
+            return bits + 1 + MATCH_REP_BITS;
+        bits++;
+    }
+    return bits + bitarray_gammaLength(((distance - 1) >> coder->lowBits) + 1) + coder->lowBits;
+}
+
 /**
  * Decompress LZSS-compressed Buffer.
  * @param src compressed source Buffer
  * @return decompressed Buffer
  */
 Buffer *lzss_extract(Buffer *src)
+{
+    return lzss_extractWithHistory(src, NULL);
+}
+
+/**
+ * Decompress LZSS-compressed Buffer that was compressed with the given data
+ * in place of the preset dictionary.
+ * @param src compressed source Buffer
+ * @param history data preceding the output, NULL for the preset dictionary
+ * @return decompressed Buffer
+ */
+Buffer *lzss_extractWithHistory(Buffer *src, Buffer *history)
 {
     // turn Buffer into BitArray
     BitArray *compressed = bitarray_fromBuffer(src);
@@ -223,7 +665,22 @@ Buffer *lzss_extract(Buffer *src)
     BitArrayReader *reader = bitarray_createReader(compressed);
 
     size_t decoded_length = bitarrayreader_readInteger(reader);
-    Buffer *decompressed = decodeLZSSPayloadBitLevel(reader, decoded_length);
+    uint32_t distanceBits, lengthBits;
+    if (bitarrayreader_readBits(reader, LZSS_PARAM_BITS, &distanceBits) < 0
+            || bitarrayreader_readBits(reader, LZSS_PARAM_BITS, &lengthBits) < 0)
+        err_quit("failed to read header");
+    LZSSParams params = {distanceBits, lengthBits, 0};
+    int hasDictionary;
+    uint32_t id;
+    Buffer *dictionary = NULL;
+    if (bitarrayreader_readBit(reader, &hasDictionary) < 1)
+        err_quit("failed to read header");
+    if (hasDictionary) {
+        if (bitarrayreader_readBits(reader, 32, &id) < 32)
+            err_quit("failed to read header");
+        dictionary = lzdict_check(history ? history : lzss_getDictionary(), id);
+    }
+    Buffer *decompressed = decodeLZSSPayloadBitLevel(reader, dictionary, decoded_length, params);
 
     delete_bitarrayreader(reader);
     delete_bitarrayPreserveContents(compressed);
@@ -3,17 +3,34 @@
 #include "../include/ealloc.h"
 #include "../include/error.h"
 #include "../include/lzss_byte_private.h"
+#include "../include/lzdict.h"
 #include "../include/ringbuffer.h"
 #include "../include/buffer.h"
 #include <stdint.h>
 
 /**
  * Compresses Buffer using the LZSS (Lempel-Ziv-Storer-Szymanski algorithm.
- * Byte-level variant.
+ * Byte-level variant. The output starts with the distance and length bits of
+ * the token layout set with lzss_setParameters, a byte each. If a preset
+ * dictionary is used, the top bit of the length byte is set and the 32-bit
+ * dictionary ID follows in little-endian order.
  * @param src input Buffer
  * @return LZSS-compressed output
  */
 Buffer *lzss_byte_compress(Buffer *src)
+{
+    return lzss_byte_compressWithHistory(src, NULL);
+}
+
+/**
+ * Compresses Buffer using byte-level LZSS, with the given data in place of
+ * the preset dictionary. Used for blocks that may refer to the end of the
+ * block before them.
+ * @param src input Buffer
+ * @param history data preceding the input, NULL for the preset dictionary
+ * @return LZSS-compressed output
+ */
+Buffer *lzss_byte_compressWithHistory(Buffer *src, Buffer *history)
 {
 
     if (!src)
@@ -23,9 +40,12 @@ Buffer *lzss_byte_compress(Buffer *src)
         return src;
     }
 
+    LZSSParams params = lzss_getParameters();
     Buffer *compressed = new_buffer();
+    Buffer *dictionary = history ? history : lzss_getDictionary();
+    writeByteHeader(compressed, dictionary, params);
 
-    encodeLZSSPayloadByteLevel(src, compressed);
+    encodeLZSSPayloadByteLevel(src, dictionary, compressed, params);
 
     return compressed;
 }
@@ -37,71 +57,269 @@ Buffer *lzss_byte_compress(Buffer *src)
  */
 Buffer *lzss_byte_extract(Buffer *src)
 {
-    // generate a reader from the buffer
-    BufferReader *reader = buffer_createReader(src);
+    return lzss_byte_extractWithHistory(src, NULL);
+}
+
+/**
+ * Decompress byte-level LZSS-compressed Buffer that was compressed with the
+ * given data in place of the preset dictionary.
+ * @param src compressed source Buffer
+ * @param history data preceding the output, NULL for the preset dictionary
+ * @return decompressed Buffer
+ */
+Buffer *lzss_byte_extractWithHistory(Buffer *src, Buffer *history)
+{
+    if (!src)
+        err_quit("null pointer in lzss_byte_extract");
+
+    ByteDecoder *decoder = new_bytedecoder(history);
+    bytedecoder_update(decoder, src->data, src->len);
+    return bytedecoder_finish(decoder);
+}
+
+/**
+ * Start decoding byte-level LZSS that is given in chunks, such as from a
+ * pipe. Only the window of the output is kept.
+ * @param history data preceding the output, NULL for the preset dictionary
+ * @return the decoder, for lzss_byte_updateDecoder and lzss_byte_finishDecoder
+ */
+void *lzss_byte_startDecoder(Buffer *history)
+{
+    return new_bytedecoder(history);
+}
+
+/**
+ * Decode the next chunk of byte-level LZSS. The chunk may end in the middle
+ * of the header or a token, which is decoded once the rest arrives.
+ * @param decoder the decoder from lzss_byte_startDecoder
+ * @param src the chunk
+ * @param len length of the chunk
+ * @param dst the Buffer to append the decoded output to
+ */
+void lzss_byte_updateDecoder(void *decoder, unsigned char *src, size_t len, Buffer *dst)
+{
+    bytedecoder_update(decoder, src, len);
+    bytedecoder_take(decoder, dst);
+}
+
+/**
+ * Check that byte-level LZSS ended with a whole token and free the decoder.
+ * @param decoder the decoder from lzss_byte_startDecoder
+ * @param dst the Buffer to append the rest of the output to
+ */
+void lzss_byte_finishDecoder(void *decoder, Buffer *dst)
+{
+    if (!dst)
+        err_quit("null pointer when finishing LZSS decoding");
+
+    Buffer *rest = bytedecoder_finish(decoder);
+    buffer_append(dst, rest->data, rest->len);
+    delete_buffer(rest);
+}
+
+/**
+ * Write the header of a byte-level stream: the distance and length bits,
+ * and the ID of the dictionary if there is one.
+ * @param dst destination Buffer
+ * @param dictionary the dictionary or history the stream refers to, or NULL
+ * @param params the token layout
+ */
+void writeByteHeader(Buffer *dst, Buffer *dictionary, LZSSParams params)
+{
+    if (!dst)
+        err_quit("null pointer writing byte-level header");
+
+    unsigned char header[6] = {params.distanceBits, params.lengthBits};
+    if (dictionary) {
+        uint32_t id = lzdict_id(dictionary);
+        header[1] |= LZSS_BYTE_DICTIONARY_FLAG;
+        for (int i = 0; i < 4; i++)
+            header[2 + i] = id >> (8 * i);
+    }
+    buffer_append(dst, header, dictionary ? 6 : 2);
+}
+
+/**
+ * Compress a Buffer like lzss_byte_compressWithHistory, but hand the output
+ * to a sink in chunks of chunkSize bytes while the input is still being
+ * parsed, instead of returning it at once. The last chunk may be shorter.
+ * Each chunk comes with the frequencies of its bytes, counted as they are
+ * written.
+ * @param src input Buffer
+ * @param history data preceding the input, NULL for the preset dictionary
+ * @param chunkSize size of the chunks
+ * @param sink the function to call with each chunk, which it then owns
+ * @param arg argument passed to the sink
+ */
+void encodeByteChunks(Buffer *src, Buffer *history, size_t chunkSize, ChunkSink sink, void *arg)
+{
+    if (!src || !sink)
+        err_quit("null pointer when encoding LZSS chunks");
+    if (chunkSize == 0)
+        err_quit("invalid LZSS chunk size");
+
+    LZSSParams params = lzss_getParameters();
+    Buffer *dictionary = history ? history : lzss_getDictionary();
+    ByteChunk *chunk = new_bytechunk();
+    ByteWriter writer = {chunk->data, chunk->freqs, chunk, NULL, 0, params, chunkSize, sink, arg};
+    writeByteHeader(writer.dst, dictionary, params);
+    for (size_t i = 0; i < writer.dst->len; i++)
+        writer.freqs[writer.dst->data[i]]++;
+    encodeByteTokens(src, dictionary, &writer);
+    if (writer.chunk->data->len > 0)
+        sink(writer.chunk, arg);
+    else
+        delete_bytechunk(writer.chunk);
+}
 
-    Buffer *decompressed = decodeLZSSPayloadByteLevel(reader);
+/**
+ * Creates an empty chunk of a byte-level stream.
+ * @return the newly created ByteChunk
+ */
+ByteChunk *new_bytechunk()
+{
+    ByteChunk *ret = mcalloc(1, sizeof(ByteChunk));
+    ret->data = new_buffer();
+    return ret;
+}
 
-    delete_bufferreader(reader);
+/**
+ * Frees a chunk and its data.
+ * @param chunk the ByteChunk to delete
+ */
+void delete_bytechunk(ByteChunk *chunk)
+{
+    if (!chunk)
+        err_quit("null pointer when deleting byte chunk");
 
-    return decompressed;
+    delete_buffer(chunk->data);
+    free(chunk);
 }
 
 /**
  * Encode LZSS payload. Byte-level implementation. Byte literals are output
  * as-is, while tokens are prefixed by a 0xff byte. If the next byte is 0x00,
- * the token should be read as a 0xff literal. 
+ * the token should be read as a 0xff literal. Matches are found with the hash
+ * chain match finder, within the window and length limits of the token
+ * layout.
  * @param src the source Buffer
+ * @param history data preceding the source, such as a preset dictionary,
+ * that references may point into, or NULL
  * @param dst the destination Buffer
+ * @param params the token layout
  */
-void encodeLZSSPayloadByteLevel(Buffer *src, Buffer *dst)
+void encodeLZSSPayloadByteLevel(Buffer *src, Buffer *history, Buffer *dst, LZSSParams params)
 {
-    RingBuffer *dictionary = new_ringbuffer(WINDOW_SIZE);
-    Buffer *search = new_buffer();
-    Buffer *searchPrev = new_buffer();
-    int searchIndexPrev = -1;
-    size_t i;
-    size_t symbols_output = 0;
+    if (!src || !dst)
+        err_quit("null pointer when encoding LZSS payload");
 
-    for (i = 0; i < src->len; i++) {
-        // read byte from input
-        unsigned char c = src->data[i];
-        // append to search buffer
-        buffer_append(search, &c, 1);
-        int searchIndex = findMatchKMP(dictionary, search);
-
-        // if a matching string is in the ring buffer, then check if the
-        // previous search string was
-        if (searchPrev->len == TOKEN_MAXLEN || searchIndex == -1 || i == src->len - 1) {
-            if (i == src->len - 1 && searchIndex != -1) {
-                buffer_append(searchPrev, &c, 1);
-                searchIndexPrev = searchIndex;
-            }
+    ByteWriter writer = {dst, NULL, NULL, NULL, 0, params, 0, NULL, NULL};
+    encodeByteTokens(src, history, &writer);
+}
+
+/**
+ * Parse the input into tokens and write them with a ByteWriter.
+ * @param src the source Buffer
+ * @param history data preceding the source that references may point
+ * into, or NULL
+ * @param writer the ByteWriter, with its destination, layout and chunking
+ */
+void encodeByteTokens(Buffer *src, Buffer *history, ByteWriter *writer)
+{
+    LZSSParams params = writer->params;
+    if (!lzss_validParameters(params) || params.lengthBits == LZSS_VARIABLE_LENGTH)
+        err_quit("invalid LZSS window or length bits");
 
-            int distance = searchIndexPrev - searchPrev->len + 1;
-            int length = searchPrev->len;
-            if (length > 2 && distance > length && distance + length < symbols_output) {
-                writeByteToken(dst, distance, length);
-            } else {
-                writeByteString(dst, searchPrev);
+    Buffer *data = src;
+    size_t start = 0;
+    if (history && history->len > 0) {
+        data = new_buffer();
+        buffer_append(data, history->data, history->len);
+        buffer_append(data, src->data, src->len);
+        start = history->len;
+    }
+    MatchFinder *mf = new_matchfinder(data->data, data->len, (size_t)1 << params.distanceBits,
+            ((size_t)1 << params.lengthBits) - 1, LZSS_CHAIN_LIMIT);
+    matchfinder_skip(mf, 0, start);
+    writer->data = data->data;
+    writer->pos = start;
+    parseTokensTo(mf, start, writeByteTokens, writer);
+    delete_matchfinder(mf);
+    if (data != src)
+        delete_buffer(data);
+}
+
+/**
+ * Token sink: write a batch of tokens to the destination of a ByteWriter,
+ * counting the bytes written if the writer keeps frequencies. Once the
+ * destination holds a whole chunk, the chunk is handed to the sink of the
+ * writer and a new one started.
+ * @param tokens the batch
+ * @param count amount of tokens in the batch
+ * @param writer the ByteWriter
+ */
+void writeByteTokens(LZToken *tokens, size_t count, void *writer)
+{
+    ByteWriter *w = writer;
+    size_t tokenBytes = 1 + byteTokenSize(w->params);
+    for (size_t i = 0; i < count; i++) {
+        LZToken *token = &tokens[i];
+        if (token->distance > 0 && token->length >= tokenBytes) {
+            writeByteTokenWidth(w->dst, token->distance, token->length, w->params);
+            w->pos += token->length;
+            if (w->freqs)
+                for (size_t j = w->dst->len - tokenBytes; j < w->dst->len; j++)
+                    w->freqs[w->dst->data[j]]++;
+        } else {
+            // literal, or a match that would not be shorter as a token
+            size_t literals = token->distance > 0 ? token->length : 1;
+            for (size_t j = 0; j < literals; j++) {
+                unsigned char c = w->data[w->pos++];
+                buffer_append(w->dst, &c, 1);
+                if (w->freqs)
+                    w->freqs[c]++;
+                if (c == 0xff) {
+                    c = 0;
+                    buffer_append(w->dst, &c, 1);
+                    if (w->freqs)
+                        w->freqs[0]++;
+                }
             }
-            symbols_output += searchPrev->len;
-            // clear search buffers when done
-            buffer_clear(searchPrev);
-            buffer_truncate(search);
         }
-        searchIndexPrev = searchIndex;
-        buffer_append(searchPrev, &c, 1);
-        // append to dictionary buffer
-        ringbuffer_append(dictionary, c);
+        if (w->chunkSize > 0 && w->dst->len >= w->chunkSize)
+            flushByteChunk(w);
     }
-    // if some symbols are still unencoded, append them to output
-    if (symbols_output < i && search->len > 0)
-        writeByteString(dst, search);
+}
 
-    delete_buffer(searchPrev);
-    delete_buffer(search);
-    delete_ringbuffer(dictionary);
+/**
+ * Hand the full chunk of a ByteWriter to its sink and start a new chunk
+ * with the bytes of the last token that did not fit.
+ * @param writer the ByteWriter
+ */
+void flushByteChunk(ByteWriter *writer)
+{
+    ByteChunk *full = writer->chunk;
+    ByteChunk *next = new_bytechunk();
+    for (size_t i = writer->chunkSize; i < full->data->len; i++) {
+        full->freqs[full->data->data[i]]--;
+        next->freqs[full->data->data[i]]++;
+    }
+    buffer_append(next->data, full->data->data + writer->chunkSize, full->data->len - writer->chunkSize);
+    full->data->len = writer->chunkSize;
+    writer->sink(full, writer->arg);
+    writer->chunk = next;
+    writer->dst = next->data;
+    writer->freqs = next->freqs;
+}
+
+/**
+ * Calculate the size of a token without its 0xff prefix.
+ * @param params the token layout
+ * @return amount of bytes
+ */
+size_t byteTokenSize(LZSSParams params)
+{
+    return (params.distanceBits + params.lengthBits + 7) / 8;
 }
 
 /**
@@ -116,11 +334,11 @@ int writeByteToken(Buffer *dst, unsigned distance, unsigned length)
 {
     if (!dst)
         err_quit("null pointer in writeToken");
-    if ((distance >> TOKEN_DISTANCE_BITS) > 0)
+    if ((distance >> LZSS_DEFAULT_DISTANCE_BITS) > 0)
         err_quit("invalid reference token distance");
-    if ((length >> TOKEN_LENGTH_BITS) > 0)
+    if ((length >> LZSS_DEFAULT_LENGTH_BITS) > 0)
         err_quit("invalid reference token length");
-    uint32_t val = (distance << TOKEN_LENGTH_BITS);
+    uint32_t val = (distance << LZSS_DEFAULT_LENGTH_BITS);
     val |= length;
     unsigned char temp = 0xff;
     buffer_append(dst, &temp, 1);
@@ -184,63 +402,277 @@ int readByteToken(BufferReader *reader, unsigned *distance, unsigned *length)
     val = temp;
     ret += bufferreader_read(reader, &temp, 1);
     val |= temp << 8;
-    *distance = val >> TOKEN_LENGTH_BITS;
-    *length = val & ((1 << TOKEN_LENGTH_BITS) - 1);
+    *distance = val >> LZSS_DEFAULT_LENGTH_BITS;
+    *length = val & ((1 << LZSS_DEFAULT_LENGTH_BITS) - 1);
 
     return ret;
 }
 
+/**
+ * Write LZSS reference token with any token layout: a 0xff byte followed by
+ * distance << lengthBits | length in little-endian order, in as many bytes as
+ * the layout needs. The first byte holds the low bits of the length, so it is
+ * never zero.
+ * @param dst destination Buffer
+ * @param distance distance of the referenced string from current position
+ * @param length length of referenced string
+ * @param params the token layout
+ * @return number of bytes written
+ */
+int writeByteTokenWidth(Buffer *dst, unsigned distance, unsigned length, LZSSParams params)
+{
+    if (!dst)
+        err_quit("null pointer in writeByteTokenWidth");
+    if ((distance >> params.distanceBits) > 0 || distance == 0)
+        err_quit("invalid reference token distance");
+    if ((length >> params.lengthBits) > 0 || length == 0)
+        err_quit("invalid reference token length");
+
+    uint32_t val = (uint32_t)distance << params.lengthBits | length;
+    size_t size = byteTokenSize(params);
+    unsigned char token[5] = {0xff};
+    for (size_t i = 0; i < size; i++)
+        token[1 + i] = val >> (8 * i);
+    buffer_append(dst, token, 1 + size);
+    return 1 + size;
+}
+
+/**
+ * Decode items until the input runs out. Called with constant layouts for
+ * the common cases, so that the compiler can specialize the loop for them.
+ * @param src the payload
+ * @param len length of the payload
+ * @param output destination Buffer
+ * @param distanceBits bits for the distance of a reference
+ * @param lengthBits bits for the length of a reference
+ * @return amount of bytes decoded, short of a token split by the end of the
+ * input
+ */
+static inline size_t decodeByteItems(unsigned char *src, size_t len, Buffer *output,
+        const int distanceBits, const int lengthBits)
+{
+    const size_t size = (distanceBits + lengthBits + 7) / 8;
+    size_t i = 0;
+    while (i < len) {
+        // copy the run of literals up to the next 0xff at once
+        unsigned char *marker = memchr(src + i, 0xff, len - i);
+        size_t literals = marker ? (size_t)(marker - src) - i : len - i;
+        buffer_append(output, src + i, literals);
+        i += literals;
+        if (i == len)
+            break;
+
+        size_t item = i++;
+        if (i == len)
+            return item;
+        if (src[i] == 0) {
+            // zero byte following 0xff indicates a 0xff literal
+            // length is always nonzero in a valid token
+            unsigned char byte = 0xff;
+            buffer_append(output, &byte, 1);
+            i++;
+            continue;
+        }
+        if (len - i < size)
+            return item;
+        uint32_t val = 0;
+        for (size_t j = 0; j < size; j++)
+            val |= (uint32_t)src[i + j] << (8 * j);
+        i += size;
+        size_t distance = (val >> lengthBits) & ((1u << distanceBits) - 1);
+        size_t length = val & ((1u << lengthBits) - 1);
+        if (distance == 0 || distance > output->len) {
+            fprintf(stderr, "distance:%5lu, length:%3lu, file length: %luB\n", distance, length, output->len);
+            err_quit("token string out of bounds");
+        }
+        // byte by byte, as the reference may overlap the bytes being written
+        size_t pos = output->len;
+        buffer_pad(output, length);
+        for (size_t j = 0; j < length; j++)
+            output->data[pos + j] = output->data[pos - distance + j];
+    }
+    return len;
+}
+
 /**
  * Decode LZSS payload.
  * @param reader BufferReader for reading input stream.
- * @param decoded_length length of decoded output in bytes
- * @return Buffer containing decoded output
+ * @param history the history the payload was encoded with, or NULL
+ * @param params the token layout
+ * @return Buffer containing decoded output, without the history
  */
-Buffer *decodeLZSSPayloadByteLevel(BufferReader *reader)
+Buffer *decodeLZSSPayloadByteLevel(BufferReader *reader, Buffer *history, LZSSParams params)
 {
     if (!reader)
         err_quit("null pointer when decoding LZSS payload");
 
-    // output buffer
-    Buffer *output = new_buffer();
-    // temp buffer for token expansion
-    Buffer *temp = new_buffer();
-    while (!bufferreader_isFinal(reader)) {
-        unsigned char byte = 0;
-
-        bufferreader_read(reader, &byte, 1);
-
-        if (byte == 0xff) {
-            // token byte, the next bytes will either indicate a two byte token or a one byte 0xff literal
-            unsigned distance = 0;
-            unsigned length = 0;
-            if (readByteToken(reader, &distance, &length) < 1) {
-                fprintf(stderr, "at byte %lu:", output->len);
-                err_quit("failed to read token");
-            }
-            if (length == 0) {
-                // zero byte following 0xff indicates a 0xff literal
-                // length is always nonzero in a valid token
-                byte = 0xff;
-                buffer_append(output, &byte, 1);
-            } else {
-                // copy string indicated by token
-                if (distance > output->len || output->len - distance + length > output->len) {
-                    fprintf(stderr, "distance:%5u, length:%3u, file length: %luB\n", distance, length, output->len);
-                    err_quit("token string out of bounds");
-                }
-            }
-            // read string referenced by token to temp buffer
-            buffer_append(temp, &output->data[output->len - distance], length);
-            // append temp buffer contents to output
-            buffer_concatl(output, temp, length);
-            buffer_clear(temp);
-        } else {
-            // normal literal
-            buffer_append(output, &byte, 1);
+    ByteDecoder *decoder = new_bytedecoder(NULL);
+    startByteDecoder(decoder, history, params);
+    bytedecoder_update(decoder, reader->data->data + reader->pos, reader->data->len - reader->pos);
+    reader->pos = reader->data->len;
+    return bytedecoder_finish(decoder);
+}
+
+/**
+ * Creates a decoder for a byte-level stream, header included, that is given
+ * to it in chunks of any size.
+ * @param history data preceding the output, NULL for the preset dictionary
+ * @return the newly created ByteDecoder
+ */
+ByteDecoder *new_bytedecoder(Buffer *history)
+{
+    ByteDecoder *ret = mcalloc(1, sizeof(ByteDecoder));
+    ret->history = history;
+    ret->output = new_buffer();
+    ret->tail = new_buffer();
+    return ret;
+}
+
+/**
+ * Set the token layout of a decoder and put the data its references may
+ * point into in front of the output.
+ * @param decoder the ByteDecoder
+ * @param history the history the stream was encoded with, or NULL
+ * @param params the token layout
+ */
+void startByteDecoder(ByteDecoder *decoder, Buffer *history, LZSSParams params)
+{
+    if (!lzss_validParameters(params) || params.lengthBits == LZSS_VARIABLE_LENGTH)
+        err_quit("invalid LZSS window or length bits");
+
+    decoder->params = params;
+    decoder->start = history ? history->len : 0;
+    if (history)
+        buffer_append(decoder->output, history->data, history->len);
+    decoder->started = 1;
+}
+
+/**
+ * Decode the next chunk of a stream. A token split between two chunks is
+ * kept until the rest of it arrives.
+ * @param decoder the ByteDecoder
+ * @param src the chunk
+ * @param len length of the chunk
+ */
+void bytedecoder_update(ByteDecoder *decoder, unsigned char *src, size_t len)
+{
+    if (!decoder || (!src && len > 0))
+        err_quit("null pointer decoding LZSS chunk");
+
+    size_t pos = 0;
+    if (decoder->tail->len > 0 || !decoder->started) {
+        // join the start of the chunk to what is left of the previous one,
+        // enough to finish the header or the split token
+        size_t carried = decoder->tail->len;
+        size_t take = len < BYTE_DECODER_TAIL ? len : BYTE_DECODER_TAIL;
+        buffer_append(decoder->tail, src, take);
+        size_t used = 0;
+        if (!decoder->started && (used = readByteHeader(decoder, decoder->tail->data, decoder->tail->len)) == 0)
+            return;
+        used += decodeByteChunk(decoder, decoder->tail->data + used, decoder->tail->len - used);
+        if (used < carried + take && take == len) {
+            // the whole chunk is in the tail, and still ends in a token
+            memmove(decoder->tail->data, decoder->tail->data + used, decoder->tail->len - used);
+            decoder->tail->len -= used;
+            return;
         }
+        pos = used - carried;
+        decoder->tail->len = 0;
+    }
+    pos += decodeByteChunk(decoder, src + pos, len - pos);
+    buffer_append(decoder->tail, src + pos, len - pos);
+}
+
+/**
+ * Hand out the output decoded since the last call, and drop what is out of
+ * reach of the window from the front of the output. The output is only
+ * moved once it is twice the window, so each byte is moved once at most.
+ * @param decoder the ByteDecoder
+ * @param dst the Buffer to append the output to
+ */
+void bytedecoder_take(ByteDecoder *decoder, Buffer *dst)
+{
+    if (!decoder || !dst)
+        err_quit("null pointer taking LZSS output");
+
+    Buffer *output = decoder->output;
+    size_t from = decoder->taken > decoder->start ? decoder->taken : decoder->start;
+    if (output->len > from)
+        buffer_append(dst, output->data + from, output->len - from);
+    decoder->taken = output->len;
+    if (!decoder->started)
+        return;
+
+    size_t window = (size_t)1 << decoder->params.distanceBits;
+    if (output->len >= 2 * window) {
+        size_t drop = output->len - window;
+        memmove(output->data, output->data + drop, window);
+        output->len = window;
+        decoder->start = decoder->start > drop ? decoder->start - drop : 0;
+        decoder->taken = window;
     }
-    delete_buffer(temp);
+}
+
+/**
+ * Check that a stream ended with a whole token and free the decoder.
+ * @param decoder the ByteDecoder to delete
+ * @return the decoded Buffer, without the history and the output already
+ * taken
+ */
+Buffer *bytedecoder_finish(ByteDecoder *decoder)
+{
+    if (!decoder)
+        err_quit("null pointer when finishing LZSS decoding");
+    if (!decoder->started)
+        err_quit("failed to read header");
+    if (decoder->tail->len > 0)
+        err_quit("failed to read token");
 
+    Buffer *output = decoder->output;
+    size_t from = decoder->taken > decoder->start ? decoder->taken : decoder->start;
+    if (from > 0) {
+        memmove(output->data, output->data + from, output->len - from);
+        output->len -= from;
+    }
+    delete_buffer(decoder->tail);
+    free(decoder);
     return output;
 }
+
+/**
+ * Read the header of a stream and start the decoder with its layout.
+ * @param decoder the ByteDecoder
+ * @param src start of the stream
+ * @param len bytes of the stream available
+ * @return size of the header, 0 if it is not complete yet
+ */
+size_t readByteHeader(ByteDecoder *decoder, unsigned char *src, size_t len)
+{
+    if (len < 2 || (src[1] & LZSS_BYTE_DICTIONARY_FLAG && len < 6))
+        return 0;
+
+    LZSSParams params = {src[0], src[1] & ~LZSS_BYTE_DICTIONARY_FLAG, 0};
+    Buffer *dictionary = NULL;
+    if (src[1] & LZSS_BYTE_DICTIONARY_FLAG)
+        dictionary = lzdict_check(decoder->history ? decoder->history : lzss_getDictionary(),
+                src[2] | src[3] << 8 | src[4] << 16 | (uint32_t)src[5] << 24);
+    startByteDecoder(decoder, dictionary, params);
+    return dictionary ? 6 : 2;
+}
+
+/**
+ * Decode the whole items of a part of the stream into the output.
+ * @param decoder the ByteDecoder
+ * @param src the payload
+ * @param len length of the payload
+ * @return amount of bytes decoded, short of a token split by the end
+ */
+size_t decodeByteChunk(ByteDecoder *decoder, unsigned char *src, size_t len)
+{
+    LZSSParams params = decoder->params;
+    if (params.distanceBits == 12 && params.lengthBits == 4)
+        return decodeByteItems(src, len, decoder->output, 12, 4);
+    if (params.distanceBits == 16 && params.lengthBits == 8)
+        return decodeByteItems(src, len, decoder->output, 16, 8);
+    return decodeByteItems(src, len, decoder->output, params.distanceBits, params.lengthBits);
+}
@@ -1,63 +1,491 @@
 #include "../include/lzss_common.h"
+#include "../include/arena.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <string.h>
+
+size_t hashPosition(unsigned char *data);
+size_t findBestMatch(MatchFinder *mf, size_t pos, size_t *distance);
+void appendTokens(LZToken *tokens, size_t count, void *list);
+
+static LZSSParams parameters = {LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS, 0};
+static Buffer *dictionary = NULL;
 
 /**
- * Find string needle from ringbuffer haystack in order. Optimized using KMP
- * (Knuth-Morris-Pratt) algorithm.
- * @param haystack the RingBuffer to check
- * @param needle string to find in the the RingBuffer
- * @return index starting from the end of the array, or -1 if no match
+ * Get the token layout used for compressing with lzss and lzss-byte.
+ * @return the current parameters
  */
-int findMatchKMP(RingBuffer *haystack, Buffer *needle)
+LZSSParams lzss_getParameters()
 {
-    if (!haystack || !needle)
-        err_quit("null pointer in findMatch");
+    return parameters;
+}
 
-    if (needle->len < 1 || haystack->len < 1)
-        return -1;
+/**
+ * Set the token layout used for compressing with lzss and lzss-byte.
+ * @param distanceBits bits for the distance of a reference
+ * @param lengthBits bits for the length of a reference
+ */
+void lzss_setParameters(int distanceBits, int lengthBits)
+{
+    LZSSParams params = {distanceBits, lengthBits, parameters.longRange};
+    if (!lzss_validParameters(params))
+        err_quit("invalid LZSS window or length bits");
+    parameters = params;
+}
 
-    int ringBufferPosition = 0;
-    int matchPosition = 0;
+/**
+ * Enable or disable long-range matching for lzss. Long-range references are
+ * only possible with variable-length tokens.
+ * @param enabled 1 to look for long repeats at any distance, 0 not to
+ */
+void lzss_setLongRange(int enabled)
+{
+    LZSSParams params = parameters;
+    params.longRange = enabled != 0;
+    if (!lzss_validParameters(params))
+        err_quit("long-range matching needs variable-length tokens");
+    parameters = params;
+}
 
-    int KMPTable[TOKEN_MAXLEN] = {0};
-    genKMPTable(needle, KMPTable);
-    
-    while (ringBufferPosition < haystack->len && ringBufferPosition < WINDOW_SIZE) {
-        unsigned char c = ringbuffer_get(haystack, ringBufferPosition);
-        if (c == needle->data[matchPosition]) {
-            ringBufferPosition++;
-            matchPosition++;
-            if (matchPosition == needle->len)
-                return haystack->len - (ringBufferPosition - needle->len);
-        } else {
-            matchPosition = KMPTable[matchPosition];
-            if (matchPosition < 0) {
-                ringBufferPosition++;
-                matchPosition++;
+/**
+ * Get the preset dictionary of lzss and lzss-byte.
+ * @return the dictionary, NULL if none
+ */
+Buffer *lzss_getDictionary()
+{
+    return dictionary;
+}
+
+/**
+ * Set a preset dictionary for lzss and lzss-byte. The dictionary is used as
+ * history before the data, so that even short inputs find matches. Streams
+ * compressed with a dictionary need the same one for extracting. The caller
+ * keeps ownership of the Buffer.
+ * @param dict the dictionary, NULL for none
+ */
+void lzss_setDictionary(Buffer *dict)
+{
+    dictionary = dict;
+}
+
+/**
+ * Check that a token layout is within the supported limits.
+ * @param params the parameters to check
+ * @return 1 if valid, 0 otherwise
+ */
+int lzss_validParameters(LZSSParams params)
+{
+    return params.distanceBits >= LZSS_MIN_DISTANCE_BITS && params.distanceBits <= LZSS_MAX_DISTANCE_BITS
+        && ((params.lengthBits >= LZSS_MIN_LENGTH_BITS && params.lengthBits <= LZSS_MAX_LENGTH_BITS)
+            || params.lengthBits == LZSS_VARIABLE_LENGTH)
+        && (!params.longRange || params.lengthBits == LZSS_VARIABLE_LENGTH);
+}
+
+/**
+ * Allocates a hash chain match finder over a block of data. No positions
+ * are inserted yet.
+ * @param data the data to search
+ * @param len length of the data
+ * @param window maximum distance + 1, a power of two
+ * @param maxLen longest match to look for
+ * @param chainLimit maximum amount of candidates visited per search
+ * @return the newly created MatchFinder
+ */
+MatchFinder *new_matchfinder(unsigned char *data, size_t len, size_t window, size_t maxLen, int chainLimit)
+{
+    if (!data)
+        err_quit("null pointer creating match finder");
+    if (window == 0 || (window & (window - 1)) != 0)
+        err_quit("match finder window must be a power of two");
+
+    MatchFinder *ret = mmalloc(sizeof(MatchFinder));
+    ret->data = data;
+    ret->len = len;
+    ret->window = window;
+    ret->maxLen = maxLen;
+    ret->chainLimit = chainLimit;
+    ret->repeats = 0;
+    memset(ret->reps, 0, sizeof(ret->reps));
+    // the tables are reused between blocks on threads with an arena
+    ret->head = arena_alloc(ARENA_MATCH_HEAD, ((size_t)1 << MATCH_HASH_BITS) * sizeof(ssize_t));
+    ret->prev = arena_alloc(ARENA_MATCH_PREV, window * sizeof(ssize_t));
+    memset(ret->head, 0xff, ((size_t)1 << MATCH_HASH_BITS) * sizeof(ssize_t));
+    return ret;
+}
+
+/**
+ * Frees memory allocated for MatchFinder. The data is not freed.
+ * @param mf the MatchFinder to delete
+ */
+void delete_matchfinder(MatchFinder *mf)
+{
+    if (!mf)
+        err_quit("null pointer when deleting match finder");
+
+    arena_free(ARENA_MATCH_HEAD, mf->head);
+    arena_free(ARENA_MATCH_PREV, mf->prev);
+    free(mf);
+}
+
+/**
+ * Hash the first MATCH_MIN bytes at a position.
+ * @param data pointer to the position
+ * @return hash value of MATCH_HASH_BITS bits
+ */
+size_t hashPosition(unsigned char *data)
+{
+    uint32_t val = data[0] | data[1] << 8 | data[2] << 16;
+    return (val * 2654435761u) >> (32 - MATCH_HASH_BITS);
+}
+
+/**
+ * Make a position available as a match candidate for later positions.
+ * Positions must be inserted in increasing order.
+ * @param mf the match finder
+ * @param pos the position to insert
+ */
+void matchfinder_insert(MatchFinder *mf, size_t pos)
+{
+    if (pos + MATCH_MIN > mf->len)
+        return;
+    size_t hash = hashPosition(mf->data + pos);
+    mf->prev[pos & (mf->window - 1)] = mf->head[hash];
+    mf->head[hash] = pos;
+}
+
+/**
+ * Insert the positions of a block that is not searched for matches, such as
+ * history before the coded data. Only the last window of them is inserted,
+ * as older positions would be out of reach of later ones.
+ * @param mf the match finder
+ * @param start the first position of the block
+ * @param end the position after the block
+ */
+void matchfinder_skip(MatchFinder *mf, size_t start, size_t end)
+{
+    if (end - start > mf->window)
+        start = end - mf->window;
+    for (size_t pos = start; pos < end; pos++)
+        matchfinder_insert(mf, pos);
+}
+
+/**
+ * Find the longest match for a position among the inserted positions within
+ * the window. The position itself should not be inserted yet.
+ * @param mf the match finder
+ * @param pos the position to find a match for
+ * @param distance destination for the distance of the match
+ * @return length of the match, 0 if no match of at least MATCH_MIN bytes
+ */
+size_t matchfinder_find(MatchFinder *mf, size_t pos, size_t *distance)
+{
+    if (pos + MATCH_MIN > mf->len)
+        return 0;
+    size_t maxLen = mf->len - pos < mf->maxLen ? mf->len - pos : mf->maxLen;
+    unsigned char *current = mf->data + pos;
+    size_t best = 0;
+    ssize_t candidate = mf->head[hashPosition(current)];
+    for (int chain = mf->chainLimit; candidate >= 0 && chain > 0; chain--) {
+        if (pos - candidate >= mf->window)
+            break;
+        unsigned char *match = mf->data + candidate;
+        // check the byte that would make the match longer first
+        if (match[best] == current[best] && match[0] == current[0]) {
+            size_t len = 0;
+            while (len < maxLen && match[len] == current[len])
+                len++;
+            if (len > best) {
+                best = len;
+                *distance = pos - candidate;
+                if (len == maxLen)
+                    break;
             }
         }
+        candidate = mf->prev[candidate & (mf->window - 1)];
     }
-    return -1;
+    return best >= MATCH_MIN ? best : 0;
 }
 
 /**
- * Generate Knuth-Morris-Pratt table for a string.
- * Assuming result table is the same size as the string.
- * @param needle string to analyze
- * @param table pointer to table to use
+ * Find a match for a position, trying the recent distances first when the
+ * match finder keeps them. A repeat match is taken over a hash chain match
+ * at most one byte longer, as its distance costs next to nothing, and a long
+ * enough one skips the hash chain search altogether.
+ * @param mf the match finder
+ * @param pos the position to find a match for
+ * @param distance destination for the distance of the match
+ * @return length of the match, 0 if no match of at least MATCH_MIN bytes
  */
-void genKMPTable(Buffer *needle, int *table)
+size_t findBestMatch(MatchFinder *mf, size_t pos, size_t *distance)
 {
-    // set initial value
-    table[0] = -1;
-    // walk through string
-    for (int pos = 1, cnd = 0; pos < needle->len; pos++, cnd++) {
-        if (needle->data[pos] == needle->data[cnd]) {
-            table[pos] = table[cnd];
+    size_t repLen = 0, repDistance = 0;
+    size_t maxLen = mf->len - pos < mf->maxLen ? mf->len - pos : mf->maxLen;
+    for (int i = 0; i < mf->repeats; i++) {
+        size_t d = mf->reps[i];
+        if (d == 0 || d > pos || d >= mf->window)
+            continue;
+        unsigned char *current = mf->data + pos, *match = current - d;
+        size_t len = 0;
+        while (len < maxLen && match[len] == current[len])
+            len++;
+        if (len > repLen) {
+            repLen = len;
+            repDistance = d;
+        }
+    }
+    if (repLen >= MATCH_MIN && (repLen >= MATCH_REP_GOOD || repLen == maxLen)) {
+        *distance = repDistance;
+        return repLen;
+    }
+    size_t len = matchfinder_find(mf, pos, distance);
+    if (repLen >= MATCH_MIN && repLen + 1 >= len) {
+        *distance = repDistance;
+        return repLen;
+    }
+    return len;
+}
+
+/**
+ * Split data into literals and back references with lazy matching: before
+ * taking a match, the next position is checked for a longer one, in which
+ * case a literal is output instead. Positions before start are used as
+ * history only and must have been inserted by the caller.
+ * @param mf the match finder over the data
+ * @param start the first position to code
+ * @param count destination for the amount of tokens
+ * @return the tokens, to be freed by the caller
+ */
+LZToken *parseTokens(MatchFinder *mf, size_t start, size_t *count)
+{
+    if (!mf || !count)
+        err_quit("null pointer parsing tokens");
+
+    TokenList list = {mmalloc(1024 * sizeof(LZToken)), 0, 1024};
+    parseTokensTo(mf, start, appendTokens, &list);
+    *count = list.count;
+    return list.tokens;
+}
+
+/**
+ * Token sink of parseTokens: append a batch to a TokenList.
+ * @param tokens the batch
+ * @param count amount of tokens in the batch
+ * @param list the TokenList
+ */
+void appendTokens(LZToken *tokens, size_t count, void *list)
+{
+    TokenList *l = list;
+    if (l->count + count > l->capacity) {
+        while (l->count + count > l->capacity)
+            l->capacity *= 2;
+        l->tokens = mrealloc(l->tokens, l->capacity * sizeof(LZToken));
+    }
+    memcpy(l->tokens + l->count, tokens, count * sizeof(LZToken));
+    l->count += count;
+}
+
+/**
+ * Parse data into tokens like parseTokens, handing them to a sink in
+ * batches as the parse goes on, so that the tokens can be coded while the
+ * rest of the input is still being parsed.
+ * @param mf the match finder over the data
+ * @param start the first position to code
+ * @param sink the function to call with each batch
+ * @param arg argument passed to the sink
+ */
+void parseTokensTo(MatchFinder *mf, size_t start, TokenSink sink, void *arg)
+{
+    if (!mf || !sink)
+        err_quit("null pointer parsing tokens");
+
+    LZToken tokens[PARSE_BATCH_TOKENS];
+    size_t n = 0;
+    size_t pos = start, distance = 0, nextDistance = 0;
+    size_t len = findBestMatch(mf, pos, &distance);
+    matchfinder_insert(mf, pos);
+    while (pos < mf->len) {
+        if (n == PARSE_BATCH_TOKENS) {
+            sink(tokens, n, arg);
+            n = 0;
+        }
+        if (len > 0 && len < mf->maxLen) {
+            size_t next = findBestMatch(mf, pos + 1, &nextDistance);
+            if (next > len) {
+                // a longer match starts at the next byte
+                tokens[n].distance = 0;
+                tokens[n++].length = mf->data[pos++];
+                matchfinder_insert(mf, pos);
+                len = next;
+                distance = nextDistance;
+                continue;
+            }
+        }
+        if (len > 0) {
+            tokens[n].distance = distance;
+            tokens[n++].length = len;
+            if (mf->repeats > 0)
+                updateRepeats(mf->reps, distance);
+            for (size_t i = 1; i < len; i++)
+                matchfinder_insert(mf, pos + i);
+            pos += len;
         } else {
-            table[pos] = cnd;
-            while (cnd >= 0 && needle->data[pos] != needle->data[cnd])
-                cnd = table[cnd];
+            tokens[n].distance = 0;
+            tokens[n++].length = mf->data[pos++];
         }
+        len = findBestMatch(mf, pos, &distance);
+        matchfinder_insert(mf, pos);
     }
+    if (n > 0)
+        sink(tokens, n, arg);
 }
 
+/**
+ * Find a distance among the recent distances.
+ * @param reps MATCH_REPS recent distances, latest first
+ * @param distance the distance to look for
+ * @return its index, -1 if not found
+ */
+int findRepeat(size_t *reps, size_t distance)
+{
+    for (int i = 0; i < MATCH_REPS; i++)
+        if (reps[i] == distance)
+            return i;
+    return -1;
+}
+
+/**
+ * Make a distance the latest of the recent distances. A distance already
+ * among them moves to the front, otherwise the oldest one is dropped. The
+ * parser, the coder and the decoder of variable-length tokens all update
+ * their recent distances here, with every match, so that the repeats the
+ * parser picks are the ones the coder refers to.
+ * @param reps MATCH_REPS recent distances, latest first
+ * @param distance the distance that was used
+ * @return its index among the recent distances before, -1 if it was not
+ * among them
+ */
+int updateRepeats(size_t *reps, size_t distance)
+{
+    int found = findRepeat(reps, distance);
+    int i = found < 0 ? MATCH_REPS - 1 : found;
+    for (; i > 0; i--)
+        reps[i] = reps[i - 1];
+    reps[0] = distance;
+    return found;
+}
+
+/**
+ * Map a value to a logarithmic bucket, as DEFLATE does for lengths and
+ * distances. Values below 4 have buckets of their own; larger values share
+ * a bucket with values of the same magnitude and second highest bit, and
+ * the bits below those are stored as extra bits.
+ * @param value the value to map
+ * @param extraBits destination for the amount of extra bits
+ * @return the bucket
+ */
+int valueToBucket(size_t value, int *extraBits)
+{
+    if (value < 4) {
+        *extraBits = 0;
+        return value;
+    }
+    int n = 0;
+    while (value >> (n + 1))
+        n++;
+    *extraBits = n - 1;
+    return 2 * n + ((value >> (n - 1)) & 1);
+}
+
+/**
+ * Get the smallest value of a bucket.
+ * @param bucket the bucket from valueToBucket
+ * @param extraBits destination for the amount of extra bits
+ * @return the smallest value in the bucket
+ */
+size_t bucketBase(int bucket, int *extraBits)
+{
+    if (bucket < 4) {
+        *extraBits = 0;
+        return bucket;
+    }
+    int n = bucket / 2;
+    *extraBits = n - 1;
+    return (size_t)(2 + (bucket & 1)) << (n - 1);
+}
+
+/**
+ * Find long repeats at any distance with a rolling hash. A gear hash of the
+ * last LONG_HASH_WINDOW bytes is updated at every position, and positions
+ * whose hash has its top LONG_SAMPLE_BITS bits clear are sampled. Sampling
+ * depends on the content only, so both copies of a repeat are sampled at the
+ * same places, while the table of samples stays a fraction of the input and
+ * never grows beyond 1 << LONG_MAX_TABLE_BITS entries. A sample that hits an
+ * earlier one with the same bytes is extended both ways into a match.
+ * @param data the data to search
+ * @param len length of the data
+ * @param start the first position to report matches at, the data before it
+ * is history that matches may only refer to
+ * @param minDistance shortest distance to report, nearer repeats are left
+ * to the match finder
+ * @param count destination for the amount of matches
+ * @return non-overlapping matches of at least LONG_MIN_MATCH bytes in order
+ * of position, to be freed by the caller
+ */
+LongMatch *findLongMatches(unsigned char *data, size_t len, size_t start, size_t minDistance, size_t *count)
+{
+    if (!data || !count)
+        err_quit("null pointer finding long-range matches");
+
+    size_t capacity = 16, n = 0;
+    LongMatch *matches = mmalloc(capacity * sizeof(LongMatch));
+    // a fixed pseudorandom value for each byte, from splitmix64
+    uint64_t gear[256], seed = 0;
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15u);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+        gear[i] = z ^ (z >> 31);
+    }
+    int tableBits = LONG_MIN_TABLE_BITS;
+    while (tableBits < LONG_MAX_TABLE_BITS && ((size_t)1 << tableBits) < len >> LONG_SAMPLE_BITS)
+        tableBits++;
+    size_t *table = mcalloc((size_t)1 << tableBits, sizeof(size_t)); // sampled position + 1
+    uint64_t hash = 0;
+    size_t covered = start; // end of the latest match
+    for (size_t pos = 0; pos < len; pos++) {
+        // the bytes older than LONG_HASH_WINDOW are shifted out
+        hash = (hash << 1) + gear[data[pos]];
+        if (pos + 1 < LONG_HASH_WINDOW || hash >> (64 - LONG_SAMPLE_BITS) != 0)
+            continue;
+        size_t sample = pos + 1 - LONG_HASH_WINDOW;
+        size_t slot = (hash >> (64 - LONG_SAMPLE_BITS - tableBits)) & (((size_t)1 << tableBits) - 1);
+        size_t candidate = table[slot];
+        table[slot] = sample + 1;
+        if (candidate == 0 || sample < covered)
+            continue;
+        candidate--;
+        if (sample - candidate < minDistance || memcmp(data + candidate, data + sample, LONG_HASH_WINDOW) != 0)
+            continue;
+        size_t back = 0;
+        while (back < candidate && sample - back > covered && data[candidate - back - 1] == data[sample - back - 1])
+            back++;
+        size_t length = LONG_HASH_WINDOW + back;
+        sample -= back;
+        candidate -= back;
+        while (sample + length < len && data[candidate + length] == data[sample + length])
+            length++;
+        if (length < LONG_MIN_MATCH)
+            continue;
+        if (n == capacity) {
+            capacity *= 2;
+            matches = mrealloc(matches, capacity * sizeof(LongMatch));
+        }
+        matches[n].pos = sample;
+        matches[n].distance = sample - candidate;
+        matches[n++].length = length;
+        covered = sample + length;
+    }
+    free(table);
+    *count = n;
+    return matches;
+}
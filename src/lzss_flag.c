@@ -0,0 +1,162 @@
+#include "../include/lzss_flag.h"
+#include "../include/lzss_flag_private.h"
+#include "../include/lzss_common.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <stdint.h>
+
+/**
+ * Compresses Buffer using LZSS with flag bytes, in the layout of Okumura's
+ * LZSS.C: a flag byte tells whether each of the next 8 items is a literal
+ * (0) or a reference (1). Literals take a byte and references two, so every
+ * item stays byte-aligned and no escaping is needed.
+ * The output starts with the decoded length as a variable length integer.
+ * @param src input Buffer
+ * @return LZSS-compressed output
+ */
+Buffer *lzss_flag_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in lzss_flag_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    MatchFinder *mf = new_matchfinder(src->data, src->len, LZSS_FLAG_WINDOW, LZSS_FLAG_MAXLEN, LZSS_FLAG_CHAIN_LIMIT);
+    size_t count;
+    LZToken *tokens = parseTokens(mf, 0, &count);
+    delete_matchfinder(mf);
+
+    Buffer *compressed = new_buffer();
+    buffer_appendVarint(compressed, src->len);
+    encodeLZSSPayloadFlagLevel(tokens, count, compressed);
+    free(tokens);
+    return compressed;
+}
+
+/**
+ * Encode tokens in groups of 8 behind a flag byte. References are written
+ * as a little-endian 16-bit value: 12 bits of distance - 1 and 4 bits of
+ * length - MATCH_MIN.
+ * @param tokens the tokens to encode
+ * @param count amount of tokens
+ * @param dst the destination Buffer
+ */
+void encodeLZSSPayloadFlagLevel(LZToken *tokens, size_t count, Buffer *dst)
+{
+    if (!tokens || !dst)
+        err_quit("null pointer in encodeLZSSPayloadFlagLevel");
+
+    for (size_t i = 0; i < count; i += 8) {
+        size_t flagPos = dst->len;
+        unsigned char flags = 0;
+        buffer_append(dst, &flags, 1);
+        for (size_t j = 0; j < 8 && i + j < count; j++) {
+            LZToken *token = tokens + i + j;
+            if (token->distance == 0) {
+                unsigned char c = token->length;
+                buffer_append(dst, &c, 1);
+                continue;
+            }
+            if (token->distance > LZSS_FLAG_WINDOW || token->length < MATCH_MIN || token->length > LZSS_FLAG_MAXLEN)
+                err_quit("invalid reference token");
+            flags |= 1 << j;
+            uint16_t val = (token->distance - 1) << LZSS_FLAG_LENGTH_BITS | (token->length - MATCH_MIN);
+            unsigned char bytes[2] = {val & 0xff, val >> 8};
+            buffer_append(dst, bytes, 2);
+        }
+        dst->data[flagPos] = flags;
+    }
+}
+
+/**
+ * Build the flag byte decoding table.
+ * @param table destination for 256 entries
+ */
+void buildFlagTable(FlagEntry *table)
+{
+    for (int flags = 0; flags < 256; flags++) {
+        int size = 8, literals = 0;
+        for (int bit = 0; bit < 8; bit++)
+            size += flags >> bit & 1;
+        while (literals < 8 && !(flags >> literals & 1))
+            literals++;
+        table[flags].size = size;
+        table[flags].literals = literals;
+    }
+}
+
+/**
+ * Decode LZSS payload with flag bytes. When the whole group of 8 items is
+ * known to be in bounds, the input and output checks are done once for the
+ * group using the flag table, and the literals before the first reference
+ * are copied at once.
+ * @param src start of the payload
+ * @param len length of the payload
+ * @param dst the output Buffer, preallocated to the decoded length
+ */
+void decodeLZSSPayloadFlagLevel(unsigned char *src, size_t len, Buffer *dst)
+{
+    if (!src || !dst)
+        err_quit("null pointer when decoding LZSS payload");
+
+    FlagEntry table[256];
+    buildFlagTable(table);
+    unsigned char *in = src, *end = src + len;
+    unsigned char *out = dst->data;
+    size_t pos = 0;
+    while (pos < dst->len) {
+        if (in == end)
+            err_quit("unexpected end of file while reading payload");
+        unsigned flags = *in++;
+        FlagEntry entry = table[flags];
+        int item = 0;
+        int fast = end - in >= entry.size - 1 && dst->len - pos >= 8 * LZSS_FLAG_MAXLEN;
+        if (fast) {
+            memcpy(out + pos, in, entry.literals);
+            in += entry.literals;
+            pos += entry.literals;
+            item = entry.literals;
+        }
+        for (; item < 8 && pos < dst->len; item++) {
+            if (!(flags >> item & 1)) {
+                if (!fast && in == end)
+                    err_quit("unexpected end of file while reading payload");
+                out[pos++] = *in++;
+                continue;
+            }
+            if (!fast && end - in < 2)
+                err_quit("unexpected end of file while reading token");
+            unsigned val = in[0] | in[1] << 8;
+            in += 2;
+            size_t distance = (val >> LZSS_FLAG_LENGTH_BITS) + 1;
+            size_t length = (val & ((1 << LZSS_FLAG_LENGTH_BITS) - 1)) + MATCH_MIN;
+            if (distance > pos || (!fast && length > dst->len - pos))
+                err_quit("token string out of bounds");
+            for (size_t i = 0; i < length; i++, pos++)
+                out[pos] = out[pos - distance];
+        }
+    }
+}
+
+/**
+ * Decompress LZSS-compressed Buffer with flag bytes.
+ * @param src compressed source Buffer
+ * @return decompressed Buffer
+ */
+Buffer *lzss_flag_extract(Buffer *src)
+{
+    if (!src || src->len == 0)
+        err_quit("file is empty, skipping extraction\n");
+
+    BufferReader *reader = buffer_createReader(src);
+    size_t decoded_length;
+    if (bufferreader_readVarint(reader, &decoded_length) < 1)
+        err_quit("failed to read header");
+    Buffer *decompressed = new_buffer();
+    buffer_pad(decompressed, decoded_length);
+    decodeLZSSPayloadFlagLevel(src->data + reader->pos, src->len - reader->pos, decompressed);
+    delete_bufferreader(reader);
+    return decompressed;
+}
@@ -0,0 +1,221 @@
+#include "../include/lzss_split.h"
+#include "../include/lzss_split_private.h"
+#include "../include/lzss_common.h"
+#include "../include/huffman.h"
+#include "../include/huffman_private.h"
+#include "../include/ans.h"
+#include "../include/ans_private.h"
+#include "../include/bitarray.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+
+/**
+ * Compresses a Buffer using LZSS with the token fields written to separate
+ * streams: flag bits, literals, match lengths and the high and low bytes of
+ * match distances. Each stream has statistics of its own, so it is entropy
+ * coded on its own with either Huffman or tANS, whichever is smaller.
+ * @param src the source buffer to compress
+ * @return compressed version of the given buffer
+ */
+Buffer *lzss_split_compress(Buffer *src)
+{
+    if (!src)
+        err_quit("null pointer in lzss_split_compress");
+    if (src->len == 0) {
+        fputs("file is empty, skipping compression\n", stderr);
+        return src;
+    }
+
+    MatchFinder *mf = new_matchfinder(src->data, src->len, LZSS_SPLIT_WINDOW, LZSS_SPLIT_MAXLEN, LZSS_SPLIT_CHAIN_LIMIT);
+    size_t count;
+    LZToken *tokens = parseTokens(mf, 0, &count);
+    delete_matchfinder(mf);
+    Buffer *streams[LZSS_SPLIT_STREAMS];
+    splitTokens(tokens, count, streams);
+    free(tokens);
+
+    BitArray *output = new_bitarray();
+    bitarray_writeInteger(output, src->len);
+    for (int i = 0; i < LZSS_SPLIT_STREAMS; i++) {
+        size_t start = output->len;
+        int coder = encodeStream(streams[i], output);
+        fprintf(stderr, "stream %d: %lu bytes, coded with %s to %lu bytes\n", i, streams[i]->len,
+                coder == SPLIT_ANS ? "tANS" : "Huffman", (output->len - start + 7) / 8);
+        delete_buffer(streams[i]);
+    }
+    return bitarray_deleteAndConvertToBuffer(output);
+}
+
+/**
+ * Write the fields of tokens to separate streams. The flag stream has a bit
+ * for every token, 1 for a reference, packed 8 to a byte starting from the
+ * least significant bit.
+ * @param tokens the tokens to split
+ * @param count amount of tokens
+ * @param streams destination for LZSS_SPLIT_STREAMS new Buffers
+ */
+void splitTokens(LZToken *tokens, size_t count, Buffer **streams)
+{
+    if (!tokens || !streams)
+        err_quit("null pointer splitting tokens");
+
+    for (int i = 0; i < LZSS_SPLIT_STREAMS; i++)
+        streams[i] = new_buffer();
+    buffer_pad(streams[SPLIT_FLAGS], (count + 7) / 8);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char byte;
+        if (tokens[i].distance == 0) {
+            byte = tokens[i].length;
+            buffer_append(streams[SPLIT_LITERALS], &byte, 1);
+            continue;
+        }
+        streams[SPLIT_FLAGS]->data[i / 8] |= 1 << (i % 8);
+        byte = tokens[i].length - MATCH_MIN;
+        buffer_append(streams[SPLIT_LENGTHS], &byte, 1);
+        byte = (tokens[i].distance - 1) >> 8;
+        buffer_append(streams[SPLIT_DISTANCE_HIGH], &byte, 1);
+        byte = (tokens[i].distance - 1) & 0xff;
+        buffer_append(streams[SPLIT_DISTANCE_LOW], &byte, 1);
+    }
+}
+
+/**
+ * Entropy code a stream. The stream is written as its length, a bit telling
+ * the coder, and the blocks of that coder. Both coders are tried and the
+ * smaller output is kept.
+ * @param stream the stream to encode
+ * @param dst the destination BitArray
+ * @return the coder used, SPLIT_HUFFMAN or SPLIT_ANS
+ */
+int encodeStream(Buffer *stream, BitArray *dst)
+{
+    if (!stream || !dst)
+        err_quit("null pointer in encodeStream");
+
+    bitarray_writeInteger(dst, stream->len);
+    if (stream->len == 0)
+        return SPLIT_HUFFMAN;
+
+    BitArray *huffman = new_bitarray();
+    HuffCode *previous = NULL;
+    int mode;
+    for (size_t pos = 0; pos < stream->len; pos += HUFFMAN_BLOCK_SIZE) {
+        size_t len = stream->len - pos < HUFFMAN_BLOCK_SIZE ? stream->len - pos : HUFFMAN_BLOCK_SIZE;
+        encodeHuffmanBlock(stream->data + pos, len, huffman, &previous, &mode);
+    }
+    if (previous)
+        delete_huffcode(previous);
+    BitArray *ans = new_bitarray();
+    for (size_t pos = 0; pos < stream->len; pos += ANS_BLOCK_SIZE) {
+        size_t len = stream->len - pos < ANS_BLOCK_SIZE ? stream->len - pos : ANS_BLOCK_SIZE;
+        encodeANSBlock(stream->data + pos, len, ans);
+    }
+
+    int coder = ans->len < huffman->len ? SPLIT_ANS : SPLIT_HUFFMAN;
+    bitarray_appendBits(dst, coder, 1);
+    bitarray_concat(dst, coder == SPLIT_ANS ? ans : huffman);
+    delete_bitarray(huffman);
+    delete_bitarray(ans);
+    return coder;
+}
+
+/**
+ * Decode a stream written by encodeStream.
+ * @param reader BitArrayReader positioned at the stream
+ * @return the decoded stream
+ */
+Buffer *decodeStream(BitArrayReader *reader)
+{
+    if (!reader)
+        err_quit("null pointer in decodeStream");
+
+    size_t length = bitarrayreader_readInteger(reader);
+    Buffer *ret = new_buffer();
+    if (length == 0)
+        return ret;
+    uint32_t coder;
+    if (bitarrayreader_readBits(reader, 1, &coder) < 1)
+        err_quit("unexpected end of file while reading stream header");
+    if (coder == SPLIT_ANS) {
+        for (size_t pos = 0; pos < length; pos += ANS_BLOCK_SIZE)
+            decodeANSBlock(reader, ret, length - pos < ANS_BLOCK_SIZE ? length - pos : ANS_BLOCK_SIZE);
+        return ret;
+    }
+    HuffCode *previous = NULL;
+    for (size_t pos = 0; pos < length; pos += HUFFMAN_BLOCK_SIZE)
+        decodeHuffmanBlock(reader, ret, length - pos < HUFFMAN_BLOCK_SIZE ? length - pos : HUFFMAN_BLOCK_SIZE, &previous);
+    if (previous)
+        delete_huffcode(previous);
+    return ret;
+}
+
+/**
+ * Rebuild the original data from the decoded streams. Each field is read
+ * from its own stream in order, so the loop only branches on the flag bit.
+ * @param streams the LZSS_SPLIT_STREAMS decoded streams
+ * @param len decoded length
+ * @return the decoded data
+ */
+Buffer *mergeStreams(Buffer **streams, size_t len)
+{
+    if (!streams)
+        err_quit("null pointer merging streams");
+
+    Buffer *ret = new_buffer();
+    buffer_pad(ret, len);
+    unsigned char *out = ret->data;
+    unsigned char *flags = streams[SPLIT_FLAGS]->data;
+    unsigned char *literals = streams[SPLIT_LITERALS]->data;
+    unsigned char *lengths = streams[SPLIT_LENGTHS]->data;
+    unsigned char *high = streams[SPLIT_DISTANCE_HIGH]->data;
+    unsigned char *low = streams[SPLIT_DISTANCE_LOW]->data;
+    size_t literalCount = streams[SPLIT_LITERALS]->len;
+    size_t matchCount = streams[SPLIT_LENGTHS]->len;
+    if (streams[SPLIT_DISTANCE_HIGH]->len != matchCount || streams[SPLIT_DISTANCE_LOW]->len != matchCount
+            || streams[SPLIT_FLAGS]->len < (literalCount + matchCount + 7) / 8)
+        err_quit("stream lengths do not match");
+
+    size_t pos = 0, literal = 0, match = 0;
+    for (size_t token = 0; pos < len; token++) {
+        if (!(flags[token / 8] >> (token % 8) & 1)) {
+            if (literal == literalCount)
+                err_quit("ran out of literals");
+            out[pos++] = literals[literal++];
+            continue;
+        }
+        if (match == matchCount)
+            err_quit("ran out of references");
+        size_t length = lengths[match] + MATCH_MIN;
+        size_t distance = (high[match] << 8 | low[match]) + 1;
+        match++;
+        if (distance > pos || length > len - pos)
+            err_quit("token string out of bounds");
+        for (size_t i = 0; i < length; i++, pos++)
+            out[pos] = out[pos - distance];
+    }
+    return ret;
+}
+
+/**
+ * Decompress a Buffer compressed with lzss_split_compress.
+ * @param src compressed input
+ * @return decompressed Buffer
+ */
+Buffer *lzss_split_extract(Buffer *src)
+{
+    if (src->len == 0)
+        err_quit("file is empty, skipping extraction\n");
+
+    BitArray *data = bitarray_fromBuffer(src);
+    BitArrayReader *reader = bitarray_createReader(data);
+    size_t decoded_length = bitarrayreader_readInteger(reader);
+    Buffer *streams[LZSS_SPLIT_STREAMS];
+    for (int i = 0; i < LZSS_SPLIT_STREAMS; i++)
+        streams[i] = decodeStream(reader);
+    Buffer *ret = mergeStreams(streams, decoded_length);
+    for (int i = 0; i < LZSS_SPLIT_STREAMS; i++)
+        delete_buffer(streams[i]);
+    delete_bitarrayreader(reader);
+    delete_bitarrayPreserveContents(data);
+    return ret;
+}
@@ -2,8 +2,23 @@
 #include "../include/error.h"
 #include "../include/fileops.h"
 #include "../include/huffman.h"
+#include "../include/huffman_tables.h"
+#include "../include/ahuffman.h"
+#include "../include/huffman_o1.h"
+#include "../include/ans.h"
+#include "../include/lzans.h"
 #include "../include/lzss.h"
+#include "../include/lzss_common.h"
 #include "../include/lzss_byte.h"
+#include "../include/lzhf.h"
+#include "../include/lzss_split.h"
+#include "../include/lzss_flag.h"
+#include "../include/lzfast.h"
+#include "../include/lzdict.h"
+#include "../include/block.h"
+#include "../include/threadpool.h"
+#include "../include/stream.h"
+#include "../include/container.h"
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,27 +26,49 @@
 #include <unistd.h>
 #include <sys/time.h>
 
-enum algorithm_enum {HUFFMAN = 0, LZSS, LZSS_BYTE, LZHF};
-enum mode_enum {COMPRESS = 0, EXTRACT, BENCHMARK};
+// the values are the algorithm IDs of the container, so new algorithms go to the end
+enum algorithm_enum {HUFFMAN = 0, LZSS, LZSS_BYTE, LZHF, AHUFFMAN, HUFFMAN_O1, ANS, LZANS, LZHF2, LZSS_SPLIT, LZSS_FLAG, FAST};
+enum mode_enum {COMPRESS = 0, EXTRACT, BENCHMARK, TRAIN, TRAIN_DICTIONARY};
+enum long_option_enum {OPTION_TRAIN = 256, OPTION_PATCH_FROM, OPTION_INDEPENDENT};
 
 void usage();
 Buffer *processData(Buffer *data, Buffer *(*algorithmFunction)(Buffer*), enum mode_enum mode);
 void benchmark(Buffer *data, enum algorithm_enum algorithm);
+void processStream(int in, int out, StreamEncoder *encoder, StreamDecoder *decoder, Buffer *output);
 
-Buffer *lzhf_compress(Buffer *data);
-Buffer *lzhf_extract(Buffer *data);
+PrimedCodec primedFunction(enum algorithm_enum algorithm, enum mode_enum mode);
+Buffer *blocked_compress(Buffer *data);
+Buffer *blocked_extract(Buffer *data);
+
+static int threads = 0; // 0 unless the input is processed in blocks
+static ThreadPool *pool = NULL; // created for the first blocks, reused after that
+static BlockCodec blockCodec = NULL;
+static PrimedCodec primedCodec = NULL; // used for the blocks if the algorithm supports history
+static int independent = 0; // compress blocks without history, so they can be extracted in parallel
 
 int main(int argc, char **argv)
 {
     int ch;
-    char *infile = "-", *outfile = "-";
+    char *infile = "-", *outfile = "-", *tablefile = NULL, *dictfile = NULL, *sampledir = NULL, *patchfile = NULL;
+    int distanceBits = LZSS_DEFAULT_DISTANCE_BITS, lengthBits = LZSS_DEFAULT_LENGTH_BITS, longRange = 0, windowSet = 0;
+    int streaming = 0;
+    size_t budget = 0;
+    int input = -1, framed = 0;
+    Buffer *data = NULL;
+    ContainerHeader header = {0};
     enum algorithm_enum algorithm = HUFFMAN;
     enum mode_enum mode = BENCHMARK;
     Buffer *(*algorithmFunction)(Buffer*) = NULL;
     if (argc == 1)
         usage();
 
-    while ((ch = getopt(argc, argv, "a:bcei:o:")) != -1) {
+    struct option longOptions[] = {
+        {"train", required_argument, NULL, OPTION_TRAIN},
+        {"patch-from", required_argument, NULL, OPTION_PATCH_FROM},
+        {"independent", no_argument, NULL, OPTION_INDEPENDENT},
+        {NULL, 0, NULL, 0}
+    };
+    while ((ch = getopt_long(argc, argv, "a:bcD:egi:l:Lm:o:st:T:w:", longOptions, NULL)) != -1) {
         switch (ch) {
             case 'a':
                 if (strcmp(optarg, "huffman") == 0
@@ -45,6 +82,28 @@ int main(int argc, char **argv)
                         || strcmp(optarg, "lzss-huff") == 0
                         || strcmp(optarg, "lzss-huffman") == 0) {
                     algorithm = LZHF;
+                } else if (strcmp(optarg, "ahuff") == 0
+                        || strcmp(optarg, "adaptive-huffman") == 0) {
+                    algorithm = AHUFFMAN;
+                } else if (strcmp(optarg, "huff-o1") == 0
+                        || strcmp(optarg, "huffman-o1") == 0) {
+                    algorithm = HUFFMAN_O1;
+                } else if (strcmp(optarg, "ans") == 0
+                        || strcmp(optarg, "tans") == 0) {
+                    algorithm = ANS;
+                } else if (strcmp(optarg, "lzans") == 0
+                        || strcmp(optarg, "lzss-ans") == 0) {
+                    algorithm = LZANS;
+                } else if (strcmp(optarg, "lzhf2") == 0
+                        || strcmp(optarg, "deflate") == 0) {
+                    algorithm = LZHF2;
+                } else if (strcmp(optarg, "lzss-split") == 0) {
+                    algorithm = LZSS_SPLIT;
+                } else if (strcmp(optarg, "lzss-flag") == 0) {
+                    algorithm = LZSS_FLAG;
+                } else if (strcmp(optarg, "fast") == 0
+                        || strcmp(optarg, "lzfast") == 0) {
+                    algorithm = FAST;
                 } else
                     fprintf(stderr, "Unknown algorithm: %s\n", optarg);
                 break;
@@ -54,23 +113,139 @@ int main(int argc, char **argv)
             case 'c':
                 mode = COMPRESS;
                 break;
+            case 'D':
+                dictfile = optarg;
+                break;
             case 'e':
                 mode = EXTRACT;
                 break;
+            case 'g':
+                mode = TRAIN;
+                break;
             case 'i':
                 infile = optarg;
                 break;
+            case 'l':
+                lengthBits = atoi(optarg);
+                break;
+            case 'L':
+                longRange = 1;
+                break;
+            case 'm':
+                if (atol(optarg) < 1)
+                    err_quit("invalid memory budget");
+                budget = (size_t)atol(optarg) << 20;
+                streaming = 1;
+                break;
             case 'o':
                 outfile = optarg;
                 break;
+            case 's':
+                streaming = 1;
+                break;
+            case 't':
+                tablefile = optarg;
+                break;
+            case 'T':
+                threads = atoi(optarg) == 0 ? threadpool_cores() : atoi(optarg);
+                if (threads < 1 || threads > THREADPOOL_MAX_THREADS)
+                    err_quit("invalid amount of threads");
+                break;
+            case 'w':
+                distanceBits = atoi(optarg);
+                windowSet = 1;
+                break;
+            case OPTION_TRAIN:
+                mode = TRAIN_DICTIONARY;
+                sampledir = optarg;
+                break;
+            case OPTION_PATCH_FROM:
+                patchfile = optarg;
+                break;
+            case OPTION_INDEPENDENT:
+                independent = 1;
+                break;
             default:
                 usage();
         }
     }
-    fprintf(stderr, "reading from file %s\n", infile);
-    Buffer *data = readFile(infile);
-    if (data->len == 0) {
-        err_quit("file is empty, skipping");
+    if (mode == EXTRACT) {
+        // the container tells the algorithm; raw output without one is extracted with -a
+        fprintf(stderr, "reading from file %s\n", infile);
+        input = openInput(infile);
+        data = new_buffer();
+        readUpTo(input, data, CONTAINER_HEADER_SIZE);
+        if (container_readHeader(data->data, data->len, &header)) {
+            if (header.algorithm > FAST)
+                err_quit("unknown algorithm in container");
+            fprintf(stderr, "reading the algorithm from the container header\n");
+            algorithm = header.algorithm;
+            streaming = (header.flags & CONTAINER_STREAM) != 0;
+            framed = 1;
+            buffer_clear(data);
+        } else {
+            fprintf(stderr, "no container header, extracting with the algorithm given\n");
+        }
+    }
+    if (patchfile) {
+        if (dictfile)
+            err_quit("-D and --patch-from cannot be used together");
+        if (algorithm != LZSS)
+            err_quit("--patch-from is supported by lzss only");
+        // most of the reference is out of the window, reached by long-range matches only
+        if (!windowSet)
+            distanceBits = LZSS_MAX_DISTANCE_BITS;
+        lengthBits = LZSS_VARIABLE_LENGTH;
+        longRange = 1;
+    }
+    lzss_setParameters(distanceBits, lengthBits);
+    lzss_setLongRange(longRange);
+    // blocks run on a thread pool, leaving no threads for the stages of lzhf
+    lzhf_setPipelined(threads == 0);
+    if (mode == TRAIN_DICTIONARY) {
+        size_t count;
+        fprintf(stderr, "reading samples from directory %s\n", sampledir);
+        Buffer **samples = readDirectory(sampledir, &count);
+        Buffer *dictionary = lzdict_train(samples, count, (size_t)1 << distanceBits);
+        if (dictionary->len == 0)
+            err_quit("the samples have nothing in common, no dictionary written");
+        fprintf(stderr, "trained a %lu byte dictionary on %lu samples\n", dictionary->len, count);
+        fprintf(stderr, "writing to file %s\n", outfile);
+        writeFile(dictionary, outfile);
+        for (size_t i = 0; i < count; i++)
+            delete_buffer(samples[i]);
+        free(samples);
+        delete_buffer(dictionary);
+        return 0;
+    }
+    Buffer *dictionary = NULL;
+    if (dictfile) {
+        if (algorithm != LZSS && algorithm != LZSS_BYTE)
+            err_quit("dictionaries are supported by lzss and lzss-byte only");
+        fprintf(stderr, "reading dictionary from file %s\n", dictfile);
+        dictionary = readFile(dictfile);
+        lzss_setDictionary(dictionary);
+    } else if (patchfile) {
+        fprintf(stderr, "reading reference from file %s\n", patchfile);
+        dictionary = readFile(patchfile);
+        lzss_setDictionary(dictionary);
+    }
+    if (tablefile) {
+        fprintf(stderr, "reading Huffman table from file %s\n", tablefile);
+        Buffer *table = readFile(tablefile);
+        huffman_setUserTable(huffman_deserializeTable(table));
+        delete_buffer(table);
+    }
+    if (framed && (header.flags & CONTAINER_DICTIONARY) && !dictionary)
+        err_quit("the input was compressed against a dictionary, give it with -D or --patch-from");
+    if (framed && (header.flags & CONTAINER_TABLE) && !tablefile)
+        err_quit("the input was compressed with a trained Huffman table, give it with -t");
+    if (mode == COMPRESS) {
+        header.algorithm = algorithm;
+        header.distanceBits = lzss_getParameters().distanceBits;
+        header.lengthBits = lzss_getParameters().lengthBits;
+        header.flags = (streaming ? CONTAINER_STREAM : 0) | (dictionary ? CONTAINER_DICTIONARY : 0)
+                | (tablefile ? CONTAINER_TABLE : 0);
     }
     Buffer *processed = NULL;
     switch (mode) {
@@ -93,6 +268,38 @@ int main(int argc, char **argv)
                     fprintf(stderr, "using nested lzss-byte and huffman algorithms\n");
                     algorithmFunction = lzhf_compress;
                     break;
+                case AHUFFMAN:
+                    fprintf(stderr, "using adaptive huffman algorithm\n");
+                    algorithmFunction = ahuffman_compress;
+                    break;
+                case HUFFMAN_O1:
+                    fprintf(stderr, "using order-1 context huffman algorithm\n");
+                    algorithmFunction = huffman_o1_compress;
+                    break;
+                case ANS:
+                    fprintf(stderr, "using tans algorithm\n");
+                    algorithmFunction = ans_compress;
+                    break;
+                case LZANS:
+                    fprintf(stderr, "using nested lzss-byte and tans algorithms\n");
+                    algorithmFunction = lzans_compress;
+                    break;
+                case LZHF2:
+                    fprintf(stderr, "using lzhf2 algorithm\n");
+                    algorithmFunction = lzhf2_compress;
+                    break;
+                case LZSS_SPLIT:
+                    fprintf(stderr, "using lzss-split algorithm\n");
+                    algorithmFunction = lzss_split_compress;
+                    break;
+                case LZSS_FLAG:
+                    fprintf(stderr, "using lzss-flag algorithm\n");
+                    algorithmFunction = lzss_flag_compress;
+                    break;
+                case FAST:
+                    fprintf(stderr, "using fast algorithm\n");
+                    algorithmFunction = lzfast_compress;
+                    break;
                 default:
                     break;
             }
@@ -116,6 +323,38 @@ int main(int argc, char **argv)
                     fprintf(stderr, "using nested lzss-byte and huffman algorithms\n");
                     algorithmFunction = lzhf_extract;
                     break;
+                case AHUFFMAN:
+                    fprintf(stderr, "using adaptive huffman algorithm\n");
+                    algorithmFunction = ahuffman_extract;
+                    break;
+                case HUFFMAN_O1:
+                    fprintf(stderr, "using order-1 context huffman algorithm\n");
+                    algorithmFunction = huffman_o1_extract;
+                    break;
+                case ANS:
+                    fprintf(stderr, "using tans algorithm\n");
+                    algorithmFunction = ans_extract;
+                    break;
+                case LZANS:
+                    fprintf(stderr, "using nested lzss-byte and tans algorithms\n");
+                    algorithmFunction = lzans_extract;
+                    break;
+                case LZHF2:
+                    fprintf(stderr, "using lzhf2 algorithm\n");
+                    algorithmFunction = lzhf2_extract;
+                    break;
+                case LZSS_SPLIT:
+                    fprintf(stderr, "using lzss-split algorithm\n");
+                    algorithmFunction = lzss_split_extract;
+                    break;
+                case LZSS_FLAG:
+                    fprintf(stderr, "using lzss-flag algorithm\n");
+                    algorithmFunction = lzss_flag_extract;
+                    break;
+                case FAST:
+                    fprintf(stderr, "using fast algorithm\n");
+                    algorithmFunction = lzfast_extract;
+                    break;
                 default:
                     break;
             }
@@ -123,16 +362,94 @@ int main(int argc, char **argv)
         case BENCHMARK:
             fprintf(stderr, "will benchmark\n");
             break;
+        case TRAIN:
+            fprintf(stderr, "will train a Huffman table\n");
+            break;
         default:
             err_quit("no mode set, exiting");
             break;
     }
 
-    if (mode != BENCHMARK) {
+    if (streaming && algorithmFunction) {
+        StreamEncoder *encoder = NULL;
+        StreamDecoder *decoder = NULL;
+        Buffer *output = new_buffer();
+        if (mode == COMPRESS) {
+            size_t history = (size_t)1 << lzss_getParameters().distanceBits;
+            size_t blocks = threads ? threads : 1, blockSize = BLOCK_SIZE;
+            if (budget) {
+                blockSize = stream_budgetBlockSize(budget, history, &blocks);
+                fprintf(stderr, "compressing %lu blocks of %lu KiB at a time\n", blocks, blockSize >> 10);
+            }
+            encoder = new_streamencoder(algorithmFunction, independent ? NULL : primedFunction(algorithm, mode),
+                    history, blockSize);
+            // adaptive Huffman codes each read as it arrives, with one tree for the whole stream
+            if (algorithm == AHUFFMAN) {
+                streamencoder_setPartial(encoder, ahuffman_startEncoder, ahuffman_updateEncoder,
+                        ahuffman_finishEncoder);
+            } else if (threads) {
+                pool = new_threadpool(threads);
+                streamencoder_setPool(encoder, pool, blocks);
+            }
+            container_writeHeader(output, &header);
+            input = openInput(infile);
+        } else {
+            decoder = new_streamdecoder(algorithmFunction, primedFunction(algorithm, mode));
+            // lzss-byte and adaptive Huffman decode as their input arrives, the others whole blocks
+            if (algorithm == LZSS_BYTE)
+                streamdecoder_setPartial(decoder, lzss_byte_startDecoder, lzss_byte_updateDecoder, lzss_byte_finishDecoder);
+            else if (algorithm == AHUFFMAN)
+                streamdecoder_setContinuous(decoder, ahuffman_startDecoder, ahuffman_updateDecoder, ahuffman_finishDecoder);
+            // the start of raw input, read while looking for a container header
+            streamdecoder_update(decoder, data->data, data->len, output);
+            delete_buffer(data);
+        }
+        fprintf(stderr, "streaming from file %s to file %s\n", infile, outfile);
+        processStream(input, openOutput(outfile), encoder, decoder, output);
+        if (dictionary)
+            delete_buffer(dictionary);
+        if (pool)
+            delete_threadpool(pool);
+        return 0;
+    }
+
+    if (data) {
+        readInto(input, data);
+        if (input > 2)
+            close(input);
+    } else {
+        fprintf(stderr, "reading from file %s\n", infile);
+        data = readFile(infile);
+    }
+    if (data->len == 0) {
+        err_quit("file is empty, skipping");
+    }
+    // compressed output is always in the block format, a single block without -T
+    if (algorithmFunction && (threads || mode == COMPRESS || framed)) {
+        blockCodec = algorithmFunction;
+        primedCodec = primedFunction(algorithm, mode);
+        algorithmFunction = mode == COMPRESS ? blocked_compress : blocked_extract;
+    }
+
+    if (mode == TRAIN) {
+        HuffCode *table = huffman_trainTable(data);
+        processed = huffman_serializeTable(table);
+        delete_huffcode(table);
+        fprintf(stderr, "writing to file %s\n", outfile);
+        writeFile(processed, outfile);
+        delete_buffer(processed);
+    } else if (mode != BENCHMARK) {
         if (!algorithmFunction)
             err_quit("no algorithm set, exiting");
 
         processed = processData(data, algorithmFunction, mode);
+        if (mode == COMPRESS) {
+            Buffer *container = new_buffer();
+            container_writeHeader(container, &header);
+            buffer_concatl(container, processed, processed->len);
+            delete_buffer(processed);
+            processed = container;
+        }
         fprintf(stderr, "writing to file %s\n", outfile);
         writeFile(processed, outfile);
         delete_buffer(processed);
@@ -140,6 +457,10 @@ int main(int argc, char **argv)
         benchmark(data, algorithm);
     }
     delete_buffer(data);
+    if (dictionary)
+        delete_buffer(dictionary);
+    if (pool)
+        delete_threadpool(pool);
 }
 
 void benchmark(Buffer *data, enum algorithm_enum algorithm)
@@ -171,12 +492,61 @@ void benchmark(Buffer *data, enum algorithm_enum algorithm)
             compressFunction = lzhf_compress;
             extractFunction = lzhf_extract;
             break;
+        case AHUFFMAN:
+            fprintf(stderr, "testing adaptive huffman algorithm\n");
+            compressFunction = ahuffman_compress;
+            extractFunction = ahuffman_extract;
+            break;
+        case HUFFMAN_O1:
+            fprintf(stderr, "testing order-1 context huffman algorithm\n");
+            compressFunction = huffman_o1_compress;
+            extractFunction = huffman_o1_extract;
+            break;
+        case ANS:
+            fprintf(stderr, "testing tans algorithm\n");
+            compressFunction = ans_compress;
+            extractFunction = ans_extract;
+            break;
+        case LZANS:
+            fprintf(stderr, "testing nested lzss-byte and tans algorithms\n");
+            compressFunction = lzans_compress;
+            extractFunction = lzans_extract;
+            break;
+        case LZHF2:
+            fprintf(stderr, "testing lzhf2 algorithm\n");
+            compressFunction = lzhf2_compress;
+            extractFunction = lzhf2_extract;
+            break;
+        case LZSS_SPLIT:
+            fprintf(stderr, "testing lzss-split algorithm\n");
+            compressFunction = lzss_split_compress;
+            extractFunction = lzss_split_extract;
+            break;
+        case LZSS_FLAG:
+            fprintf(stderr, "testing lzss-flag algorithm\n");
+            compressFunction = lzss_flag_compress;
+            extractFunction = lzss_flag_extract;
+            break;
+        case FAST:
+            fprintf(stderr, "testing fast algorithm\n");
+            compressFunction = lzfast_compress;
+            extractFunction = lzfast_extract;
+            break;
         default:
             err_quit("no valid algorithm set for benchmark");
             break;
     }
-    compressed = processData(data, compressFunction, COMPRESS);
-    decompressed = processData(compressed, extractFunction, EXTRACT);
+    if (threads) {
+        blockCodec = compressFunction;
+        primedCodec = primedFunction(algorithm, COMPRESS);
+        compressed = processData(data, blocked_compress, COMPRESS);
+        blockCodec = extractFunction;
+        primedCodec = primedFunction(algorithm, EXTRACT);
+        decompressed = processData(compressed, blocked_extract, EXTRACT);
+    } else {
+        compressed = processData(data, compressFunction, COMPRESS);
+        decompressed = processData(compressed, extractFunction, EXTRACT);
+    }
 
     if (!buffer_equals(data, decompressed))
         err_quit("mismatch between original and decompressed data");
@@ -194,9 +564,14 @@ Buffer *processData(Buffer *data, Buffer *(*algorithmFunction)(Buffer*), enum mo
 
     gettimeofday(&after, NULL);
     timersub(&after, &before, &difference);
-    fprintf(stderr, "%s took %ld.%07ld seconds\n",
+    fprintf(stderr, "%s took %ld.%06ld seconds\n",
             mode == COMPRESS ? "compression" : "extraction",
             (long int)difference.tv_sec, (long int) difference.tv_usec);
+    double seconds = difference.tv_sec + difference.tv_usec / 1e6;
+    if (seconds > 0)
+        fprintf(stderr, "%s speed is %.1lf MB/s\n",
+                mode == COMPRESS ? "compression" : "extraction",
+                (mode == COMPRESS ? data->len : processed->len) / seconds / 1e6);
     if (mode == COMPRESS)
         fprintf(stderr, "compression ratio is %.1lf%%\n",
                 ((double) data->len) / ((double) processed->len) * 100.0);
@@ -207,31 +582,104 @@ Buffer *processData(Buffer *data, Buffer *(*algorithmFunction)(Buffer*), enum mo
     return processed;
 }
 
-Buffer *lzhf_compress(Buffer *data)
+void processStream(int in, int out, StreamEncoder *encoder, StreamDecoder *decoder, Buffer *output)
+{
+    struct timeval before, after, difference;
+    gettimeofday(&before, NULL);
+
+    // only the current block and its output are held in memory, output starts
+    // with what goes before the stream, such as the container header
+    unsigned char buf[READBUF];
+    size_t inputLength = 0, outputLength = 0;
+    ssize_t len;
+    do {
+        len = read(in, buf, READBUF);
+        if (len < 0)
+            err_quit("reading from file failed");
+        inputLength += len;
+        if (encoder && len > 0)
+            streamencoder_update(encoder, buf, len, output);
+        else if (encoder)
+            streamencoder_finish(encoder, output);
+        else if (len > 0)
+            streamdecoder_update(decoder, buf, len, output);
+        else
+            streamdecoder_finish(decoder);
+        writeBuffer(output, out);
+        outputLength += output->len;
+        buffer_clear(output);
+    } while (len > 0);
+    if (in > 2)
+        close(in);
+    if (out > 2)
+        close(out);
+    delete_buffer(output);
+    if (encoder)
+        delete_streamencoder(encoder);
+    if (decoder)
+        delete_streamdecoder(decoder);
+
+    gettimeofday(&after, NULL);
+    timersub(&after, &before, &difference);
+    fprintf(stderr, "%s of %lu bytes to %lu bytes took %ld.%06ld seconds\n",
+            encoder ? "compression" : "extraction", inputLength, outputLength,
+            (long int)difference.tv_sec, (long int) difference.tv_usec);
+}
+
+PrimedCodec primedFunction(enum algorithm_enum algorithm, enum mode_enum mode)
+{
+    // algorithms that can refer to the end of the previous block
+    switch (algorithm) {
+        case LZSS:
+            return mode == COMPRESS ? lzss_compressWithHistory : lzss_extractWithHistory;
+        case LZSS_BYTE:
+            return mode == COMPRESS ? lzss_byte_compressWithHistory : lzss_byte_extractWithHistory;
+        case LZHF:
+            return mode == COMPRESS ? lzhf_compressWithHistory : lzhf_extractWithHistory;
+        default:
+            return NULL;
+    }
+}
+
+Buffer *blocked_compress(Buffer *data)
 {
-    Buffer *lzss_compressed = lzss_byte_compress(data);
-    Buffer *output = huffman_compress(lzss_compressed);
-    delete_buffer(lzss_compressed);
-    return output;
+    if (!threads)
+        return block_compressWhole(data, blockCodec);
+    if (!pool)
+        pool = new_threadpool(threads);
+    if (primedCodec && !independent)
+        return block_compressPrimed(data, primedCodec, (size_t)1 << lzss_getParameters().distanceBits, pool);
+    return block_compress(data, blockCodec, pool);
 }
 
-Buffer *lzhf_extract(Buffer *data)
+Buffer *blocked_extract(Buffer *data)
 {
-    Buffer *huffman_extracted = huffman_extract(data);
-    Buffer *output = lzss_byte_extract(huffman_extracted);
-    delete_buffer(huffman_extracted);
-    return output;
+    if (!pool && threads)
+        pool = new_threadpool(threads);
+    return block_extract(data, blockCodec, primedCodec, pool);
 }
 
 void usage()
 {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "-a [algorithm]: compression algorithm; huff, lzss, lzss-byte or lzhf\n");
-    fprintf(stderr, "-e: extract (default algorithm huffman)\n");
+    fprintf(stderr, "-a [algorithm]: compression algorithm; huff, ahuff, huff-o1, ans, lzss, lzss-byte, lzss-flag, lzss-split, lzhf, lzhf2, lzans or fast\n");
+    fprintf(stderr, "-e: extract; the algorithm is read from the input, -a is only needed for raw output of older versions\n");
     fprintf(stderr, "-c: compress (default algorithm huffman)\n");
     fprintf(stderr, "-i [infile]: set input file, - for stdin (default)\n");
     fprintf(stderr, "-o [outfile]: set output file, - for stdout (default)\n");
     fprintf(stderr, "-b: benchmark algorithm performance without saving output\n");
+    fprintf(stderr, "-g: generate a Huffman table trained on the input\n");
+    fprintf(stderr, "-t [tablefile]: use a trained Huffman table; needed for extracting as well\n");
+    fprintf(stderr, "-w [bits]: LZSS window size as a power of two, 8-20 (default 12)\n");
+    fprintf(stderr, "-l [bits]: LZSS match length bits, 2-8, or 0 for variable-length lzss tokens (default 4)\n");
+    fprintf(stderr, "-L: also find long repeats at any distance, lzss with -l 0 only\n");
+    fprintf(stderr, "-D [dictfile]: use a preset dictionary with lzss or lzss-byte; needed for extracting as well\n");
+    fprintf(stderr, "-T [threads]: process the input in 1 MiB blocks on this many threads, 0 for one per core; extracts independent blocks in parallel too\n");
+    fprintf(stderr, "-s: stream the input in 1 MiB blocks, reading and writing as it goes in constant memory; with -T, a block per thread at a time; ahuff codes each read at once\n");
+    fprintf(stderr, "-m [MiB]: memory budget for compressing with -s, which it implies; sets the block size and the blocks compressed at a time\n");
+    fprintf(stderr, "--train [dir]: build a dictionary the size of the window from the files in a directory\n");
+    fprintf(stderr, "--independent: with -T, compress blocks without the end of the previous block, so they are extracted in parallel too\n");
+    fprintf(stderr, "--patch-from [reffile]: lzss against a reference, such as an earlier version; needed for extracting as well\n");
     fprintf(stderr, "Example: ./compressor -ba lzhf -i samples/loremipsum-100k.txt\n");
     exit(EXIT_FAILURE);
 }
@@ -0,0 +1,547 @@
+#include "../include/stream.h"
+#include "../include/stream_private.h"
+#include "../include/block_private.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+
+/**
+ * Creates a stream encoder that compresses its input in blocks. If a primed
+ * codec is given, each block gets up to history bytes before it as history,
+ * like in block_compressPrimed; the first block gets none, so it may use the
+ * preset dictionary.
+ * @param compress the algorithm to compress each block with
+ * @param primed the same for blocks with history, NULL to compress the
+ * blocks independently
+ * @param history the amount of bytes before each block to give as history
+ * @param blockSize input bytes per block
+ * @return the newly created StreamEncoder
+ */
+StreamEncoder *new_streamencoder(BlockCodec compress, PrimedCodec primed, size_t history, size_t blockSize)
+{
+    if (!compress && !primed)
+        err_quit("null pointer creating stream encoder");
+    if (blockSize == 0)
+        err_quit("invalid stream block size");
+
+    StreamEncoder *enc = mcalloc(1, sizeof(StreamEncoder));
+    enc->codec = compress;
+    enc->primed = primed;
+    enc->history = primed ? history : 0;
+    enc->blockSize = blockSize;
+    enc->window = new_buffer();
+    enc->blocks = 1;
+    return enc;
+}
+
+/**
+ * Frees a stream encoder and any input it has not compressed.
+ * @param enc the StreamEncoder to delete
+ */
+void delete_streamencoder(StreamEncoder *enc)
+{
+    if (!enc)
+        err_quit("null pointer when deleting stream encoder");
+
+    delete_buffer(enc->window);
+    free(enc);
+}
+
+/**
+ * Compress the blocks of a stream encoder on a thread pool, a batch of blocks
+ * at a time. The input of a whole batch is kept, so memory use grows with
+ * the batch. The output does not change.
+ * @param enc the StreamEncoder, before it is given any input
+ * @param pool the ThreadPool to run on
+ * @param blocks blocks per batch, usually the amount of threads
+ */
+void streamencoder_setPool(StreamEncoder *enc, ThreadPool *pool, size_t blocks)
+{
+    if (!enc || !pool)
+        err_quit("null pointer in streamencoder_setPool");
+    if (blocks == 0)
+        err_quit("invalid amount of blocks per batch");
+    if (enc->started)
+        err_quit("stream encoder already started");
+
+    enc->pool = pool;
+    enc->blocks = blocks;
+}
+
+/**
+ * Code the input of a stream encoder as it arrives with an algorithm that
+ * keeps its state from one chunk to the next, instead of in blocks. The
+ * output of each chunk is written as soon as it is coded, so only a chunk is
+ * held in memory. The coder is started at once; a thread pool is not used.
+ * @param enc the StreamEncoder, before it is given any input
+ * @param start creates the coder of the stream, given no history
+ * @param update codes the next chunk of input
+ * @param finish ends the stream and frees the coder
+ */
+void streamencoder_setPartial(StreamEncoder *enc, PartialStart start, PartialUpdate update, PartialFinish finish)
+{
+    if (!enc || !start || !update || !finish)
+        err_quit("null pointer in streamencoder_setPartial");
+    if (enc->started)
+        err_quit("stream encoder already started");
+
+    enc->updateCoder = update;
+    enc->finishCoder = finish;
+    enc->coder = start(NULL);
+    enc->history = 0;
+}
+
+/**
+ * Choose the block size for streaming in a memory budget. Each block in
+ * flight takes about STREAM_BLOCK_COST times its size, and STREAM_WINDOW_COST
+ * times the history on top. The amount of blocks in flight is lowered if
+ * even the smallest blocks do not fit in the budget.
+ * @param budget the memory budget in bytes
+ * @param history the amount of bytes before each block given as history
+ * @param blocks the blocks to compress at a time, lowered to what fits
+ * @return the largest power of two block size that fits, at least
+ * STREAM_MIN_BLOCK
+ */
+size_t stream_budgetBlockSize(size_t budget, size_t history, size_t *blocks)
+{
+    if (!blocks)
+        err_quit("null pointer in stream_budgetBlockSize");
+
+    size_t fixed = STREAM_WINDOW_COST * history;
+    while (*blocks > 1 && budget / *blocks < fixed + STREAM_BLOCK_COST * STREAM_MIN_BLOCK)
+        (*blocks)--;
+    size_t share = budget / (*blocks > 0 ? *blocks : 1);
+    size_t blockSize = STREAM_MIN_BLOCK;
+    while (blockSize < STREAM_MAX_BLOCK && fixed + STREAM_BLOCK_COST * 2 * blockSize <= share)
+        blockSize *= 2;
+    return blockSize;
+}
+
+/**
+ * Give the next chunk of input to a stream encoder. Every block the chunk
+ * completes is compressed and appended to dst, the rest is kept for the next
+ * call. With a thread pool, the blocks are compressed once a batch is
+ * complete. A coder set with streamencoder_setPartial codes the whole chunk.
+ * @param enc the StreamEncoder
+ * @param data the input
+ * @param len the amount of input bytes
+ * @param dst the Buffer to append the compressed blocks to
+ */
+void streamencoder_update(StreamEncoder *enc, unsigned char *data, size_t len, Buffer *dst)
+{
+    if (!enc || !dst || (!data && len > 0))
+        err_quit("null pointer in streamencoder_update");
+
+    if (!enc->started) {
+        buffer_appendVarint(dst, enc->coder ? 0 : enc->blockSize);
+        buffer_appendVarint(dst, enc->history);
+        enc->started = 1;
+    }
+    if (enc->coder) {
+        // the window holds no input, so it takes the output of the chunk
+        enc->window->len = 0;
+        if (len > 0)
+            enc->updateCoder(enc->coder, data, len, enc->window);
+        writeStreamChunk(enc->window, dst);
+        return;
+    }
+    size_t batch = enc->blocks * enc->blockSize;
+    while (len > 0) {
+        size_t room = batch - (enc->window->len - enc->start);
+        size_t count = len < room ? len : room;
+        buffer_append(enc->window, data, count);
+        data += count;
+        len -= count;
+        if (enc->window->len - enc->start == batch)
+            writeStreamBlocks(enc, dst);
+    }
+}
+
+/**
+ * Compress the last blocks of a stream encoder and end the stream.
+ * @param enc the StreamEncoder
+ * @param dst the Buffer to append the rest of the stream to
+ */
+void streamencoder_finish(StreamEncoder *enc, Buffer *dst)
+{
+    if (!enc || !dst)
+        err_quit("null pointer in streamencoder_finish");
+
+    streamencoder_update(enc, NULL, 0, dst);
+    if (enc->coder) {
+        enc->window->len = 0;
+        enc->finishCoder(enc->coder, enc->window);
+        enc->coder = NULL;
+        writeStreamChunk(enc->window, dst);
+    } else if (enc->window->len > enc->start) {
+        writeStreamBlocks(enc, dst);
+    }
+    buffer_appendVarint(dst, 0);
+}
+
+/**
+ * Compress the blocks collected by a stream encoder and append them to the
+ * output in order. The blocks are compressed like in block_compressPrimed,
+ * each given the bytes before it in the window as history. Only the history
+ * for the next block is kept.
+ * @param enc the StreamEncoder, with at least one byte of input
+ * @param dst the output Buffer
+ */
+void writeStreamBlocks(StreamEncoder *enc, Buffer *dst)
+{
+    size_t len = enc->window->len - enc->start;
+    size_t count = (len + enc->blockSize - 1) / enc->blockSize;
+    BlockJob job = {enc->codec, enc->primed, enc->history, enc->window, enc->blockSize, NULL, enc->start};
+    job.results = mcalloc(count, sizeof(Buffer *));
+    if (enc->pool) {
+        threadpool_run(enc->pool, count, compressBlock, &job);
+    } else {
+        for (size_t i = 0; i < count; i++)
+            compressBlock(&job, i);
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t blockLen = len - i * enc->blockSize < enc->blockSize ? len - i * enc->blockSize : enc->blockSize;
+        buffer_appendVarint(dst, blockLen);
+        buffer_appendVarint(dst, job.results[i]->len);
+        buffer_append(dst, job.results[i]->data, job.results[i]->len);
+        delete_buffer(job.results[i]);
+    }
+    free(job.results);
+
+    keepWindow(enc->window, enc->history);
+    enc->start = enc->window->len;
+}
+
+/**
+ * Append the output of a coder for one chunk of input to a stream, as its
+ * size and the bytes. Nothing is written for a chunk without output, as a
+ * zero size marks the end of the stream.
+ * @param chunk the output of the coder
+ * @param dst the output Buffer
+ */
+void writeStreamChunk(Buffer *chunk, Buffer *dst)
+{
+    if (chunk->len == 0)
+        return;
+    buffer_appendVarint(dst, chunk->len);
+    buffer_append(dst, chunk->data, chunk->len);
+}
+
+/**
+ * Creates a stream decoder for a stream written by a StreamEncoder.
+ * @param extract the algorithm the blocks were compressed with
+ * @param primed the same for blocks with history, NULL if the algorithm
+ * does not support it
+ * @return the newly created StreamDecoder
+ */
+StreamDecoder *new_streamdecoder(BlockCodec extract, PrimedCodec primed)
+{
+    if (!extract)
+        err_quit("null pointer creating stream decoder");
+
+    StreamDecoder *dec = mcalloc(1, sizeof(StreamDecoder));
+    dec->codec = extract;
+    dec->primed = primed;
+    dec->input = new_buffer();
+    dec->window = new_buffer();
+    dec->state = STREAM_HEADER;
+    return dec;
+}
+
+/**
+ * Frees a stream decoder. The decoder of a block or a stream cut short by the
+ * end of the input is only freed by its finish function, which fails on it.
+ * @param dec the StreamDecoder to delete
+ */
+void delete_streamdecoder(StreamDecoder *dec)
+{
+    if (!dec)
+        err_quit("null pointer when deleting stream decoder");
+
+    delete_buffer(dec->input);
+    delete_buffer(dec->window);
+    free(dec);
+}
+
+/**
+ * Decode the blocks of a stream decoder as their compressed bytes arrive,
+ * instead of once each block has arrived in full. Then only the history and
+ * what is left of a chunk are kept, and the output of a block is handed out
+ * as it is decoded.
+ * @param dec the StreamDecoder, before it is given any input
+ * @param start creates the decoder of a block, given the history before it
+ * @param update decodes the next chunk of a block
+ * @param finish checks the end of a block and frees its decoder
+ */
+void streamdecoder_setPartial(StreamDecoder *dec, PartialStart start, PartialUpdate update, PartialFinish finish)
+{
+    if (!dec || !start || !update || !finish)
+        err_quit("null pointer in streamdecoder_setPartial");
+    if (dec->state != STREAM_HEADER)
+        err_quit("stream decoder already started");
+
+    dec->start = start;
+    dec->update = update;
+    dec->finish = finish;
+}
+
+/**
+ * Decode a stream coded as it arrived, see streamencoder_setPartial, with
+ * one decoder for all of its chunks. A stream in blocks is rejected.
+ * @param dec the StreamDecoder, before it is given any input
+ * @param start creates the decoder of the stream, given no history
+ * @param update decodes the next chunk of the stream
+ * @param finish checks the end of the stream and frees its decoder
+ */
+void streamdecoder_setContinuous(StreamDecoder *dec, PartialStart start, PartialUpdate update, PartialFinish finish)
+{
+    if (!dec || !start || !update || !finish)
+        err_quit("null pointer in streamdecoder_setContinuous");
+    if (dec->state != STREAM_HEADER)
+        err_quit("stream decoder already started");
+
+    dec->start = start;
+    dec->update = update;
+    dec->finish = finish;
+    dec->continuous = 1;
+}
+
+/**
+ * Give the next chunk of a compressed stream to a stream decoder. Every
+ * block the chunk completes is decoded and appended to dst, the rest is kept
+ * for the next call. With partial decoding the part of a block in the chunk
+ * is decoded as well.
+ * @param dec the StreamDecoder
+ * @param data the compressed input
+ * @param len the amount of input bytes
+ * @param dst the Buffer to append the decoded blocks to
+ */
+void streamdecoder_update(StreamDecoder *dec, unsigned char *data, size_t len, Buffer *dst)
+{
+    if (!dec || !dst || (!data && len > 0))
+        err_quit("null pointer in streamdecoder_update");
+
+    if (len > 0)
+        buffer_append(dec->input, data, len);
+    BufferReader *reader = buffer_createReader(dec->input);
+    size_t consumed = 0;
+    for (;;) {
+        if (dec->state == STREAM_HEADER) {
+            if (!readStreamHeader(dec, reader))
+                break;
+        } else if (dec->state == STREAM_BLOCKS) {
+            if (!readStreamBlock(dec, reader, dst))
+                break;
+        } else if (dec->state == STREAM_PARTIAL) {
+            if (!readPartialBlock(dec, reader, dst))
+                break;
+        } else if (dec->state == STREAM_CHUNKS) {
+            if (!readStreamChunk(dec, reader, dst))
+                break;
+        } else {
+            if (reader->pos < dec->input->len)
+                err_quit("data after the end of the stream");
+            break;
+        }
+        consumed = reader->pos;
+    }
+    delete_bufferreader(reader);
+    // keep the part of a block that has not arrived in full
+    memmove(dec->input->data, dec->input->data + consumed, dec->input->len - consumed);
+    dec->input->len -= consumed;
+}
+
+/**
+ * Check that a stream decoder was given the whole stream.
+ * @param dec the StreamDecoder
+ */
+void streamdecoder_finish(StreamDecoder *dec)
+{
+    if (!dec)
+        err_quit("null pointer in streamdecoder_finish");
+    if (dec->state != STREAM_END)
+        err_quit("unexpected end of stream");
+}
+
+/**
+ * Read the header of a stream.
+ * @param dec the StreamDecoder
+ * @param reader reader over the compressed input
+ * @return 1 if the header was read, 0 if it has not arrived in full
+ */
+int readStreamHeader(StreamDecoder *dec, BufferReader *reader)
+{
+    size_t blockSize, history;
+    if (bufferreader_readVarint(reader, &blockSize) < 1
+            || bufferreader_readVarint(reader, &history) < 1)
+        return 0;
+    if (blockSize == 0) {
+        // coded as it arrived, in chunks that continue one another
+        if (history > 0)
+            err_quit("failed to read stream header");
+        if (!dec->continuous)
+            err_quit("the stream was coded as it arrived, which the algorithm does not support");
+        dec->block = dec->start(NULL);
+        dec->remaining = 0;
+        dec->state = STREAM_CHUNKS;
+        return 1;
+    }
+    if (dec->continuous)
+        err_quit("the stream was coded in blocks, which the algorithm does not support");
+    if (history > 0 && !dec->primed)
+        err_quit("blocks refer to each other, which the algorithm does not support");
+    dec->blockSize = blockSize;
+    dec->history = history;
+    dec->state = STREAM_BLOCKS;
+    return 1;
+}
+
+/**
+ * Read and decode the next block of a stream, or its end marker.
+ * @param dec the StreamDecoder
+ * @param reader reader over the compressed input
+ * @param dst the Buffer to append the decoded block to
+ * @return 1 if a block or the end was read, 0 if it has not arrived in full
+ */
+int readStreamBlock(StreamDecoder *dec, BufferReader *reader, Buffer *dst)
+{
+    size_t length, size;
+    if (bufferreader_readVarint(reader, &length) < 1)
+        return 0;
+    if (length == 0) {
+        dec->state = STREAM_END;
+        return 1;
+    }
+    if (length > dec->blockSize)
+        err_quit("failed to read block header");
+    if (bufferreader_readVarint(reader, &size) < 1)
+        return 0;
+
+    // the window may hold more than the history, see extendWindow
+    Buffer *window = dec->window;
+    size_t reach = window->len < dec->history ? window->len : dec->history;
+    Buffer previous = {reach, reach, window->data + window->len - reach};
+    if (dec->start) {
+        dec->previous = previous;
+        dec->block = dec->start(dec->history > 0 && reach > 0 ? &dec->previous : NULL);
+        dec->remaining = size;
+        dec->expected = length;
+        dec->produced = 0;
+        dec->state = STREAM_PARTIAL;
+        return 1;
+    }
+    if (size > reader->data->len - reader->pos)
+        return 0;
+
+    Buffer block = {size, size, reader->data->data + reader->pos};
+    reader->pos += size;
+    Buffer *decoded;
+    if (dec->history > 0)
+        decoded = dec->primed(&block, reach > 0 ? &previous : NULL);
+    else
+        decoded = dec->codec(&block);
+    if (decoded->len != length)
+        err_quit("block decoded to the wrong length");
+    buffer_append(dst, decoded->data, length);
+    extendWindow(dec, decoded->data, length);
+    delete_buffer(decoded);
+    return 1;
+}
+
+/**
+ * Decode the part of the current block that has arrived.
+ * @param dec the StreamDecoder
+ * @param reader reader over the compressed input
+ * @param dst the Buffer to append the decoded output to
+ * @return 1 if the block was continued or finished, 0 if nothing arrived
+ */
+int readPartialBlock(StreamDecoder *dec, BufferReader *reader, Buffer *dst)
+{
+    size_t available = reader->data->len - reader->pos;
+    size_t count = available < dec->remaining ? available : dec->remaining;
+    if (count == 0 && dec->remaining > 0)
+        return 0;
+
+    size_t before = dst->len;
+    dec->update(dec->block, reader->data->data + reader->pos, count, dst);
+    reader->pos += count;
+    dec->remaining -= count;
+    if (dec->remaining == 0) {
+        dec->finish(dec->block, dst);
+        dec->block = NULL;
+        dec->state = STREAM_BLOCKS;
+    }
+    dec->produced += dst->len - before;
+    if (dec->produced > dec->expected || (!dec->block && dec->produced != dec->expected))
+        err_quit("block decoded to the wrong length");
+    extendWindow(dec, dst->data + before, dst->len - before);
+    return 1;
+}
+
+/**
+ * Read the size of the next chunk of a stream coded as it arrived, or decode
+ * the part of the current chunk that has arrived. The end marker finishes
+ * the decoder of the stream.
+ * @param dec the StreamDecoder
+ * @param reader reader over the compressed input
+ * @param dst the Buffer to append the decoded output to
+ * @return 1 if a size was read or the chunk continued, 0 if nothing arrived
+ */
+int readStreamChunk(StreamDecoder *dec, BufferReader *reader, Buffer *dst)
+{
+    if (dec->remaining == 0) {
+        size_t size;
+        if (bufferreader_readVarint(reader, &size) < 1)
+            return 0;
+        if (size == 0) {
+            dec->finish(dec->block, dst);
+            dec->block = NULL;
+            dec->state = STREAM_END;
+        }
+        dec->remaining = size;
+        return 1;
+    }
+
+    size_t available = reader->data->len - reader->pos;
+    size_t count = available < dec->remaining ? available : dec->remaining;
+    if (count == 0)
+        return 0;
+    dec->update(dec->block, reader->data->data + reader->pos, count, dst);
+    reader->pos += count;
+    dec->remaining -= count;
+    return 1;
+}
+
+/**
+ * Add decoded output to the history of a stream decoder. The window is only
+ * cut back to the history once it is twice its size, so that a block given
+ * in many small chunks does not move the history for each of them.
+ * @param dec the StreamDecoder
+ * @param data the output
+ * @param len length of the output
+ */
+void extendWindow(StreamDecoder *dec, unsigned char *data, size_t len)
+{
+    if (dec->history == 0)
+        return;
+    if (len >= dec->history) {
+        data += len - dec->history;
+        len = dec->history;
+        dec->window->len = 0;
+    }
+    buffer_append(dec->window, data, len);
+    if (dec->window->len >= 2 * dec->history)
+        keepWindow(dec->window, dec->history);
+}
+
+/**
+ * Drop all but the last bytes of a window.
+ * @param window the Buffer
+ * @param len the amount of bytes to keep
+ */
+void keepWindow(Buffer *window, size_t len)
+{
+    if (window->len <= len)
+        return;
+    memmove(window->data, window->data + window->len - len, len);
+    window->len = len;
+}
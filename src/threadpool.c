@@ -0,0 +1,193 @@
+#define _DEFAULT_SOURCE
+#include "../include/threadpool.h"
+#include "../include/threadpool_private.h"
+#include "../include/ealloc.h"
+#include "../include/error.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Get the amount of processor cores online.
+ * @return amount of cores, at least 1
+ */
+int threadpool_cores()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1)
+        return 1;
+    return cores > THREADPOOL_MAX_THREADS ? THREADPOOL_MAX_THREADS : cores;
+}
+
+/**
+ * Creates a thread pool. The threads wait for tasks until the pool is
+ * deleted.
+ * @param threads amount of threads, including the calling thread
+ * @return the newly created ThreadPool
+ */
+ThreadPool *new_threadpool(int threads)
+{
+    if (threads < 1 || threads > THREADPOOL_MAX_THREADS)
+        err_quit("invalid amount of threads");
+
+    ThreadPool *pool = mcalloc(1, sizeof(ThreadPool));
+    pool->threads = threads;
+    pool->workers = mmalloc(threads * sizeof(pthread_t));
+    pool->queues = mcalloc(threads, sizeof(TaskQueue));
+    pool->arenas = mmalloc(threads * sizeof(Arena *));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->arenas[i] = new_arena();
+    }
+    for (int i = 1; i < threads; i++) {
+        Worker *worker = mmalloc(sizeof(Worker));
+        worker->pool = pool;
+        worker->id = i;
+        if (pthread_create(&pool->workers[i], NULL, runWorker, worker) != 0)
+            err_quit("failed to create thread");
+    }
+    return pool;
+}
+
+/**
+ * Stops the threads of a pool and frees it.
+ * @param pool the ThreadPool to delete
+ */
+void delete_threadpool(ThreadPool *pool)
+{
+    if (!pool)
+        err_quit("null pointer when deleting thread pool");
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->threads; i++)
+        pthread_join(pool->workers[i], NULL);
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        delete_arena(pool->arenas[i]);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool->queues);
+    free(pool->arenas);
+    free(pool);
+}
+
+/**
+ * Run tasks 0 to tasks - 1 on the threads of a pool and wait for all of them
+ * to finish. Each thread is given a range of consecutive tasks.
+ * @param pool the ThreadPool
+ * @param tasks amount of tasks
+ * @param task the function to call with arg and the index of each task
+ * @param arg argument passed to every task
+ */
+void threadpool_run(ThreadPool *pool, size_t tasks, ThreadTask task, void *arg)
+{
+    if (!pool || !task)
+        err_quit("null pointer running tasks");
+    if (tasks == 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->remaining = tasks;
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_mutex_lock(&pool->queues[i].lock);
+        pool->queues[i].first = tasks * i / pool->threads;
+        pool->queues[i].last = tasks * (i + 1) / pool->threads;
+        pthread_mutex_unlock(&pool->queues[i].lock);
+    }
+    pool->batch++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    Arena *previous = arena_current();
+    arena_setCurrent(pool->arenas[0]);
+    runTasks(pool, 0);
+    arena_setCurrent(previous);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->remaining > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Thread function: run the tasks of each batch until the pool is deleted.
+ * @param worker the Worker, freed by the thread
+ * @return NULL
+ */
+void *runWorker(void *worker)
+{
+    ThreadPool *pool = ((Worker *)worker)->pool;
+    int id = ((Worker *)worker)->id;
+    free(worker);
+    arena_setCurrent(pool->arenas[id]);
+
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->batch == seen && !pool->stop)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->batch;
+        pthread_mutex_unlock(&pool->lock);
+        runTasks(pool, id);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    arena_setCurrent(NULL);
+    return NULL;
+}
+
+/**
+ * Run tasks from the own queue of a thread, then steal from the others,
+ * until all queues are empty.
+ * @param pool the ThreadPool
+ * @param id the thread
+ */
+void runTasks(ThreadPool *pool, int id)
+{
+    size_t index;
+    for (;;) {
+        int found = takeTask(&pool->queues[id], &index, 0);
+        for (int i = 1; !found && i < pool->threads; i++)
+            found = takeTask(&pool->queues[(id + i) % pool->threads], &index, 1);
+        if (!found)
+            return;
+        // the queue lock orders this after the batch was set up
+        pool->task(pool->arg, index);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->remaining == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Take a task from a queue. The owner takes from the front, thieves take
+ * from the back, so they only meet at the last task.
+ * @param queue the TaskQueue
+ * @param index destination for the task
+ * @param steal nonzero to take from the back
+ * @return 1 if a task was taken, 0 if the queue is empty
+ */
+int takeTask(TaskQueue *queue, size_t *index, int steal)
+{
+    int found = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->first < queue->last) {
+        *index = steal ? --queue->last : queue->first++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
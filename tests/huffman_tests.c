@@ -5,8 +5,18 @@
 #include "../include/huffman.h"
 #include "../include/huffman_private.h"
 #include "../include/huffnode.h"
+#include "../include/huffcode.h"
+#include "../include/huffman_tables.h"
+#include "../include/ahuffman.h"
+#include "../include/ahuffman_private.h"
+#include "../include/huffman_o1.h"
+#include "../include/huffman_o1_private.h"
+#include "../include/ans.h"
+#include "../include/ans_private.h"
 #include "../include/bitarray.h"
 #include "../include/fileops.h"
+#include "../include/block.h"
+#include "../include/stream.h"
 
 START_TEST(test_init_hufftree)
 {
@@ -276,6 +286,134 @@ START_TEST(test_huffman_compress_decompress_4)
 }
 END_TEST
 
+START_TEST(test_huffcode_fromFrequencies)
+{
+    size_t freqs[MAX_LEAVES] = {0};
+    freqs['a'] = 30;
+    freqs['b'] = 20;
+    freqs['c'] = 5;
+    freqs['d'] = 5;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(code, freqs);
+
+    ck_assert_int_eq(code->lengths['a'], 1);
+    ck_assert_int_eq(code->lengths['b'], 2);
+    ck_assert_int_eq(code->lengths['c'], 3);
+    ck_assert_int_eq(code->lengths['d'], 3);
+    ck_assert_int_eq(code->lengths['e'], 0);
+    // canonical codes, stored bit-reversed: a = 0, b = 10, c = 110, d = 111
+    ck_assert_int_eq(code->codes['a'], 0);
+    ck_assert_int_eq(code->codes['b'], 1);
+    ck_assert_int_eq(code->codes['c'], 3);
+    ck_assert_int_eq(code->codes['d'], 7);
+    ck_assert_int_eq(huffcode_cost(code, freqs), 30 + 40 + 15 + 15);
+    freqs['e'] = 1;
+    ck_assert_uint_eq(huffcode_cost(code, freqs), SIZE_MAX);
+    delete_huffcode(code);
+}
+END_TEST
+
+START_TEST(test_huffcode_lengthLimit)
+{
+    // Fibonacci frequencies produce a maximally deep Huffman tree
+    size_t freqs[MAX_LEAVES] = {0};
+    freqs[0] = 1;
+    freqs[1] = 1;
+    for (int i = 2; i < 40; i++)
+        freqs[i] = freqs[i - 1] + freqs[i - 2];
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(code, freqs);
+
+    for (int i = 0; i < 40; i++) {
+        ck_assert_int_gt(code->lengths[i], 0);
+        ck_assert_int_le(code->lengths[i], HUFFCODE_MAX_LENGTH);
+    }
+    delete_huffcode(code);
+}
+END_TEST
+
+START_TEST(test_huffcode_writeReadLengths)
+{
+    size_t freqs[MAX_LEAVES] = {0};
+    for (int i = 0; i < MAX_LEAVES; i += 3)
+        freqs[i] = i * i + 1;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(code, freqs);
+
+    BitArray *ba = new_bitarray();
+    huffcode_writeLengths(code, ba);
+    ck_assert_int_eq(ba->len, huffcode_tableCost(code));
+    BitArrayReader *br = bitarray_createReader(ba);
+    HuffCode *result = new_huffcode(MAX_LEAVES);
+    huffcode_readLengths(result, br);
+
+    ck_assert_mem_eq(result->lengths, code->lengths, MAX_LEAVES);
+    ck_assert_mem_eq(result->codes, code->codes, MAX_LEAVES * sizeof(uint32_t));
+    delete_huffcode(code);
+    delete_huffcode(result);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(test_huffcode_encodeDecode)
+{
+    // skewed enough to produce codes longer than the lookup table
+    size_t freqs[MAX_LEAVES] = {0};
+    for (int i = 0; i < MAX_LEAVES; i++)
+        freqs[i] = i < 20 ? (size_t) 1 << (20 - i) : 1;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(code, freqs);
+    ck_assert_int_gt(code->lengths[MAX_LEAVES - 1], HUFFCODE_LOOKUP_BITS);
+
+    BitArray *ba = new_bitarray();
+    for (int i = 0; i < MAX_LEAVES; i++)
+        huffcode_encode(code, ba, (i * 7) % MAX_LEAVES);
+    BitArrayReader *br = bitarray_createReader(ba);
+    for (int i = 0; i < MAX_LEAVES; i++)
+        ck_assert_int_eq(huffcode_decode(code, br), (i * 7) % MAX_LEAVES);
+    ck_assert_int_eq(huffcode_decode(code, br), -1);
+    delete_huffcode(code);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(test_huffcode_single)
+{
+    // a single symbol code takes no space in the payload
+    size_t freqs[MAX_LEAVES] = {0};
+    freqs[0xff] = 1000;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromFrequencies(code, freqs);
+
+    BitArray *ba = new_bitarray();
+    huffcode_encode(code, ba, 0xff);
+    ck_assert_int_eq(ba->len, 0);
+    BitArrayReader *br = bitarray_createReader(ba);
+    ck_assert_int_eq(huffcode_decode(code, br), 0xff);
+    delete_huffcode(code);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+Suite *huffcode_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+    s = suite_create("HuffCode");
+    tc_core = tcase_create("Core");
+    tcase_add_test(tc_core, test_huffcode_fromFrequencies);
+    tcase_add_test(tc_core, test_huffcode_lengthLimit);
+    tcase_add_test(tc_core, test_huffcode_writeReadLengths);
+    tcase_add_test(tc_core, test_huffcode_encodeDecode);
+    tcase_add_test(tc_core, test_huffcode_single);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
 Suite *hufftree_suite(void)
 {
     Suite *s;
@@ -291,6 +429,142 @@ Suite *hufftree_suite(void)
     return s;
 }
 
+START_TEST(test_huffman_block_reuse)
+{
+    Buffer *src = new_buffer();
+    char *str = "aaaabbbcc";
+    for (int i = 0; i < 100; i++)
+        buffer_append(src, (unsigned char *)str, strlen(str));
+    BitArray *ba = new_bitarray();
+    HuffCode *previous = NULL;
+    int mode;
+
+    // the second, identical block reuses the table of the first one
+    ck_assert_int_gt(encodeHuffmanBlock(src->data, src->len, ba, &previous, &mode), 0);
+    ck_assert_int_eq(mode, HUFFMAN_TABLE_NEW);
+    ck_assert_int_eq(encodeHuffmanBlock(src->data, src->len, ba, &previous, &mode), 0);
+    ck_assert_int_eq(mode, HUFFMAN_TABLE_REUSE);
+    delete_huffcode(previous);
+
+    previous = NULL;
+    Buffer *result = new_buffer();
+    BitArrayReader *br = bitarray_createReader(ba);
+    decodeHuffmanBlock(br, result, src->len, &previous);
+    decodeHuffmanBlock(br, result, src->len, &previous);
+    ck_assert_int_eq(result->len, 2 * src->len);
+    ck_assert_mem_eq(result->data, src->data, src->len);
+    ck_assert_mem_eq(result->data + src->len, src->data, src->len);
+    delete_huffcode(previous);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_buffer(result);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(test_huffman_hostileLength)
+{
+    // a gigabyte block of the only symbol of a code, which takes no bits
+    unsigned char lengths[MAX_LEAVES] = {0};
+    lengths['a'] = 1;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromLengths(code, lengths);
+    BitArray *stream = new_bitarray();
+    bitarray_writeInteger(stream, 1000000000);
+    bitarray_writeInteger(stream, 1000000000);
+    bitarray_appendBits(stream, HUFFMAN_TABLE_NEW, HUFFMAN_TABLE_MODE_BITS);
+    huffcode_writeLengths(code, stream);
+    delete_huffcode(code);
+    huffman_extract(bitarray_deleteAndConvertToBuffer(stream));
+}
+END_TEST
+
+START_TEST(test_huffman_block_static)
+{
+    Buffer *src = new_buffer();
+    char *str = "A short message is cheaper to code with a built-in table.";
+    buffer_append(src, (unsigned char *)str, strlen(str));
+    BitArray *ba = new_bitarray();
+    HuffCode *previous = NULL;
+    int mode;
+
+    ck_assert_int_eq(encodeHuffmanBlock(src->data, src->len, ba, &previous, &mode), 0);
+    ck_assert_int_eq(mode, HUFFMAN_TABLE_STATIC);
+    ck_assert_ptr_null(previous);
+    // mode, table ID and less than a byte per character
+    ck_assert_int_lt(ba->len, HUFFMAN_TABLE_MODE_BITS + HUFFMAN_TABLE_ID_BITS + 8 * src->len);
+
+    Buffer *result = new_buffer();
+    BitArrayReader *br = bitarray_createReader(ba);
+    decodeHuffmanBlock(br, result, src->len, &previous);
+    ck_assert_int_eq(result->len, src->len);
+    ck_assert_mem_eq(result->data, src->data, src->len);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_buffer(result);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(test_huffman_user_table)
+{
+    Buffer *training = new_buffer();
+    char *str = "0123456789,";
+    for (int i = 0; i < 100; i++)
+        buffer_append(training, (unsigned char *)str, strlen(str));
+    HuffCode *table = huffman_trainTable(training);
+    for (int i = 0; i < MAX_LEAVES; i++)
+        ck_assert_int_gt(table->lengths[i], 0);
+
+    // serialized table reads back to the same code
+    Buffer *serialized = huffman_serializeTable(table);
+    HuffCode *loaded = huffman_deserializeTable(serialized);
+    ck_assert_mem_eq(loaded->lengths, table->lengths, MAX_LEAVES);
+    ck_assert_uint_eq(huffman_tableId(loaded), huffman_tableId(table));
+    delete_huffcode(table);
+    // a table trained on other data has another ID
+    HuffCode *other = huffman_trainTable(serialized);
+    ck_assert_uint_ne(huffman_tableId(other), huffman_tableId(loaded));
+    delete_huffcode(other);
+
+    Buffer *src = new_buffer();
+    buffer_append(src, (unsigned char *)"31,41,59,26,53,58,97,93,23,84,", 30);
+    Buffer *builtin = huffman_compress(src);
+    ck_assert_ptr_null(huffman_staticTable(HUFFMAN_TABLE_USER));
+    huffman_setUserTable(loaded);
+    ck_assert_ptr_eq(huffman_staticTable(HUFFMAN_TABLE_USER), loaded);
+    Buffer *compressed = huffman_compress(src);
+    Buffer *result = huffman_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, src), 1);
+    // the block header names the user table and carries its ID
+    Buffer *header = new_buffer();
+    buffer_append(header, compressed->data, compressed->len);
+    BitArray *ba = bitarray_fromBuffer(header);
+    BitArrayReader *br = bitarray_createReader(ba);
+    uint32_t bits;
+    ck_assert_uint_eq(bitarrayreader_readInteger(br), src->len);
+    ck_assert_uint_eq(bitarrayreader_readInteger(br), HUFFMAN_BLOCK_SIZE);
+    bitarrayreader_readBits(br, HUFFMAN_TABLE_MODE_BITS, &bits);
+    ck_assert_uint_eq(bits, HUFFMAN_TABLE_STATIC);
+    bitarrayreader_readBits(br, HUFFMAN_TABLE_ID_BITS, &bits);
+    ck_assert_uint_eq(bits, HUFFMAN_TABLE_USER);
+    bitarrayreader_readBits(br, HUFFMAN_TABLE_HASH_BITS, &bits);
+    ck_assert_uint_eq(bits, huffman_tableId(loaded));
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    // the trained table beats the built-in ones
+    ck_assert_int_lt(compressed->len, builtin->len);
+
+    huffman_setUserTable(NULL);
+    delete_buffer(builtin);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(src);
+    delete_buffer(serialized);
+    delete_buffer(training);
+}
+END_TEST
+
 START_TEST(testCompressDecompressFile1)
 {
     Buffer *file = readFile("samples/bliss-sample.bin");
@@ -339,6 +613,67 @@ START_TEST(testCompressDecompressFile4)
 }
 END_TEST
 
+START_TEST(testCompressDecompressMixed)
+{
+    // several blocks with differing contents
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *binary = readFile("samples/linux-sample.bin");
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    buffer_concatl(file, binary, binary->len);
+    buffer_concatl(file, text, text->len);
+    Buffer *compressed = huffman_compress(file);
+    Buffer *result = huffman_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(binary);
+    delete_buffer(text);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressBlocks)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *binary = readFile("samples/linux-sample.bin");
+    Buffer *file = new_buffer();
+    while (file->len < 3 * BLOCK_SIZE + 1000) {
+        buffer_concatl(file, text, text->len);
+        buffer_concatl(file, binary, binary->len);
+    }
+    ThreadPool *pool = new_threadpool(4);
+    Buffer *compressed = block_compress(file, huffman_compress, pool);
+    // the blocks are decoded in parallel, into their places in the output
+    Buffer *result = block_extract(compressed, huffman_extract, NULL, pool);
+    delete_threadpool(pool);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(result);
+
+    // the table places every block, so one can be decoded without the others
+    BlockTable *table = block_readTable(compressed);
+    ck_assert_uint_eq(table->count, 4);
+    ck_assert_uint_eq(table->decodedLength, file->len);
+    ck_assert_uint_eq(table->starts[2], 2 * BLOCK_SIZE);
+    ck_assert_uint_eq(table->starts[4] - table->starts[3], file->len - 3 * BLOCK_SIZE);
+    Buffer *block = block_extractBlock(compressed, table, 2, huffman_extract);
+    ck_assert_uint_eq(block->len, BLOCK_SIZE);
+    ck_assert_int_eq(memcmp(block->data, file->data + 2 * BLOCK_SIZE, BLOCK_SIZE), 0);
+    delete_buffer(block);
+    delete_blocktable(table);
+    delete_buffer(compressed);
+
+    // input that is not split is a single block, extracted without a pool
+    compressed = block_compressWhole(text, huffman_compress);
+    result = block_extract(compressed, huffman_extract, NULL, NULL);
+    ck_assert_int_eq(buffer_equals(result, text), 1);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(file);
+    delete_buffer(binary);
+    delete_buffer(text);
+}
+END_TEST
+
 Suite *huffman_suite(void)
 {
     Suite *s;
@@ -351,6 +686,10 @@ Suite *huffman_suite(void)
     tcase_add_test(tc_unit, test_cacheHuffcodes);
     tcase_add_test(tc_unit, test_encodeHuffmanPayload);
     tcase_add_test(tc_unit, test_decodeHuffmanPayload);
+    tcase_add_test(tc_unit, test_huffman_block_reuse);
+    tcase_add_test(tc_unit, test_huffman_block_static);
+    tcase_add_exit_test(tc_unit, test_huffman_hostileLength, EXIT_FAILURE);
+    tcase_add_test(tc_unit, test_huffman_user_table);
     tc_int = tcase_create("Integration");
     suite_add_tcase(s, tc_int);
     tcase_set_timeout(tc_int, 10);
@@ -362,6 +701,502 @@ Suite *huffman_suite(void)
     tcase_add_test(tc_int, testCompressDecompressFile2);
     tcase_add_test(tc_int, testCompressDecompressFile3);
     tcase_add_test(tc_int, testCompressDecompressFile4);
+    tcase_add_test(tc_int, testCompressDecompressMixed);
+    tcase_add_test(tc_int, testCompressDecompressBlocks);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
+
+START_TEST(test_ahuffman_siblingProperty)
+{
+    AHuffman *coder = new_ahuffman();
+    char *str = "abracadabra, abracadabra!";
+    for (size_t i = 0; i < strlen(str); i++) {
+        updateAHufftree(coder, str[i]);
+        // weights never decrease with node number and parents sum up their children
+        for (int n = coder->nyt; n < AHUFF_NODES - 1; n++)
+            ck_assert_int_le(coder->nodes[n].weight, coder->nodes[n + 1].weight);
+        for (int n = coder->nyt; n < AHUFF_NODES; n++) {
+            AHuffNode *node = &coder->nodes[n];
+            if (node->left >= 0)
+                ck_assert_int_eq(node->weight,
+                        coder->nodes[node->left].weight + coder->nodes[node->right].weight);
+        }
+    }
+    ck_assert_int_eq(coder->nodes[AHUFF_NODES - 1].weight, strlen(str));
+    ck_assert_int_eq(coder->nodes[coder->leaves['a']].weight, 10);
+    delete_ahuffman(coder);
+}
+END_TEST
+
+START_TEST(test_ahuffman_encodeDecode)
+{
+    AHuffman *encoder = new_ahuffman();
+    AHuffman *decoder = new_ahuffman();
+    BitArray *ba = new_bitarray();
+    char *str = "I AM SAM. I AM SAM.";
+    for (size_t i = 0; i < strlen(str); i++)
+        ahuffman_encode(encoder, ba, str[i]);
+    ahuffman_encode(encoder, ba, AHUFF_EOF);
+
+    BitArrayReader *br = bitarray_createReader(ba);
+    for (size_t i = 0; i < strlen(str); i++)
+        ck_assert_int_eq(ahuffman_decode(decoder, br), str[i]);
+    ck_assert_int_eq(ahuffman_decode(decoder, br), AHUFF_EOF);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_ahuffman(encoder);
+    delete_ahuffman(decoder);
+}
+END_TEST
+
+START_TEST(test_ahuffman_partialInput)
+{
+    AHuffman *encoder = new_ahuffman();
+    AHuffman *decoder = new_ahuffman();
+    BitArray *ba = new_bitarray();
+    ahuffman_encode(encoder, ba, 'x');
+    ahuffman_encode(encoder, ba, 'y');
+    size_t complete = ba->len;
+
+    // decoding stops without consuming input when a code is cut short
+    BitArray *partial = bitarray_copyl(ba, complete - 3);
+    BitArrayReader *br = bitarray_createReader(partial);
+    ck_assert_int_eq(ahuffman_decode(decoder, br), 'x');
+    size_t pos = br->pos;
+    ck_assert_int_eq(ahuffman_decode(decoder, br), -1);
+    ck_assert_int_eq(br->pos, pos);
+    // once the rest arrives, decoding continues from the same spot
+    br->data = ba;
+    ck_assert_int_eq(ahuffman_decode(decoder, br), 'y');
+    delete_bitarrayreader(br);
+    delete_bitarray(partial);
+    delete_bitarray(ba);
+    delete_ahuffman(encoder);
+    delete_ahuffman(decoder);
+}
+END_TEST
+
+START_TEST(test_ahuffman_stream)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *whole = ahuffman_compress(file);
+
+    // coded in chunks, the tree and the bits of a partial byte carry over
+    void *encoder = ahuffman_startEncoder(NULL);
+    Buffer *chunked = new_buffer();
+    for (size_t pos = 0, size = 1; pos < file->len; pos += size, size = size * 3 % 1000 + 1) {
+        size_t len = file->len - pos < size ? file->len - pos : size;
+        ahuffman_updateEncoder(encoder, file->data + pos, len, chunked);
+        // only bytes that are complete are handed out
+        ck_assert_int_lt(chunked->len, whole->len);
+        ck_assert_mem_eq(chunked->data, whole->data, chunked->len);
+    }
+    ahuffman_finishEncoder(encoder, chunked);
+    ck_assert_int_eq(buffer_equals(chunked, whole), 1);
+
+    // a stream is coded as it arrives and decoded from chunks of a few bytes
+    StreamEncoder *enc = new_streamencoder(ahuffman_compress, NULL, 0, 65536);
+    streamencoder_setPartial(enc, ahuffman_startEncoder, ahuffman_updateEncoder, ahuffman_finishEncoder);
+    Buffer *stream = new_buffer();
+    streamencoder_update(enc, file->data, 1000, stream);
+    // the output of the first chunk comes out at once
+    ck_assert_int_gt(stream->len, 500);
+    streamencoder_update(enc, file->data + 1000, file->len - 1000, stream);
+    streamencoder_finish(enc, stream);
+    StreamDecoder *dec = new_streamdecoder(ahuffman_extract, NULL);
+    streamdecoder_setContinuous(dec, ahuffman_startDecoder, ahuffman_updateDecoder, ahuffman_finishDecoder);
+    Buffer *result = new_buffer();
+    for (size_t pos = 0, size = 1; pos < stream->len; pos += size, size = size % 7 + 1) {
+        size_t len = stream->len - pos < size ? stream->len - pos : size;
+        streamdecoder_update(dec, stream->data + pos, len, result);
+    }
+    streamdecoder_finish(dec);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+
+    delete_streamdecoder(dec);
+    delete_streamencoder(enc);
+    delete_buffer(result);
+    delete_buffer(stream);
+    delete_buffer(chunked);
+    delete_buffer(whole);
+    delete_buffer(file);
+}
+END_TEST
+
+START_TEST(testAdaptiveCompressDecompressFile1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = ahuffman_compress(file);
+    Buffer *result = ahuffman_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testAdaptiveCompressDecompressFile2)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = ahuffman_compress(file);
+    Buffer *result = ahuffman_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testAdaptiveCompressDecompressFile3)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = ahuffman_compress(file);
+    Buffer *result = ahuffman_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *ahuffman_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit, *tc_int;
+    s = suite_create("AdaptiveHuffman");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, test_ahuffman_siblingProperty);
+    tcase_add_test(tc_unit, test_ahuffman_encodeDecode);
+    tcase_add_test(tc_unit, test_ahuffman_partialInput);
+    tcase_add_test(tc_unit, test_ahuffman_stream);
+    tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, testAdaptiveCompressDecompressFile1);
+    tcase_add_test(tc_int, testAdaptiveCompressDecompressFile2);
+    tcase_add_test(tc_int, testAdaptiveCompressDecompressFile3);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
+
+START_TEST(test_countContextFrequencies)
+{
+    Buffer *src = new_buffer();
+    buffer_append(src, (unsigned char *)"abab", 4);
+    size_t *freqs = countContextFrequencies(src);
+
+    ck_assert_int_eq(freqs[0 * MAX_LEAVES + 'a'], 1);
+    ck_assert_int_eq(freqs['a' * MAX_LEAVES + 'b'], 2);
+    ck_assert_int_eq(freqs['b' * MAX_LEAVES + 'a'], 1);
+    ck_assert_int_eq(freqs['b' * MAX_LEAVES + 'b'], 0);
+    free(freqs);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(test_clusterContexts)
+{
+    // digits are followed by digits and letters by letters, so the two
+    // groups of contexts should end up in different tables
+    Buffer *src = new_buffer();
+    unsigned seed = 1;
+    for (int i = 0; i < 4000; i++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned char c = (i / 100) % 2 ? '0' + (seed >> 16) % 10 : 'a' + (seed >> 16) % 10;
+        buffer_append(src, &c, 1);
+    }
+    size_t *freqs = countContextFrequencies(src);
+    unsigned char map[O1_CONTEXTS];
+    int tables = clusterContexts(freqs, 2, map);
+
+    ck_assert_int_eq(tables, 2);
+    for (int i = 1; i < 10; i++) {
+        ck_assert_int_eq(map['0' + i], map['0']);
+        ck_assert_int_eq(map['a' + i], map['a']);
+    }
+    ck_assert_int_ne(map['0'], map['a']);
+    ck_assert_int_eq(contextMapBits(1), 0);
+    ck_assert_int_eq(contextMapBits(2), 1);
+    ck_assert_int_eq(contextMapBits(5), 3);
+    free(freqs);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(test_huffman_o1_compress_decompress)
+{
+    Buffer *src = new_buffer();
+    char *str1 = "Hello, world!";
+    buffer_append(src, (unsigned char *)str1, strlen(str1) + 1);
+    Buffer *compressed = huffman_o1_compress(src);
+    Buffer *result = huffman_o1_extract(compressed);
+    ck_assert_str_eq((char *)result->data, str1);
+    delete_buffer(src);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(test_huffman_o1_hostileLength)
+{
+    // a one-table stream whose only code has a single symbol, claiming a
+    // billion bytes of output
+    unsigned char lengths[MAX_LEAVES] = {0};
+    lengths['a'] = 1;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromLengths(code, lengths);
+    BitArray *stream = new_bitarray();
+    bitarray_writeInteger(stream, 1000000000);
+    bitarray_appendBits(stream, 0, O1_TABLE_BITS);
+    huffcode_writeLengths(code, stream);
+    delete_huffcode(code);
+    huffman_o1_extract(bitarray_deleteAndConvertToBuffer(stream));
+}
+END_TEST
+
+START_TEST(test_huffman_o1_hostileLength2)
+{
+    // the same with a two-symbol code, which needs a bit for every byte
+    unsigned char lengths[MAX_LEAVES] = {0};
+    lengths['a'] = 1;
+    lengths['b'] = 1;
+    HuffCode *code = new_huffcode(MAX_LEAVES);
+    huffcode_fromLengths(code, lengths);
+    BitArray *stream = new_bitarray();
+    bitarray_writeInteger(stream, 1000000000);
+    bitarray_appendBits(stream, 0, O1_TABLE_BITS);
+    huffcode_writeLengths(code, stream);
+    bitarray_appendBits(stream, 0, 32);
+    delete_huffcode(code);
+    huffman_o1_extract(bitarray_deleteAndConvertToBuffer(stream));
+}
+END_TEST
+
+START_TEST(testContextCompressDecompressFile1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = huffman_o1_compress(file);
+    Buffer *result = huffman_o1_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testContextCompressDecompressFile2)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = huffman_o1_compress(file);
+    Buffer *result = huffman_o1_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // the context model should beat plain Huffman on text
+    Buffer *order0 = huffman_compress(file);
+    ck_assert_int_lt(compressed->len, order0->len);
+    delete_buffer(order0);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testContextCompressDecompressFile3)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = huffman_o1_compress(file);
+    Buffer *result = huffman_o1_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *huffman_o1_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit, *tc_int;
+    s = suite_create("ContextHuffman");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, test_countContextFrequencies);
+    tcase_add_test(tc_unit, test_clusterContexts);
+    tcase_add_exit_test(tc_unit, test_huffman_o1_hostileLength, EXIT_FAILURE);
+    tcase_add_exit_test(tc_unit, test_huffman_o1_hostileLength2, EXIT_FAILURE);
+    tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, test_huffman_o1_compress_decompress);
+    tcase_add_test(tc_int, testContextCompressDecompressFile1);
+    tcase_add_test(tc_int, testContextCompressDecompressFile2);
+    tcase_add_test(tc_int, testContextCompressDecompressFile3);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
+
+START_TEST(test_anstable_normalize)
+{
+    size_t freqs[ANS_SYMBOLS] = {0};
+    freqs['a'] = 1000;
+    freqs['b'] = 10;
+    freqs['c'] = 1; // rounds to zero, but still needs a state
+    ANSTable *table = new_anstable(ANS_MIN_TABLE_LOG);
+    anstable_normalize(table, freqs);
+
+    ck_assert_int_eq(table->counts['a'] + table->counts['b'] + table->counts['c'], 1 << ANS_MIN_TABLE_LOG);
+    ck_assert_int_eq(table->counts['c'], 1);
+    ck_assert_int_gt(table->counts['a'], table->counts['b']);
+    ck_assert_int_eq(table->counts['d'], 0);
+    delete_anstable(table);
+}
+END_TEST
+
+START_TEST(test_anstable_writeReadCounts)
+{
+    size_t freqs[ANS_SYMBOLS] = {0};
+    for (int i = 0; i < 40; i++)
+        freqs[i * 5] = i + 1;
+    ANSTable *table = new_anstable(10);
+    anstable_normalize(table, freqs);
+    anstable_build(table);
+    BitArray *ba = new_bitarray();
+    anstable_writeCounts(table, ba);
+
+    ANSTable *result = new_anstable(10);
+    BitArrayReader *br = bitarray_createReader(ba);
+    anstable_readCounts(result, br);
+    ck_assert_int_eq(br->pos, ba->len);
+    ck_assert_mem_eq(result->counts, table->counts, sizeof(table->counts));
+    ck_assert_mem_eq(result->decode, table->decode, (1 << 10) * sizeof(ANSEntry));
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_anstable(table);
+    delete_anstable(result);
+}
+END_TEST
+
+START_TEST(test_ans_block)
+{
+    // a skewed distribution, where Huffman needs at least a bit per symbol
+    Buffer *src = new_buffer();
+    for (int i = 0; i < 1000; i++) {
+        unsigned char c = i % 20 == 0 ? 'b' : 'a';
+        buffer_append(src, &c, 1);
+    }
+    BitArray *ba = new_bitarray();
+    size_t header = encodeANSBlock(src->data, src->len, ba);
+    ck_assert_int_lt(ba->len - header, src->len / 2);
+
+    Buffer *result = new_buffer();
+    BitArrayReader *br = bitarray_createReader(ba);
+    decodeANSBlock(br, result, src->len);
+    ck_assert_int_eq(buffer_equals(result, src), 1);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_buffer(result);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(test_ans_hostileLength)
+{
+    // a gigabyte block of a lone symbol, which takes no bits
+    unsigned char data[4] = "aaaa";
+    BitArray *stream = new_bitarray();
+    bitarray_writeInteger(stream, 1000000000);
+    bitarray_writeInteger(stream, 1000000000);
+    encodeANSBlock(data, sizeof(data), stream);
+    ans_extract(bitarray_deleteAndConvertToBuffer(stream));
+}
+END_TEST
+
+START_TEST(test_ans_compress_decompress)
+{
+    Buffer *src = new_buffer();
+    char *str1 = "Hello, world!";
+    buffer_append(src, (unsigned char *)str1, strlen(str1) + 1);
+    Buffer *compressed = ans_compress(src);
+    Buffer *result = ans_extract(compressed);
+    ck_assert_str_eq((char *)result->data, str1);
+    delete_buffer(src);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testANSCompressDecompressFile1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = ans_compress(file);
+    Buffer *result = ans_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testANSCompressDecompressFile2)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = ans_compress(file);
+    Buffer *result = ans_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testANSCompressDecompressFile3)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    Buffer *compressed = ans_compress(file);
+    Buffer *result = ans_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // mostly one byte value, where tANS beats the 1 bit per symbol of Huffman
+    Buffer *huffman = huffman_compress(file);
+    ck_assert_int_lt(compressed->len, huffman->len);
+    delete_buffer(huffman);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testANSCompressDecompressFile4)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = ans_compress(file);
+    Buffer *result = ans_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *ans_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit, *tc_int;
+    s = suite_create("ANS");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, test_anstable_normalize);
+    tcase_add_test(tc_unit, test_anstable_writeReadCounts);
+    tcase_add_test(tc_unit, test_ans_block);
+    tcase_add_exit_test(tc_unit, test_ans_hostileLength, EXIT_FAILURE);
+    tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, test_ans_compress_decompress);
+    tcase_add_test(tc_int, testANSCompressDecompressFile1);
+    tcase_add_test(tc_int, testANSCompressDecompressFile2);
+    tcase_add_test(tc_int, testANSCompressDecompressFile3);
+    tcase_add_test(tc_int, testANSCompressDecompressFile4);
     suite_add_tcase(s, tc_unit);
     suite_add_tcase(s, tc_int);
 
@@ -372,13 +1207,25 @@ int main(void)
 {
     int number_failed;
     Suite *hufftree_s;
+    Suite *huffcode_s;
     Suite *huffman_s;
+    Suite *ahuffman_s;
+    Suite *huffman_o1_s;
+    Suite *ans_s;
     SRunner *sr;
 
     hufftree_s = hufftree_suite();
+    huffcode_s = huffcode_suite();
     huffman_s = huffman_suite();
+    ahuffman_s = ahuffman_suite();
+    huffman_o1_s = huffman_o1_suite();
+    ans_s = ans_suite();
     sr = srunner_create(hufftree_s);
+    srunner_add_suite(sr, huffcode_s);
     srunner_add_suite(sr, huffman_s);
+    srunner_add_suite(sr, ahuffman_s);
+    srunner_add_suite(sr, huffman_o1_s);
+    srunner_add_suite(sr, ans_s);
 
     srunner_run_all(sr, CK_VERBOSE);
     number_failed = srunner_ntests_failed(sr);
@@ -1,12 +1,19 @@
 #include <check.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../include/lzss_common.h"
 #include "../include/lzss_byte.h"
 #include "../include/lzss_byte_private.h"
+#include "../include/lzss_flag.h"
+#include "../include/lzss_flag_private.h"
+#include "../include/lzfast.h"
+#include "../include/lzfast_private.h"
 #include "../include/fileops.h"
+#include "../include/lzdict.h"
 #include "../include/ringbuffer.h"
+#include "../include/stream.h"
 
 START_TEST(testDecodeLZSSPayload)
 {
@@ -21,7 +28,7 @@ START_TEST(testDecodeLZSSPayload)
     buffer_append(compressed, (unsigned char *)". ", 2);
     writeByteToken(compressed, 10, 9);
     BufferReader *reader = buffer_createReader(compressed);
-    Buffer *decompressed = decodeLZSSPayloadByteLevel(reader);
+    Buffer *decompressed = decodeLZSSPayloadByteLevel(reader, NULL, lzss_getParameters());
 
     ck_assert_mem_eq(buf->data, decompressed->data, 19);
 }
@@ -34,9 +41,9 @@ START_TEST(testEncodeDecodeLZSSPayload)
     size_t len = strlen(str) + 1;
     buffer_append(src, (unsigned char *)str, len);
     Buffer *compressed = new_buffer();
-    encodeLZSSPayloadByteLevel(src, compressed);
+    encodeLZSSPayloadByteLevel(src, NULL, compressed, lzss_getParameters());
     BufferReader *reader = buffer_createReader(compressed);
-    Buffer *result = decodeLZSSPayloadByteLevel(reader);
+    Buffer *result = decodeLZSSPayloadByteLevel(reader, NULL, lzss_getParameters());
     ck_assert_mem_eq(result->data, src->data, len);
 }
 END_TEST
@@ -48,9 +55,9 @@ START_TEST(testEncodeDecodeLZSSPayload2)
     size_t len = strlen(str) + 1;
     buffer_append(src, (unsigned char *)str, len);
     Buffer *compressed = new_buffer();
-    encodeLZSSPayloadByteLevel(src, compressed);
+    encodeLZSSPayloadByteLevel(src, NULL, compressed, lzss_getParameters());
     BufferReader *reader = buffer_createReader(compressed);
-    Buffer *result = decodeLZSSPayloadByteLevel(reader);
+    Buffer *result = decodeLZSSPayloadByteLevel(reader, NULL, lzss_getParameters());
     ck_assert_mem_eq(result->data, src->data, len);
 }
 END_TEST
@@ -62,13 +69,151 @@ START_TEST(testEncodeDecodeLZSSPayload3)
     size_t len = strlen(str) + 1;
     buffer_append(src, (unsigned char *)str, len);
     Buffer *compressed = new_buffer();
-    encodeLZSSPayloadByteLevel(src, compressed);
+    encodeLZSSPayloadByteLevel(src, NULL, compressed, lzss_getParameters());
     BufferReader *reader = buffer_createReader(compressed);
-    Buffer *result = decodeLZSSPayloadByteLevel(reader);
+    Buffer *result = decodeLZSSPayloadByteLevel(reader, NULL, lzss_getParameters());
     ck_assert_mem_eq(result->data, src->data, len);
 }
 END_TEST
 
+START_TEST(testEncodeDecodeByteLayouts)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    LZSSParams layouts[] = {{8, 2}, {16, 8}, {15, 5}};
+    for (int i = 0; i < 3; i++) {
+        Buffer *compressed = new_buffer();
+        encodeLZSSPayloadByteLevel(file, NULL, compressed, layouts[i]);
+        BufferReader *reader = buffer_createReader(compressed);
+        Buffer *result = decodeLZSSPayloadByteLevel(reader, NULL, layouts[i]);
+        ck_assert_int_eq(buffer_equals(result, file), 1);
+        delete_buffer(result);
+        delete_bufferreader(reader);
+        delete_buffer(compressed);
+    }
+
+    // the default layout is the one of writeByteToken
+    Buffer *a = new_buffer();
+    Buffer *b = new_buffer();
+    writeByteToken(a, 1000, 13);
+    writeByteTokenWidth(b, 1000, 13, lzss_getParameters());
+    ck_assert_int_eq(buffer_equals(a, b), 1);
+    delete_buffer(a);
+    delete_buffer(b);
+
+    // the layout travels in the stream header
+    lzss_setParameters(16, 8);
+    Buffer *compressed = lzss_byte_compress(file);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    Buffer *result = lzss_byte_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(file);
+}
+END_TEST
+
+void collectChunk(ByteChunk *chunk, void *chunks)
+{
+    Buffer *c = chunks;
+    // every chunk but the last is full
+    ck_assert_int_eq(c->len % 1000, 0);
+    // the frequencies counted while writing match the chunk
+    size_t freqs[256] = {0};
+    for (size_t i = 0; i < chunk->data->len; i++)
+        freqs[chunk->data->data[i]]++;
+    ck_assert_mem_eq(freqs, chunk->freqs, sizeof(freqs));
+    buffer_append(c, chunk->data->data, chunk->data->len);
+    delete_bytechunk(chunk);
+}
+
+START_TEST(testEncodeDecodeByteChunks)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    lzss_setParameters(16, 8);
+    Buffer *compressed = lzss_byte_compress(file);
+    Buffer *chunks = new_buffer();
+    encodeByteChunks(file, NULL, 1000, collectChunk, chunks);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    ck_assert_int_eq(buffer_equals(chunks, compressed), 1);
+
+    // chunks of a few bytes split the header, tokens and escaped literals
+    ByteDecoder *decoder = new_bytedecoder(NULL);
+    for (size_t pos = 0, size = 1; pos < compressed->len; pos += size, size = size % 7 + 1) {
+        size_t len = compressed->len - pos < size ? compressed->len - pos : size;
+        bytedecoder_update(decoder, compressed->data + pos, len);
+    }
+    Buffer *result = bytedecoder_finish(decoder);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(result);
+    delete_buffer(chunks);
+    delete_buffer(compressed);
+    delete_buffer(file);
+}
+END_TEST
+
+START_TEST(testStreamDecodeByteTokens)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *image = readFile("samples/bliss-sample.bin");
+    Buffer *file = new_buffer();
+    buffer_append(file, text->data, text->len);
+    buffer_append(file, image->data, image->len);
+    StreamEncoder *enc = new_streamencoder(lzss_byte_compress, lzss_byte_compressWithHistory, 4096, 65536);
+    Buffer *stream = new_buffer();
+    streamencoder_update(enc, file->data, file->len, stream);
+    streamencoder_finish(enc, stream);
+
+    // chunks of a few bytes split the block headers and the tokens
+    StreamDecoder *dec = new_streamdecoder(lzss_byte_extract, lzss_byte_extractWithHistory);
+    streamdecoder_setPartial(dec, lzss_byte_startDecoder, lzss_byte_updateDecoder, lzss_byte_finishDecoder);
+    Buffer *result = new_buffer();
+    for (size_t pos = 0, size = 1; pos < stream->len; pos += size, size = size % 7 + 1) {
+        size_t len = stream->len - pos < size ? stream->len - pos : size;
+        streamdecoder_update(dec, stream->data + pos, len, result);
+        // the output comes out before the first block has arrived in full
+        if (pos > 1000 && pos <= 1007)
+            ck_assert_int_gt(result->len, 0);
+        // only the window of a block is kept by its decoder
+        if (dec->block)
+            ck_assert_int_lt(((ByteDecoder *)dec->block)->output->len, 3 * 4096);
+    }
+    streamdecoder_finish(dec);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+
+    delete_streamdecoder(dec);
+    delete_streamencoder(enc);
+    delete_buffer(result);
+    delete_buffer(stream);
+    delete_buffer(file);
+    delete_buffer(image);
+    delete_buffer(text);
+}
+END_TEST
+
+START_TEST(testCompressDecompressByteDictionary)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *dictionary = new_buffer();
+    buffer_append(dictionary, text->data, 4096);
+    Buffer *message = new_buffer();
+    buffer_append(message, text->data + 1000, 500);
+    Buffer *plain = lzss_byte_compress(message);
+    lzss_setDictionary(dictionary);
+    Buffer *compressed = lzss_byte_compress(message);
+    Buffer *result = lzss_byte_extract(compressed);
+    lzss_setDictionary(NULL);
+    ck_assert_int_eq(buffer_equals(result, message), 1);
+    // the message is part of the dictionary, so it is all matches
+    ck_assert_int_lt(compressed->len * 3, plain->len);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(plain);
+    delete_buffer(message);
+    delete_buffer(dictionary);
+    delete_buffer(text);
+}
+END_TEST
+
 START_TEST(testCompressDecompressByte1)
 {
     Buffer *file = readFile("samples/bliss-sample.bin");
@@ -127,12 +272,16 @@ Suite *lzss_suite(void)
     tcase_add_test(tc_unit, testEncodeDecodeLZSSPayload);
     tcase_add_test(tc_unit, testEncodeDecodeLZSSPayload2);
     tcase_add_test(tc_unit, testEncodeDecodeLZSSPayload3);
+    tcase_add_test(tc_unit, testEncodeDecodeByteLayouts);
+    tcase_add_test(tc_unit, testEncodeDecodeByteChunks);
+    tcase_add_test(tc_unit, testStreamDecodeByteTokens);
     TCase *tc_int = tcase_create("Integration");
     tcase_set_timeout(tc_int, 10);
     tcase_add_test(tc_int, testCompressDecompressByte1);
     tcase_add_test(tc_int, testCompressDecompressByte2);
     tcase_add_test(tc_int, testCompressDecompressByte3);
     tcase_add_test(tc_int, testCompressDecompressByte4);
+    tcase_add_test(tc_int, testCompressDecompressByteDictionary);
     suite_add_tcase(s, tc_unit);
     suite_add_tcase(s, tc_int);
 
@@ -140,14 +289,239 @@ Suite *lzss_suite(void)
 }
 
 
+START_TEST(testFlagTable)
+{
+    FlagEntry table[256];
+    buildFlagTable(table);
+    ck_assert_int_eq(table[0x00].size, 8);
+    ck_assert_int_eq(table[0x00].literals, 8);
+    ck_assert_int_eq(table[0xff].size, 16);
+    ck_assert_int_eq(table[0xff].literals, 0);
+    ck_assert_int_eq(table[0x28].size, 10);
+    ck_assert_int_eq(table[0x28].literals, 3);
+}
+END_TEST
+
+START_TEST(testEncodeDecodeFlagPayload)
+{
+    // "abc", a reference to it, "d" and a run of 'd'
+    LZToken tokens[] = {{0, 'a'}, {0, 'b'}, {0, 'c'}, {3, 3}, {0, 'd'}, {1, 5}};
+    Buffer *compressed = new_buffer();
+    encodeLZSSPayloadFlagLevel(tokens, 6, compressed);
+    // flag byte, 4 literals and 2 two-byte references
+    ck_assert_int_eq(compressed->len, 1 + 4 + 2 * 2);
+    ck_assert_int_eq(compressed->data[0], 0x28);
+
+    Buffer *result = new_buffer();
+    buffer_pad(result, 12);
+    decodeLZSSPayloadFlagLevel(compressed->data, compressed->len, result);
+    ck_assert_mem_eq(result->data, "abcabcdddddd", 12);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFlag1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = lzss_flag_compress(file);
+    Buffer *result = lzss_flag_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFlag2)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    Buffer *compressed = lzss_flag_compress(file);
+    Buffer *result = lzss_flag_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFlag3)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = lzss_flag_compress(file);
+    Buffer *result = lzss_flag_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFlag4)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = lzss_flag_compress(file);
+    Buffer *result = lzss_flag_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *lzss_flag_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit;
+    s = suite_create("LZSS-flag");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, testFlagTable);
+    tcase_add_test(tc_unit, testEncodeDecodeFlagPayload);
+    TCase *tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, testCompressDecompressFlag1);
+    tcase_add_test(tc_int, testCompressDecompressFlag2);
+    tcase_add_test(tc_int, testCompressDecompressFlag3);
+    tcase_add_test(tc_int, testCompressDecompressFlag4);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
+
+START_TEST(testDecodeFastSequences)
+{
+    // "abc", a 9 byte reference at offset 3, then 20 literals of 'x', the
+    // last 5 of which end the stream
+    unsigned char sequences[] = {0x35, 'a', 'b', 'c', 3, 0, 0xf0, 5,
+        'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+        'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'};
+    unsigned char output[32 + FAST_WILDCOPY];
+    size_t len = decodeFastSequences(sequences, sizeof(sequences), output, 32);
+    ck_assert_int_eq(len, 32);
+    ck_assert_mem_eq(output, "abcabcabcabcxxxxxxxxxxxxxxxxxxxx", 32);
+}
+END_TEST
+
+START_TEST(testEncodeDecodeFastSequences)
+{
+    // runs with short offsets and a literal run longer than 15 + 255
+    unsigned char input[1000];
+    for (int i = 0; i < 300; i++)
+        input[i] = i * 7 + i / 3;
+    for (int i = 300; i < 1000; i++)
+        input[i] = i % 5 == 0 ? 'a' : 'b';
+    unsigned char compressed[1000 + 1000 / 255 + 32];
+    size_t len = encodeFastSequences(input, 1000, compressed);
+    ck_assert_int_lt(len, 400);
+    unsigned char output[1000 + FAST_WILDCOPY];
+    ck_assert_int_eq(decodeFastSequences(compressed, len, output, 1000), 1000);
+    ck_assert_mem_eq(output, input, 1000);
+}
+END_TEST
+
+START_TEST(testEncodeFastSequencesNearEnd)
+{
+    // a match ends 14 bytes before the end and another starts a byte after
+    // it, so the literals before the last match lie within 16 bytes of the
+    // end; the input is allocated to its exact size for ASan to check reads
+    size_t len = 64;
+    unsigned char *input = malloc(len);
+    for (size_t i = 0; i < len; i++)
+        input[i] = i * 37 + 11;
+    memcpy(input + 32, input + 1, 18);
+    memcpy(input + 51, input + 21, 7);
+    unsigned char compressed[64 + 32];
+    size_t size = encodeFastSequences(input, len, compressed);
+    ck_assert_int_lt(size, len);
+    unsigned char output[64 + FAST_WILDCOPY];
+    ck_assert_int_eq(decodeFastSequences(compressed, size, output, len), len);
+    ck_assert_mem_eq(output, input, len);
+    free(input);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFast1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = lzfast_compress(file);
+    Buffer *result = lzfast_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFast2)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    Buffer *compressed = lzfast_compress(file);
+    Buffer *result = lzfast_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFast3)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = lzfast_compress(file);
+    Buffer *result = lzfast_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressFast4)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = lzfast_compress(file);
+    Buffer *result = lzfast_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *lzfast_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit;
+    s = suite_create("LZ-fast");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, testDecodeFastSequences);
+    tcase_add_test(tc_unit, testEncodeDecodeFastSequences);
+    tcase_add_test(tc_unit, testEncodeFastSequencesNearEnd);
+    TCase *tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, testCompressDecompressFast1);
+    tcase_add_test(tc_int, testCompressDecompressFast2);
+    tcase_add_test(tc_int, testCompressDecompressFast3);
+    tcase_add_test(tc_int, testCompressDecompressFast4);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
+
 int main(void)
 {
     int number_failed;
-    Suite *lzss_s;
+    Suite *lzss_s, *lzss_flag_s, *lzfast_s;
     SRunner *sr;
 
     lzss_s = lzss_suite();
+    lzss_flag_s = lzss_flag_suite();
+    lzfast_s = lzfast_suite();
     sr = srunner_create(lzss_s);
+    srunner_add_suite(sr, lzss_flag_s);
+    srunner_add_suite(sr, lzfast_s);
 
     srunner_run_all(sr, CK_VERBOSE);
     number_failed = srunner_ntests_failed(sr);
@@ -5,51 +5,34 @@
 #include "../include/lzss.h"
 #include "../include/lzss_common.h"
 #include "../include/lzss_private.h"
-#include "../include/ringbuffer.h"
+#include "../include/lzhf.h"
+#include "../include/lzhf_private.h"
+#include "../include/lzans.h"
+#include "../include/lzss_byte.h"
+#include "../include/huffman.h"
+#include "../include/lzss_split.h"
+#include "../include/lzss_split_private.h"
 #include "../include/bitarray.h"
 #include "../include/fileops.h"
+#include "../include/lzdict.h"
+#include "../include/block.h"
+#include "../include/stream.h"
 
-START_TEST(testFindMatchKMP1)
+/**
+ * Make a small record of the kind a dictionary helps with: mostly the same
+ * field names and values, differing in a few places.
+ */
+Buffer *makeRecord(int n)
 {
-    RingBuffer *haystack = new_ringbuffer(1000);
-    Buffer *needle = new_buffer();
-    unsigned char *strA = (unsigned char *)"aybabtu";
-    unsigned char *strB = (unsigned char *)"bab";
-    ringbuffer_appendString(haystack, strA, 7);
-    buffer_append(needle, strB, 3);
-
-    int result = findMatchKMP(haystack, needle);
-    ck_assert_int_eq(result, 5);
+    char text[256];
+    int len = snprintf(text, sizeof(text),
+            "{\"id\": %d, \"user\": \"user%03d\", \"status\": \"active\", "
+            "\"roles\": [\"reader\", \"writer\"], \"created\": \"2020-01-%02d\"}\n",
+            n * 7919 % 10007, n, n % 28 + 1);
+    Buffer *ret = new_buffer();
+    buffer_append(ret, (unsigned char *)text, len);
+    return ret;
 }
-END_TEST
-
-START_TEST(testFindMatchKMP2)
-{
-    RingBuffer *haystack = new_ringbuffer(30);
-    Buffer *needle = new_buffer();
-    char *strA = "I AM SAM. I AM SAM. I AM SAM. I AM SAM. I AM SAM. I AM SAM. I AM SAM. I AM SAM.";
-    char *strB = "I AM SAM.";
-    ringbuffer_appendString(haystack, (unsigned char *)strA, strlen(strA) + 1);
-    buffer_append(needle, (unsigned char *)strB, strlen(strB) + 1);
-
-    int result = findMatchKMP(haystack, needle);
-    ck_assert_int_eq(result, 10);
-}
-END_TEST
-
-START_TEST(testFindMatchKMP3)
-{
-    RingBuffer *haystack = new_ringbuffer(30);
-    Buffer *needle = new_buffer();
-    char *strA = "";
-    char *strB = "I AM SAM.";
-    ringbuffer_appendString(haystack, (unsigned char *)strA, strlen(strA) + 1);
-    buffer_append(needle, (unsigned char *)strB, strlen(strB) + 1);
-
-    int result = findMatchKMP(haystack, needle);
-    ck_assert_int_eq(result, -1);
-}
-END_TEST
 
 START_TEST(testEncodeLZSSPayload)
 {
@@ -57,7 +40,7 @@ START_TEST(testEncodeLZSSPayload)
     unsigned char *str = (unsigned char *)"I AM SAM. I AM SAM."; 
     buffer_append(buf, str, 19);
     BitArray *result = new_bitarray();
-    encodeLZSSPayloadBitLevel(buf, result);
+    encodeLZSSPayloadBitLevel(buf, NULL, result, lzss_getParameters());
     BitArray *expected = new_bitarray();
     bitarray_append(expected, 0);
     bitarray_appendByte(expected, 'I');
@@ -71,8 +54,11 @@ START_TEST(testEncodeLZSSPayload)
     bitarray_appendByte(expected, ' ');
     bitarray_append(expected, 0);
     bitarray_appendByte(expected, 'S');
-    // append token for "AM"stored in little-endian format
-    writeToken(expected, 4, 2);
+    // "AM" is shorter than the shortest match the match finder looks for
+    bitarray_append(expected, 0);
+    bitarray_appendByte(expected, 'A');
+    bitarray_append(expected, 0);
+    bitarray_appendByte(expected, 'M');
     bitarray_append(expected, 0);
     bitarray_appendByte(expected, '.');
     bitarray_append(expected, 0);
@@ -109,7 +95,7 @@ START_TEST(testDecodeLZSSPayload)
     bitarray_appendByte(compressed, ' ');
     writeToken(compressed, 10, 9);
     BitArrayReader *reader = bitarray_createReader(compressed);
-    Buffer *decompressed = decodeLZSSPayloadBitLevel(reader, 19);
+    Buffer *decompressed = decodeLZSSPayloadBitLevel(reader, NULL, 19, lzss_getParameters());
 
     ck_assert_mem_eq(buf->data, decompressed->data, 19);
 }
@@ -144,7 +130,7 @@ START_TEST(testWriteToken2)
     int bit = 0;
     unsigned char byte = 0;
     BitArray *expected = new_bitarray();
-    uint32_t val = (distance_expected << TOKEN_LENGTH_BITS);
+    uint32_t val = (distance_expected << LZSS_DEFAULT_LENGTH_BITS);
     val |= length_expected;
     bitarray_append(expected, 1); // mark the beginning of a token
     bitarray_appendByte(expected, (val & (~0xff)) >> 8);
@@ -156,7 +142,7 @@ END_TEST
 
 START_TEST(testReadWriteToken)
 {
-    for (int i = 0; i < WINDOW_SIZE; i += 11) {
+    for (int i = 0; i < 1 << LZSS_DEFAULT_DISTANCE_BITS; i += 11) {
         BitArray *ba = new_bitarray();
         int distance_expected = i;
         int length_expected = i % 15;
@@ -183,9 +169,9 @@ START_TEST(testEncodeDecodeLZSSPayload)
     size_t len = strlen(str) + 1;
     buffer_append(src, (unsigned char *)str, len);
     BitArray *ba = new_bitarray();
-    encodeLZSSPayloadBitLevel(src, ba);
+    encodeLZSSPayloadBitLevel(src, NULL, ba, lzss_getParameters());
     BitArrayReader *reader = bitarray_createReader(ba);
-    Buffer *result = decodeLZSSPayloadBitLevel(reader, len);
+    Buffer *result = decodeLZSSPayloadBitLevel(reader, NULL, len, lzss_getParameters());
     ck_assert_mem_eq(result->data, src->data, len);
 }
 END_TEST
@@ -197,9 +183,9 @@ START_TEST(testEncodeDecodeLZSSPayload2)
     size_t len = strlen(str) + 1;
     buffer_append(src, (unsigned char *)str, len);
     BitArray *ba = new_bitarray();
-    encodeLZSSPayloadBitLevel(src, ba);
+    encodeLZSSPayloadBitLevel(src, NULL, ba, lzss_getParameters());
     BitArrayReader *reader = bitarray_createReader(ba);
-    Buffer *result = decodeLZSSPayloadBitLevel(reader, len);
+    Buffer *result = decodeLZSSPayloadBitLevel(reader, NULL, len, lzss_getParameters());
     ck_assert_mem_eq(result->data, src->data, len);
 }
 END_TEST
@@ -211,13 +197,465 @@ START_TEST(testEncodeDecodeLZSSPayload3)
     size_t len = strlen(str) + 1;
     buffer_append(src, (unsigned char *)str, len);
     BitArray *ba = new_bitarray();
-    encodeLZSSPayloadBitLevel(src, ba);
+    encodeLZSSPayloadBitLevel(src, NULL, ba, lzss_getParameters());
     BitArrayReader *reader = bitarray_createReader(ba);
-    Buffer *result = decodeLZSSPayloadBitLevel(reader, len);
+    Buffer *result = decodeLZSSPayloadBitLevel(reader, NULL, len, lzss_getParameters());
     ck_assert_mem_eq(result->data, src->data, len);
 }
 END_TEST
 
+START_TEST(testDecodeLZSSHostileLength)
+{
+    // a few items claiming to decode to a billion bytes
+    Buffer *src = new_buffer();
+    char *str = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    buffer_append(src, (unsigned char *)str, strlen(str));
+    BitArray *ba = new_bitarray();
+    encodeLZSSPayloadBitLevel(src, NULL, ba, lzss_getParameters());
+    BitArrayReader *reader = bitarray_createReader(ba);
+    decodeLZSSPayloadBitLevel(reader, NULL, 1000000000, lzss_getParameters());
+}
+END_TEST
+
+START_TEST(testReadWriteTokenWidth)
+{
+    LZSSParams layouts[] = {{12, 4}, {16, 8}, {15, 5}, {20, 2}};
+    for (int i = 0; i < 4; i++) {
+        LZSSParams params = layouts[i];
+        unsigned distance = (1u << params.distanceBits) - 3;
+        unsigned length = (1u << params.lengthBits) - 1;
+        BitArray *ba = new_bitarray();
+        writeTokenWidth(ba, distance, length, params);
+        ck_assert_int_eq(ba->len, 1 + params.distanceBits + params.lengthBits);
+        BitArrayReader *br = bitarray_createReader(ba);
+        int bit;
+        bitarrayreader_readBit(br, &bit);
+        ck_assert_int_eq(bit, 1);
+        unsigned distance_result, length_result;
+        readTokenWidth(br, &distance_result, &length_result, params);
+        ck_assert_int_eq(distance_result, distance);
+        ck_assert_int_eq(length_result, length);
+        delete_bitarrayreader(br);
+        delete_bitarray(ba);
+    }
+
+    // the default layout is the one of writeToken
+    BitArray *a = new_bitarray();
+    BitArray *b = new_bitarray();
+    writeToken(a, 1000, 13);
+    writeTokenWidth(b, 1000, 13, lzss_getParameters());
+    ck_assert_str_eq(bitarray_toString(a), bitarray_toString(b));
+    delete_bitarray(a);
+    delete_bitarray(b);
+}
+END_TEST
+
+START_TEST(testEncodeDecodeLayouts)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    LZSSParams layouts[] = {{8, 2}, {16, 8}, {15, 5}};
+    size_t sizes[3];
+    for (int i = 0; i < 3; i++) {
+        BitArray *ba = new_bitarray();
+        encodeLZSSPayloadBitLevel(file, NULL, ba, layouts[i]);
+        sizes[i] = ba->len;
+        BitArrayReader *reader = bitarray_createReader(ba);
+        Buffer *result = decodeLZSSPayloadBitLevel(reader, NULL, file->len, layouts[i]);
+        ck_assert_int_eq(buffer_equals(result, file), 1);
+        delete_buffer(result);
+        delete_bitarrayreader(reader);
+        delete_bitarray(ba);
+    }
+    // a tiny window and short matches find far less
+    ck_assert_int_gt(sizes[0], sizes[1]);
+
+    // the layout travels in the stream header
+    lzss_setParameters(16, 8);
+    Buffer *compressed = lzss_compress(file);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    Buffer *result = lzss_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(file);
+}
+END_TEST
+
+START_TEST(testReadWriteVariableToken)
+{
+    size_t distances[] = {1, 100, 4097, 1000000};
+    size_t lengths[] = {3, 4, 200, 65535};
+    for (int i = 0; i < 4; i++) {
+        VariableCoder writer = {4, 1, 0, {0}}, reader = writer;
+        BitArray *ba = new_bitarray();
+        writeVariableToken(ba, distances[i], lengths[i], &writer);
+        ck_assert_int_eq(ba->len, variableTokenLength(distances[i], lengths[i], &reader));
+        BitArrayReader *br = bitarray_createReader(ba);
+        int bit;
+        bitarrayreader_readBit(br, &bit);
+        ck_assert_int_eq(bit, 1);
+        size_t distance, length;
+        ck_assert_int_eq(readVariableToken(br, &distance, &length, &reader), ba->len - 1);
+        ck_assert_int_eq(distance, distances[i]);
+        ck_assert_int_eq(length, lengths[i]);
+        delete_bitarrayreader(br);
+        delete_bitarray(ba);
+        // without repeat matches, new distances take a bit less
+        VariableCoder plain = {4, 0, 0, {0}};
+        ba = new_bitarray();
+        writeVariableToken(ba, distances[i], lengths[i], &plain);
+        ck_assert_int_eq(ba->len, variableTokenLength(distances[i], lengths[i], &plain));
+        VariableCoder fresh = {4, 1, 0, {0}};
+        ck_assert_int_eq(ba->len + 1, variableTokenLength(distances[i], lengths[i], &fresh));
+        br = bitarray_createReader(ba);
+        bitarrayreader_readBit(br, &bit);
+        ck_assert_int_eq(readVariableToken(br, &distance, &length, &plain), ba->len - 1);
+        ck_assert_int_eq(distance, distances[i]);
+        delete_bitarrayreader(br);
+        delete_bitarray(ba);
+    }
+    // a near three byte match costs less than the literals, a long one
+    // much less than fixed-width tokens would
+    VariableCoder coder = {4, 1, 0, {0}};
+    ck_assert_int_lt(variableTokenLength(5, 3, &coder), 3 * 9);
+    ck_assert_int_lt(variableTokenLength(100, 200, &coder), 14 * 17);
+}
+END_TEST
+
+START_TEST(testReadWriteRepeatToken)
+{
+    size_t distances[] = {5000, 7, 5000, 300, 12, 9, 300, 7};
+    VariableCoder writer = {0, 1, 0, {0}}, reader = writer;
+    BitArray *ba = new_bitarray();
+    size_t sizes[8];
+    for (int i = 0; i < 8; i++) {
+        size_t start = ba->len;
+        writeVariableToken(ba, distances[i], 10, &writer);
+        sizes[i] = ba->len - start;
+    }
+    // a distance still among the last four costs just its index, one pushed
+    // out by four newer ones is coded in full
+    ck_assert_int_eq(sizes[2], 2 + bitarray_gammaLength(8) + MATCH_REP_BITS);
+    ck_assert_int_eq(sizes[6], sizes[2]);
+    ck_assert_int_gt(sizes[7], sizes[2]);
+    BitArrayReader *br = bitarray_createReader(ba);
+    for (int i = 0; i < 8; i++) {
+        int bit;
+        size_t distance, length;
+        bitarrayreader_readBit(br, &bit);
+        ck_assert_int_eq(readVariableToken(br, &distance, &length, &reader), sizes[i] - 1);
+        ck_assert_int_eq(distance, distances[i]);
+        ck_assert_int_eq(length, 10);
+    }
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(testReadWriteLongToken)
+{
+    VariableCoder writer = {8, 1, 1, {0}}, reader = writer;
+    BitArray *ba = new_bitarray();
+    writeVariableToken(ba, 300, 3, &writer);
+    writeLongToken(ba, (size_t)5 << 32, 1 << 20);
+    writeVariableToken(ba, 300, 40, &writer);
+    BitArrayReader *br = bitarray_createReader(ba);
+    size_t expected[][2] = {{300, 3}, {(size_t)5 << 32, 1 << 20}, {300, 40}};
+    for (int i = 0; i < 3; i++) {
+        int bit;
+        size_t distance, length;
+        bitarrayreader_readBit(br, &bit);
+        ck_assert_int_eq(bit, 1);
+        ck_assert_int_gt(readVariableToken(br, &distance, &length, &reader), 0);
+        ck_assert_uint_eq(distance, expected[i][0]);
+        ck_assert_uint_eq(length, expected[i][1]);
+    }
+    // the long reference did not push out the recent distance
+    ck_assert_int_eq(reader.reps[0], 300);
+    ck_assert_int_eq(br->pos, ba->len);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(testFindLongMatches)
+{
+    // a block of noise repeated far beyond the window, with noise between
+    size_t len = 300000;
+    unsigned char *data = malloc(len);
+    unsigned s = 1;
+    for (size_t i = 0; i < len; i++) {
+        s = s * 1103515245 + 12345;
+        data[i] = s >> 16;
+    }
+    memcpy(data + 250000, data + 10000, 20000);
+    size_t count;
+    LongMatch *matches = findLongMatches(data, len, 0, 4096, &count);
+    ck_assert_int_eq(count, 1);
+    ck_assert_uint_eq(matches[0].pos, 250000);
+    ck_assert_uint_eq(matches[0].distance, 240000);
+    ck_assert_uint_eq(matches[0].length, 20000);
+    free(matches);
+    // nearer than the minimum distance is left to the match finder
+    matches = findLongMatches(data, len, 0, 300000, &count);
+    ck_assert_int_eq(count, 0);
+    free(matches);
+    free(data);
+}
+END_TEST
+
+START_TEST(testParseRepeats)
+{
+    // records of a changing value followed by a fixed tail, so every tail
+    // repeats the distance of the previous one
+    unsigned char data[1024];
+    for (int i = 0; i < 1024; i += 16) {
+        for (int j = 0; j < 4; j++)
+            data[i + j] = (i * 37 + j * 101) >> 3;
+        memcpy(data + i + 4, "fixed record", 12);
+    }
+    size_t reps[MATCH_REPS] = {4, 3, 2, 1};
+    ck_assert_int_eq(updateRepeats(reps, 2), 2);
+    ck_assert_int_eq(reps[0], 2);
+    ck_assert_int_eq(reps[1], 4);
+    ck_assert_int_eq(reps[2], 3);
+    ck_assert_int_eq(reps[3], 1);
+    ck_assert_int_eq(updateRepeats(reps, 9), -1);
+    ck_assert_int_eq(findRepeat(reps, 9), 0);
+    ck_assert_int_eq(findRepeat(reps, 1), -1);
+
+    MatchFinder *mf = new_matchfinder(data, 1024, 4096, 255, LZSS_CHAIN_LIMIT);
+    mf->repeats = MATCH_REPS;
+    size_t count;
+    LZToken *tokens = parseTokens(mf, 0, &count);
+    size_t matches = 0, repeats = 0, history[MATCH_REPS] = {0};
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].distance == 0)
+            continue;
+        matches++;
+        if (updateRepeats(history, tokens[i].distance) >= 0)
+            repeats++;
+    }
+    ck_assert_int_gt(repeats * 2, matches);
+
+    // the coder ends up with the same recent distances as the parser
+    VariableCoder coder = {4, 1, 0, {0}};
+    LZSSParams params = {12, LZSS_VARIABLE_LENGTH, 0};
+    BitArray *ba = new_bitarray();
+    writeLZSSItems(ba, data, 0, tokens, count, NULL, 0, &coder, params);
+    ck_assert_mem_eq(coder.reps, mf->reps, sizeof(coder.reps));
+    delete_bitarray(ba);
+    free(tokens);
+    delete_matchfinder(mf);
+}
+END_TEST
+
+START_TEST(testWriteRepeatAfterShortMatch)
+{
+    // a three byte match far away takes more bits than its literals, but
+    // the parser made its distance a recent one, so it is still coded as a
+    // reference and the long match at the same distance as a repeat
+    unsigned char data[40] = {0};
+    LZToken tokens[] = {{40000, 3}, {0, 'x'}, {40000, 30}};
+    VariableCoder coder = {0, 1, 0, {0}}, fresh = coder;
+    size_t first = variableTokenLength(40000, 3, &fresh);
+    ck_assert_int_gt(first, 3 * 9);
+    LZSSParams params = {16, LZSS_VARIABLE_LENGTH, 0};
+    BitArray *ba = new_bitarray();
+    writeLZSSItems(ba, data, 0, tokens, 3, NULL, 0, &coder, params);
+    ck_assert_int_eq(findRepeat(coder.reps, 40000), 0);
+    ck_assert_int_eq(ba->len, first + 9 + 2 + bitarray_gammaLength(30 - MATCH_MIN + 1) + MATCH_REP_BITS);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(testChooseDistanceBits)
+{
+    VariableCoder coder = {0};
+    LZToken near[] = {{3, 10}, {0, 'a'}, {7, 4}, {2, 3}};
+    chooseDistanceBits(near, 4, 16, &coder);
+    ck_assert_int_lt(coder.lowBits, 4);
+    ck_assert_int_eq(coder.repeats, 0);
+    LZToken far[] = {{40000, 10}, {0, 'a'}, {50000, 4}, {30000, 3}};
+    chooseDistanceBits(far, 4, 16, &coder);
+    ck_assert_int_gt(coder.lowBits, 12);
+    ck_assert_int_eq(coder.repeats, 0);
+    // columns of a table alternate between a few distances
+    LZToken table[] = {{1200, 4}, {0, 'a'}, {48, 6}, {1200, 4}, {0, 'b'}, {48, 6}, {1200, 4}, {0, 'c'}, {48, 6}};
+    chooseDistanceBits(table, 9, 16, &coder);
+    ck_assert_int_eq(coder.repeats, 1);
+}
+END_TEST
+
+START_TEST(testCompressDecompressVariable)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    lzss_setParameters(16, 8);
+    Buffer *fixed = lzss_compress(file);
+    lzss_setParameters(16, LZSS_VARIABLE_LENGTH);
+    Buffer *compressed = lzss_compress(file);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    Buffer *result = lzss_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // long runs take a token each instead of one per 255 bytes
+    ck_assert_int_lt(compressed->len * 10, fixed->len);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(fixed);
+    delete_buffer(file);
+}
+END_TEST
+
+START_TEST(testCompressDecompressLongRange)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *image = readFile("samples/bliss-sample.bin");
+    Buffer *file = new_buffer();
+    buffer_append(file, text->data, text->len);
+    buffer_append(file, image->data, image->len);
+    buffer_append(file, text->data, text->len);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_VARIABLE_LENGTH);
+    Buffer *near = lzss_compress(file);
+    lzss_setLongRange(1);
+    Buffer *compressed = lzss_compress(file);
+    lzss_setLongRange(0);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    Buffer *result = lzss_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // the second copy of the text takes a single token
+    ck_assert_int_lt(compressed->len + text->len / 5, near->len);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(near);
+    delete_buffer(file);
+    delete_buffer(image);
+    delete_buffer(text);
+}
+END_TEST
+
+START_TEST(testCompressDecompressDictionary)
+{
+    Buffer *samples[40];
+    for (int i = 0; i < 40; i++)
+        samples[i] = makeRecord(i);
+    Buffer *dictionary = lzdict_train(samples, 40, 1024);
+    Buffer *record = makeRecord(100);
+    Buffer *plain = lzss_compress(record);
+    lzss_setDictionary(dictionary);
+    Buffer *compressed = lzss_compress(record);
+    Buffer *result = lzss_extract(compressed);
+    lzss_setDictionary(NULL);
+    ck_assert_int_eq(buffer_equals(result, record), 1);
+    ck_assert_int_lt(compressed->len * 2, plain->len);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(plain);
+    delete_buffer(record);
+    delete_buffer(dictionary);
+    for (int i = 0; i < 40; i++)
+        delete_buffer(samples[i]);
+}
+END_TEST
+
+START_TEST(testCompressDecompressPatch)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *image = readFile("samples/bliss-sample.bin");
+    Buffer *reference = new_buffer();
+    buffer_append(reference, image->data, image->len);
+    buffer_append(reference, text->data, text->len);
+    // a new version with a few bytes changed and a piece cut out
+    Buffer *file = new_buffer();
+    buffer_append(file, reference->data, reference->len);
+    for (size_t i = 1000; i < file->len; i += 20000)
+        file->data[i] ^= 0x55;
+    memmove(file->data + 50000, file->data + 51000, file->len - 51000);
+    file->len -= 1000;
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_VARIABLE_LENGTH);
+    lzss_setLongRange(1);
+    lzss_setDictionary(reference);
+    Buffer *compressed = lzss_compress(file);
+    Buffer *result = lzss_extract(compressed);
+    lzss_setDictionary(NULL);
+    lzss_setLongRange(0);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // the output only has to describe the changes
+    ck_assert_int_lt(compressed->len, 200);
+    delete_buffer(result);
+    delete_buffer(compressed);
+    delete_buffer(file);
+    delete_buffer(reference);
+    delete_buffer(image);
+    delete_buffer(text);
+}
+END_TEST
+
+START_TEST(testCompressDecompressBlocks)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *image = readFile("samples/bliss-sample.bin");
+    Buffer *file = new_buffer();
+    // a bit over two blocks
+    while (file->len < 2 * BLOCK_SIZE + 1000) {
+        buffer_append(file, text->data, text->len);
+        buffer_append(file, image->data, image->len);
+    }
+    ThreadPool *single = new_threadpool(1);
+    ThreadPool *pool = new_threadpool(4);
+    Buffer *serial = block_compress(file, lzss_compress, single);
+    Buffer *parallel = block_compress(file, lzss_compress, pool);
+    // the blocks do not depend on the amount of threads
+    ck_assert_int_eq(buffer_equals(serial, parallel), 1);
+    Buffer *result = block_extract(parallel, lzss_extract, NULL, pool);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // a second run reuses the scratch memory of the threads
+    Buffer *again = block_compress(file, lzss_compress, pool);
+    ck_assert_int_eq(buffer_equals(again, parallel), 1);
+    delete_buffer(again);
+    delete_threadpool(pool);
+    delete_threadpool(single);
+    delete_buffer(result);
+    delete_buffer(parallel);
+    delete_buffer(serial);
+    delete_buffer(file);
+    delete_buffer(image);
+    delete_buffer(text);
+}
+END_TEST
+
+START_TEST(testCompressDecompressPrimedBlocks)
+{
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    Buffer *image = readFile("samples/bliss-sample.bin");
+    Buffer *binary = readFile("samples/linux-sample.bin");
+    // the second block repeats data from the first one
+    Buffer *file = new_buffer();
+    while (file->len < BLOCK_SIZE + 100000) {
+        buffer_append(file, text->data, text->len);
+        buffer_append(file, image->data, image->len);
+        buffer_append(file, binary->data, binary->len);
+    }
+    lzss_setParameters(20, LZSS_VARIABLE_LENGTH);
+    ThreadPool *pool = new_threadpool(2);
+    Buffer *independent = block_compress(file, lzss_compress, pool);
+    Buffer *primed = block_compressPrimed(file, lzss_compressWithHistory, (size_t)1 << 20, pool);
+    lzss_setParameters(LZSS_DEFAULT_DISTANCE_BITS, LZSS_DEFAULT_LENGTH_BITS);
+    Buffer *result = block_extract(primed, lzss_extract, lzss_extractWithHistory, pool);
+    delete_threadpool(pool);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // the second block takes a few tokens instead of starting over
+    ck_assert_int_lt(primed->len + 5000, independent->len);
+    delete_buffer(result);
+    delete_buffer(primed);
+    delete_buffer(independent);
+    delete_buffer(file);
+    delete_buffer(binary);
+    delete_buffer(image);
+    delete_buffer(text);
+}
+END_TEST
+
 START_TEST(testCompressDecompressBit1)
 {
     Buffer *file = readFile("samples/bliss-sample.bin");
@@ -266,15 +704,171 @@ START_TEST(testCompressDecompressBit4)
 }
 END_TEST
 
+START_TEST(testTrainDictionary)
+{
+    Buffer *samples[40];
+    for (int i = 0; i < 40; i++)
+        samples[i] = makeRecord(i);
+    Buffer *dictionary = lzdict_train(samples, 40, 256);
+    ck_assert_int_gt(dictionary->len, 0);
+    ck_assert_int_le(dictionary->len, 256);
+    // text common to every record ends up in the dictionary
+    char *common = "\"status\": \"active\"";
+    int found = 0;
+    for (size_t i = 0; i + strlen(common) <= dictionary->len; i++)
+        found |= memcmp(dictionary->data + i, common, strlen(common)) == 0;
+    ck_assert_int_eq(found, 1);
+    ck_assert_uint_eq(lzdict_id(dictionary), lzdict_id(dictionary));
+    ck_assert_uint_ne(lzdict_id(dictionary), lzdict_id(samples[0]));
+    delete_buffer(dictionary);
+    for (int i = 0; i < 40; i++)
+        delete_buffer(samples[i]);
+}
+END_TEST
+
+START_TEST(testMatchFinder)
+{
+    unsigned char *str = (unsigned char *)"abcdeXabcdeYabcdeXabc";
+    size_t len = strlen((char *)str), distance = 0;
+    MatchFinder *mf = new_matchfinder(str, len, 16, 8, 16);
+    for (size_t i = 0; i < 11; i++)
+        matchfinder_insert(mf, i);
+
+    // no match for "Yab"
+    ck_assert_int_eq(matchfinder_find(mf, 11, &distance), 0);
+    matchfinder_insert(mf, 11);
+    // "abcdeXab" at distance 12 is longer than "abcde" at distance 6
+    ck_assert_int_eq(matchfinder_find(mf, 12, &distance), 8);
+    ck_assert_int_eq(distance, 12);
+    delete_matchfinder(mf);
+
+    // the same search with a window too small to reach the longer match
+    mf = new_matchfinder(str, len, 8, 8, 16);
+    for (size_t i = 0; i < 12; i++)
+        matchfinder_insert(mf, i);
+    ck_assert_int_eq(matchfinder_find(mf, 12, &distance), 5);
+    ck_assert_int_eq(distance, 6);
+    delete_matchfinder(mf);
+}
+END_TEST
+
+START_TEST(testParseTokens)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    MatchFinder *mf = new_matchfinder(file->data, file->len, LZHF_WINDOW_SIZE, LZHF_MAXLEN, LZHF_CHAIN_LIMIT);
+    size_t count;
+    LZToken *tokens = parseTokens(mf, 0, &count);
+
+    // expanding the tokens gives back the input
+    Buffer *result = new_buffer();
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].distance == 0) {
+            unsigned char c = tokens[i].length;
+            buffer_append(result, &c, 1);
+            continue;
+        }
+        ck_assert_int_ge(tokens[i].length, MATCH_MIN);
+        ck_assert_int_le(tokens[i].length, LZHF_MAXLEN);
+        ck_assert_int_le(tokens[i].distance, result->len);
+        // copy the byte first, as appending may move the buffer
+        for (size_t j = 0; j < tokens[i].length; j++) {
+            unsigned char c = result->data[result->len - tokens[i].distance];
+            buffer_append(result, &c, 1);
+        }
+    }
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    ck_assert_int_lt(count, file->len / 4);
+    free(tokens);
+    delete_matchfinder(mf);
+    delete_buffer(result);
+    delete_buffer(file);
+}
+END_TEST
+
+START_TEST(testBuckets)
+{
+    int extra, extra2;
+    ck_assert_int_eq(valueToBucket(3, &extra), 3);
+    ck_assert_int_eq(extra, 0);
+    ck_assert_int_eq(valueToBucket(4, &extra), 4);
+    ck_assert_int_eq(extra, 1);
+    ck_assert_int_eq(valueToBucket(255, &extra), 15);
+    ck_assert_int_eq(valueToBucket(LZHF_WINDOW_SIZE - 1, &extra), LZHF_DISTANCE_SYMBOLS - 1);
+    for (size_t value = 0; value < 100000; value++) {
+        int bucket = valueToBucket(value, &extra);
+        size_t base = bucketBase(bucket, &extra2);
+        ck_assert_int_eq(extra, extra2);
+        ck_assert_int_le(base, value);
+        ck_assert_int_lt(value - base, (size_t)1 << extra);
+    }
+}
+END_TEST
+START_TEST(testCompressDecompressStream)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    StreamEncoder *whole = new_streamencoder(lzss_compress, lzss_compressWithHistory, 4096, 16384);
+    StreamEncoder *chunked = new_streamencoder(lzss_compress, lzss_compressWithHistory, 4096, 16384);
+    Buffer *expected = new_buffer();
+    Buffer *stream = new_buffer();
+    streamencoder_update(whole, file->data, file->len, expected);
+    streamencoder_finish(whole, expected);
+    for (size_t i = 0; i < file->len; i += 1000) {
+        streamencoder_update(chunked, file->data + i, file->len - i < 1000 ? file->len - i : 1000, stream);
+        // each block is written as soon as it is complete
+        if (i + 1000 >= 16384)
+            ck_assert_int_gt(stream->len, 0);
+    }
+    streamencoder_finish(chunked, stream);
+    ck_assert_int_eq(buffer_equals(stream, expected), 1);
+
+    // batches of blocks compressed on several threads give the same stream
+    ThreadPool *pool = new_threadpool(2);
+    StreamEncoder *batched = new_streamencoder(lzss_compress, lzss_compressWithHistory, 4096, 16384);
+    streamencoder_setPool(batched, pool, 3);
+    Buffer *parallel = new_buffer();
+    streamencoder_update(batched, file->data, file->len, parallel);
+    streamencoder_finish(batched, parallel);
+    ck_assert_int_eq(buffer_equals(parallel, expected), 1);
+    delete_streamencoder(batched);
+    delete_threadpool(pool);
+    delete_buffer(parallel);
+
+    // a memory budget gives fewer or smaller blocks
+    size_t blocks = 4;
+    ck_assert_int_eq(stream_budgetBlockSize((size_t)64 << 20, 4096, &blocks), (size_t)1 << 21);
+    ck_assert_int_eq(blocks, 4);
+    ck_assert_int_eq(stream_budgetBlockSize((size_t)1 << 20, 4096, &blocks), STREAM_MIN_BLOCK);
+    ck_assert_int_eq(blocks, 2);
+
+    // chunks that split the headers and blocks
+    StreamDecoder *dec = new_streamdecoder(lzss_extract, lzss_extractWithHistory);
+    Buffer *result = new_buffer();
+    for (size_t i = 0; i < stream->len; i += 7)
+        streamdecoder_update(dec, stream->data + i, stream->len - i < 7 ? stream->len - i : 7, result);
+    streamdecoder_finish(dec);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+
+    delete_streamdecoder(dec);
+    delete_streamencoder(chunked);
+    delete_streamencoder(whole);
+    delete_buffer(result);
+    delete_buffer(stream);
+    delete_buffer(expected);
+    delete_buffer(file);
+}
+END_TEST
+
+
 Suite *lzss_common_suite(void)
 {
     Suite *s;
     TCase *tc_unit;
     s = suite_create("LZSS-common");
     tc_unit = tcase_create("Unit");
-    tcase_add_test(tc_unit, testFindMatchKMP1);
-    tcase_add_test(tc_unit, testFindMatchKMP2);
-    tcase_add_test(tc_unit, testFindMatchKMP3);
+    tcase_add_test(tc_unit, testMatchFinder);
+    tcase_add_test(tc_unit, testParseTokens);
+    tcase_add_test(tc_unit, testBuckets);
+    tcase_add_test(tc_unit, testTrainDictionary);
     suite_add_tcase(s, tc_unit);
     return s;
 }
@@ -292,29 +886,335 @@ Suite *lzss_suite(void)
     tcase_add_test(tc_unit, testEncodeDecodeLZSSPayload);
     tcase_add_test(tc_unit, testEncodeDecodeLZSSPayload2);
     tcase_add_test(tc_unit, testEncodeDecodeLZSSPayload3);
+    tcase_add_exit_test(tc_unit, testDecodeLZSSHostileLength, EXIT_FAILURE);
+    tcase_add_test(tc_unit, testReadWriteTokenWidth);
+    tcase_add_test(tc_unit, testEncodeDecodeLayouts);
+    tcase_add_test(tc_unit, testReadWriteVariableToken);
+    tcase_add_test(tc_unit, testReadWriteRepeatToken);
+    tcase_add_test(tc_unit, testReadWriteLongToken);
+    tcase_add_test(tc_unit, testFindLongMatches);
+    tcase_add_test(tc_unit, testParseRepeats);
+    tcase_add_test(tc_unit, testWriteRepeatAfterShortMatch);
+    tcase_add_test(tc_unit, testChooseDistanceBits);
     TCase *tc_int = tcase_create("Integration");
     tcase_set_timeout(tc_int, 10);
     tcase_add_test(tc_int, testCompressDecompressBit1);
     tcase_add_test(tc_int, testCompressDecompressBit2);
     tcase_add_test(tc_int, testCompressDecompressBit3);
     tcase_add_test(tc_int, testCompressDecompressBit4);
+    tcase_add_test(tc_int, testCompressDecompressVariable);
+    tcase_add_test(tc_int, testCompressDecompressLongRange);
+    tcase_add_test(tc_int, testCompressDecompressDictionary);
+    tcase_add_test(tc_int, testCompressDecompressPatch);
+    tcase_add_test(tc_int, testCompressDecompressBlocks);
+    tcase_add_test(tc_int, testCompressDecompressPrimedBlocks);
+    tcase_add_test(tc_int, testCompressDecompressStream);
     suite_add_tcase(s, tc_unit);
     suite_add_tcase(s, tc_int);
 
     return s;
 }
 
+START_TEST(testLZHFBlock)
+{
+    Buffer *src = new_buffer();
+    char *str = "I AM SAM. I AM SAM. SAM I AM.";
+    buffer_append(src, (unsigned char *)str, strlen(str));
+    MatchFinder *mf = new_matchfinder(src->data, src->len, LZHF_WINDOW_SIZE, LZHF_MAXLEN, LZHF_CHAIN_LIMIT);
+    size_t count;
+    LZToken *tokens = parseTokens(mf, 0, &count);
+    ck_assert_int_lt(count, src->len);
+    BitArray *ba = new_bitarray();
+    encodeLZHFBlock(tokens, count, ba);
+
+    Buffer *result = new_buffer();
+    BitArrayReader *br = bitarray_createReader(ba);
+    ck_assert_int_eq(decodeLZHFBlock(br, result, src->len), src->len);
+    ck_assert_int_eq(buffer_equals(result, src), 1);
+    free(tokens);
+    delete_matchfinder(mf);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_buffer(result);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(testLZHFHostileLength)
+{
+    // a block whose only literal takes no bits, claiming a billion of them
+    unsigned char lengths[LZHF_LITLEN_SYMBOLS] = {0};
+    lengths['a'] = 1;
+    HuffCode *code = new_huffcode(LZHF_LITLEN_SYMBOLS);
+    huffcode_fromLengths(code, lengths);
+    BitArray *stream = new_bitarray();
+    bitarray_writeInteger(stream, 1000000000);
+    huffcode_writeLengths(code, stream);
+    delete_huffcode(code);
+    unsigned char distances[LZHF_DISTANCE_SYMBOLS] = {1};
+    code = new_huffcode(LZHF_DISTANCE_SYMBOLS);
+    huffcode_fromLengths(code, distances);
+    huffcode_writeLengths(code, stream);
+    delete_huffcode(code);
+    lzhf2_extract(bitarray_deleteAndConvertToBuffer(stream));
+}
+END_TEST
+
+START_TEST(testCompressDecompressLZHF1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = lzhf2_compress(file);
+    Buffer *result = lzhf2_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressLZHF2)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    Buffer *compressed = lzhf2_compress(file);
+    Buffer *result = lzhf2_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressLZHF3)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = lzhf2_compress(file);
+    Buffer *result = lzhf2_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    // better than the 273% of lzss-byte followed by Huffman
+    ck_assert_int_gt(file->len * 100 / compressed->len, 273);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressLZHF4)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = lzhf2_compress(file);
+    Buffer *result = lzhf2_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressPipelinedLZHF)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    Buffer *text = readFile("samples/loremipsum-100k.txt");
+    // several Huffman blocks of lzss-byte data
+    while (file->len < 4 * HUFFMAN_BLOCK_SIZE)
+        buffer_append(file, text->data, text->len);
+    Buffer *compressed = lzhf_compress(file);
+    // the same format as the two stages one after the other
+    Buffer *stream = lzss_byte_compress(file);
+    Buffer *nested = huffman_compress(stream);
+    ck_assert_int_eq(buffer_equals(compressed, nested), 1);
+    Buffer *result = lzhf_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(result);
+    // with the stages taking turns, the output is the same
+    lzhf_setPipelined(0);
+    Buffer *turns = lzhf_compress(file);
+    ck_assert_int_eq(buffer_equals(turns, compressed), 1);
+    result = lzhf_extract(turns);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(result);
+    delete_buffer(turns);
+    // as they do on the threads of a pool
+    ThreadPool *pool = new_threadpool(2);
+    Buffer *blocks = block_compressPrimed(file, lzhf_compressWithHistory, 4096, pool);
+    result = block_extract(blocks, lzhf_extract, lzhf_extractWithHistory, pool);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    lzhf_setPipelined(1);
+    delete_threadpool(pool);
+    delete_buffer(result);
+    delete_buffer(blocks);
+    delete_buffer(nested);
+    delete_buffer(stream);
+    delete_buffer(compressed);
+    delete_buffer(text);
+    delete_buffer(file);
+}
+END_TEST
+
+START_TEST(testCompressDecompressLZANS)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = lzans_compress(file);
+    Buffer *result = lzans_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *lzhf_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit;
+    s = suite_create("LZHF");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, testLZHFBlock);
+    tcase_add_exit_test(tc_unit, testLZHFHostileLength, EXIT_FAILURE);
+    TCase *tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, testCompressDecompressLZHF1);
+    tcase_add_test(tc_int, testCompressDecompressLZHF2);
+    tcase_add_test(tc_int, testCompressDecompressLZHF3);
+    tcase_add_test(tc_int, testCompressDecompressLZHF4);
+    tcase_add_test(tc_int, testCompressDecompressPipelinedLZHF);
+    tcase_add_test(tc_int, testCompressDecompressLZANS);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
+
+
+START_TEST(testSplitMergeStreams)
+{
+    // "abc", a reference to it, "d" and a 300 byte distance reference
+    LZToken tokens[] = {{0, 'a'}, {0, 'b'}, {0, 'c'}, {3, 3}, {0, 'd'}, {1, 5}};
+    Buffer *streams[LZSS_SPLIT_STREAMS];
+    splitTokens(tokens, 6, streams);
+    ck_assert_int_eq(streams[SPLIT_FLAGS]->len, 1);
+    ck_assert_int_eq(streams[SPLIT_FLAGS]->data[0], 0x28);
+    ck_assert_int_eq(streams[SPLIT_LITERALS]->len, 4);
+    ck_assert_mem_eq(streams[SPLIT_LITERALS]->data, "abcd", 4);
+    ck_assert_int_eq(streams[SPLIT_LENGTHS]->len, 2);
+    ck_assert_int_eq(streams[SPLIT_LENGTHS]->data[1], 5 - MATCH_MIN);
+    ck_assert_int_eq(streams[SPLIT_DISTANCE_LOW]->data[0], 2);
+
+    Buffer *result = mergeStreams(streams, 12);
+    ck_assert_mem_eq(result->data, "abcabcdddddd", 12);
+    for (int i = 0; i < LZSS_SPLIT_STREAMS; i++)
+        delete_buffer(streams[i]);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testEncodeDecodeStream)
+{
+    Buffer *src = new_buffer();
+    for (int i = 0; i < 5000; i++) {
+        unsigned char c = i % 7 == 0 ? i : 0;
+        buffer_append(src, &c, 1);
+    }
+    Buffer *empty = new_buffer();
+    BitArray *ba = new_bitarray();
+    encodeStream(src, ba);
+    encodeStream(empty, ba);
+
+    BitArrayReader *br = bitarray_createReader(ba);
+    Buffer *result = decodeStream(br);
+    ck_assert_int_eq(buffer_equals(result, src), 1);
+    delete_buffer(result);
+    result = decodeStream(br);
+    ck_assert_int_eq(result->len, 0);
+    delete_buffer(result);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+    delete_buffer(empty);
+    delete_buffer(src);
+}
+END_TEST
+
+START_TEST(testCompressDecompressSplit1)
+{
+    Buffer *file = readFile("samples/bliss-sample.bin");
+    Buffer *compressed = lzss_split_compress(file);
+    Buffer *result = lzss_split_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressSplit2)
+{
+    Buffer *file = readFile("samples/linux-sample.bin");
+    Buffer *compressed = lzss_split_compress(file);
+    Buffer *result = lzss_split_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressSplit3)
+{
+    Buffer *file = readFile("samples/loremipsum-100k.txt");
+    Buffer *compressed = lzss_split_compress(file);
+    Buffer *result = lzss_split_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+START_TEST(testCompressDecompressSplit4)
+{
+    Buffer *file = readFile("samples/ff.bin");
+    Buffer *compressed = lzss_split_compress(file);
+    Buffer *result = lzss_split_extract(compressed);
+    ck_assert_int_eq(buffer_equals(result, file), 1);
+    delete_buffer(file);
+    delete_buffer(compressed);
+    delete_buffer(result);
+}
+END_TEST
+
+Suite *lzss_split_suite(void)
+{
+    Suite *s;
+    TCase *tc_unit;
+    s = suite_create("LZSS-split");
+    tc_unit = tcase_create("Unit");
+    tcase_add_test(tc_unit, testSplitMergeStreams);
+    tcase_add_test(tc_unit, testEncodeDecodeStream);
+    TCase *tc_int = tcase_create("Integration");
+    tcase_set_timeout(tc_int, 10);
+    tcase_add_test(tc_int, testCompressDecompressSplit1);
+    tcase_add_test(tc_int, testCompressDecompressSplit2);
+    tcase_add_test(tc_int, testCompressDecompressSplit3);
+    tcase_add_test(tc_int, testCompressDecompressSplit4);
+    suite_add_tcase(s, tc_unit);
+    suite_add_tcase(s, tc_int);
+
+    return s;
+}
 
 int main(void)
 {
     int number_failed;
-    Suite *lzss_s, *lzss_common_s;
+    Suite *lzss_s, *lzss_common_s, *lzhf_s, *lzss_split_s;
     SRunner *sr;
 
     lzss_s = lzss_suite();
     lzss_common_s = lzss_common_suite();
+    lzhf_s = lzhf_suite();
+    lzss_split_s = lzss_split_suite();
     sr = srunner_create(lzss_common_s);
     srunner_add_suite(sr, lzss_s);
+    srunner_add_suite(sr, lzhf_s);
+    srunner_add_suite(sr, lzss_split_s);
 
     srunner_run_all(sr, CK_VERBOSE);
     number_failed = srunner_ntests_failed(sr);
@@ -2,11 +2,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "../include/bitarray.h"
 #include "../include/ringbuffer.h"
 #include "../include/buffer.h"
 #include "../include/priorityqueue.h"
+#include "../include/threadpool.h"
+#include "../include/arena.h"
+#include "../include/chunkqueue.h"
+#include "../include/container.h"
 
 /*
  * Tests for utility libraries
@@ -82,6 +88,48 @@ START_TEST(test_buffer_expands)
 }
 END_TEST
 
+START_TEST(test_buffer_varint)
+{
+    Buffer *buf = new_buffer();
+    size_t values[] = {0, 127, 128, 300, 0xffffffff, (size_t) 1 << 40};
+    for (int i = 0; i < 6; i++)
+        buffer_appendVarint(buf, values[i]);
+    ck_assert_int_eq(buf->len, 1 + 1 + 2 + 2 + 5 + 6);
+
+    BufferReader *reader = buffer_createReader(buf);
+    for (int i = 0; i < 6; i++) {
+        size_t val;
+        ck_assert_int_gt(bufferreader_readVarint(reader, &val), 0);
+        ck_assert_uint_eq(val, values[i]);
+    }
+    size_t val;
+    ck_assert_int_eq(bufferreader_readVarint(reader, &val), -1);
+    delete_bufferreader(reader);
+    delete_buffer(buf);
+}
+END_TEST
+
+START_TEST(test_container_header)
+{
+    Buffer *buf = new_buffer();
+    ContainerHeader header = {3, 16, 0, CONTAINER_STREAM | CONTAINER_DICTIONARY};
+    container_writeHeader(buf, &header);
+    ck_assert_int_eq(buf->len, CONTAINER_HEADER_SIZE);
+
+    ContainerHeader read = {0};
+    ck_assert_int_eq(container_readHeader(buf->data, buf->len, &read), CONTAINER_HEADER_SIZE);
+    ck_assert_int_eq(read.algorithm, 3);
+    ck_assert_int_eq(read.distanceBits, 16);
+    ck_assert_int_eq(read.lengthBits, 0);
+    ck_assert_int_eq(read.flags, CONTAINER_STREAM | CONTAINER_DICTIONARY);
+    // cut short or without the magic number, the input is not a container
+    ck_assert_int_eq(container_readHeader(buf->data, buf->len - 1, &read), 0);
+    buf->data[0] = 'C';
+    ck_assert_int_eq(container_readHeader(buf->data, buf->len, &read), 0);
+    delete_buffer(buf);
+}
+END_TEST
+
 START_TEST(test_ringbuffer_init)
 {
     RingBuffer *buf = new_ringbuffer(1000);
@@ -128,6 +176,141 @@ Suite *ringbuffer_suite(void)
     return s;
 }
 
+void test_count_task(void *arg, size_t index)
+{
+    ((int *)arg)[index]++;
+}
+
+START_TEST(test_threadpool_runs_every_task)
+{
+    int counts[1000] = {0};
+    ThreadPool *pool = new_threadpool(4);
+    threadpool_run(pool, 1000, test_count_task, counts);
+    for (int i = 0; i < 1000; i++)
+        ck_assert_int_eq(counts[i], 1);
+    // more threads than tasks, on the same pool
+    threadpool_run(pool, 3, test_count_task, counts);
+    ck_assert_int_eq(counts[2], 2);
+    ck_assert_int_eq(counts[3], 1);
+    threadpool_run(pool, 0, test_count_task, counts);
+    delete_threadpool(pool);
+    // the calling thread alone
+    pool = new_threadpool(1);
+    threadpool_run(pool, 1000, test_count_task, counts);
+    ck_assert_int_eq(counts[999], 2);
+    delete_threadpool(pool);
+}
+END_TEST
+
+void test_slow_task(void *arg, size_t index)
+{
+    // the first half of the tasks, given to the first thread, are slow
+    if (index < 4) {
+        struct timespec delay = {0, 20000000};
+        nanosleep(&delay, NULL);
+    }
+    ((Arena **)arg)[index] = arena_current();
+}
+
+START_TEST(test_threadpool_steals_tasks)
+{
+    Arena *arenas[8] = {NULL};
+    ThreadPool *pool = new_threadpool(2);
+    threadpool_run(pool, 8, test_slow_task, arenas);
+    int stolen = 0;
+    for (int i = 0; i < 8; i++) {
+        ck_assert_ptr_nonnull(arenas[i]);
+        stolen += i < 4 && arenas[i] != arenas[0];
+    }
+    // the second thread finished its own tasks and took slow ones
+    ck_assert_int_gt(stolen, 0);
+    ck_assert_ptr_ne(arenas[7], arenas[0]);
+    delete_threadpool(pool);
+    ck_assert_ptr_null(arena_current());
+}
+END_TEST
+
+START_TEST(test_threadpool_cores)
+{
+    ck_assert_int_ge(threadpool_cores(), 1);
+    ck_assert_int_le(threadpool_cores(), THREADPOOL_MAX_THREADS);
+}
+END_TEST
+
+void *test_push_chunks(void *queue)
+{
+    for (int i = 0; i < 1000; i++) {
+        Buffer *chunk = new_buffer();
+        buffer_append(chunk, (unsigned char *)&i, sizeof(int));
+        chunkqueue_push(queue, chunk);
+    }
+    chunkqueue_push(queue, NULL);
+    return NULL;
+}
+
+START_TEST(test_chunkqueue_passes_chunks_in_order)
+{
+    // a small queue makes both sides wait for each other
+    ChunkQueue *queue = new_chunkqueue(2);
+    pthread_t producer;
+    pthread_create(&producer, NULL, test_push_chunks, queue);
+    Buffer *chunk;
+    int expected = 0;
+    while ((chunk = chunkqueue_pop(queue))) {
+        int value;
+        memcpy(&value, chunk->data, sizeof(int));
+        ck_assert_int_eq(value, expected++);
+        delete_buffer(chunk);
+    }
+    ck_assert_int_eq(expected, 1000);
+    pthread_join(producer, NULL);
+    delete_chunkqueue(queue);
+}
+END_TEST
+
+START_TEST(test_arena_reuses_memory)
+{
+    Arena *arena = new_arena();
+    arena_setCurrent(arena);
+    void *first = arena_alloc(ARENA_MATCH_HEAD, 1000);
+    // the slot is in use, so this is allocated separately
+    void *second = arena_alloc(ARENA_MATCH_HEAD, 1000);
+    ck_assert_ptr_ne(first, second);
+    arena_free(ARENA_MATCH_HEAD, second);
+    arena_free(ARENA_MATCH_HEAD, first);
+    ck_assert_ptr_eq(arena_alloc(ARENA_MATCH_HEAD, 500), first);
+    arena_free(ARENA_MATCH_HEAD, first);
+    // growing the slot replaces its memory
+    void *grown = arena_alloc(ARENA_MATCH_HEAD, 100000);
+    memset(grown, 0, 100000);
+    arena_free(ARENA_MATCH_HEAD, grown);
+    ck_assert_ptr_eq(arena_alloc(ARENA_MATCH_HEAD, 100000), grown);
+    arena_free(ARENA_MATCH_HEAD, grown);
+    arena_setCurrent(NULL);
+    delete_arena(arena);
+    // without an arena, memory is allocated as usual
+    void *plain = arena_alloc(ARENA_MATCH_PREV, 100);
+    ck_assert_ptr_nonnull(plain);
+    arena_free(ARENA_MATCH_PREV, plain);
+}
+END_TEST
+
+Suite *threadpool_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+    s = suite_create("ThreadPool");
+    tc_core = tcase_create("Core");
+    tcase_add_test(tc_core, test_threadpool_runs_every_task);
+    tcase_add_test(tc_core, test_threadpool_steals_tasks);
+    tcase_add_test(tc_core, test_threadpool_cores);
+    tcase_add_test(tc_core, test_arena_reuses_memory);
+    tcase_add_test(tc_core, test_chunkqueue_passes_chunks_in_order);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
 int test_comparator(void *a, void *b)
 {
     int left = *(int *)a;
@@ -322,6 +505,73 @@ START_TEST(test_bitarrayreader_readInteger)
 }
 END_TEST
 
+START_TEST(test_bitarrayreader_readLargeInteger)
+{
+    BitArray *ba = new_bitarray();
+    // lengths of files over 4 GiB
+    size_t values[] = {(size_t)1 << 32, ((size_t)0xab << 40) | 0x7a1f9, SIZE_MAX};
+    for (int i = 0; i < 3; i++)
+        bitarray_writeInteger(ba, values[i]);
+    BitArrayReader *br = bitarray_createReader(ba);
+    for (int i = 0; i < 3; i++)
+        ck_assert(bitarrayreader_readInteger(br) == values[i]);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(test_bitarray_appendBits)
+{
+    BitArray *ba = new_bitarray();
+
+    bitarray_append(ba, 1);
+    bitarray_appendBits(ba, 0x5, 3);
+    bitarray_appendBits(ba, 0xabcdef12, 32);
+    bitarray_appendBits(ba, 0, 0);
+    bitarray_appendBits(ba, 0x3ff, 10);
+    ck_assert_int_eq(ba->len, 46);
+
+    BitArrayReader *br = bitarray_createReader(ba);
+    uint32_t bits = 0;
+    ck_assert_int_eq(bitarrayreader_readBits(br, 1, &bits), 1);
+    ck_assert_int_eq(bits, 1);
+    ck_assert_int_eq(bitarrayreader_peekBits(br, 3), 0x5);
+    ck_assert_int_eq(bitarrayreader_readBits(br, 3, &bits), 3);
+    ck_assert_int_eq(bits, 0x5);
+    ck_assert_int_eq(bitarrayreader_readBits(br, 32, &bits), 32);
+    ck_assert_uint_eq(bits, 0xabcdef12);
+    // bits past the end are read as zeroes
+    ck_assert_int_eq(bitarrayreader_peekBits(br, 16), 0x3ff);
+    ck_assert_int_eq(bitarrayreader_readBits(br, 11, &bits), -1);
+    ck_assert_int_eq(bitarrayreader_readBits(br, 10, &bits), 10);
+    ck_assert_int_eq(bits, 0x3ff);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
+START_TEST(test_bitarray_gamma)
+{
+    BitArray *ba = new_bitarray();
+    size_t values[] = {1, 2, 3, 4, 255, 256, 0xfffff, (size_t) 1 << 40};
+
+    for (int i = 0; i < 8; i++)
+        bitarray_writeGamma(ba, values[i]);
+    size_t expected = 0;
+    for (int i = 0; i < 8; i++)
+        expected += bitarray_gammaLength(values[i]);
+    ck_assert_int_eq(ba->len, expected);
+    ck_assert_int_eq(bitarray_gammaLength(1), 1);
+    ck_assert_int_eq(bitarray_gammaLength(4), 5);
+
+    BitArrayReader *br = bitarray_createReader(ba);
+    for (int i = 0; i < 8; i++)
+        ck_assert_uint_eq(bitarrayreader_readGamma(br), values[i]);
+    delete_bitarrayreader(br);
+    delete_bitarray(ba);
+}
+END_TEST
+
 START_TEST(test_bitarray_set_get)
 {
     BitArray *ba = new_bitarray();
@@ -422,6 +672,9 @@ Suite *bitarray_suite(void)
     tcase_add_test(tc_core, test_bitarray_set_get_byte);
     tcase_add_test(tc_core, test_bitarray_writeInteger);
     tcase_add_test(tc_core, test_bitarrayreader_readInteger);
+    tcase_add_test(tc_core, test_bitarrayreader_readLargeInteger);
+    tcase_add_test(tc_core, test_bitarray_appendBits);
+    tcase_add_test(tc_core, test_bitarray_gamma);
     tcase_add_test(tc_core, test_bitarray_concat);
     tcase_add_test(tc_core, test_bitarray_copyl1);
     tcase_add_test(tc_core, test_bitarray_copyl2);
@@ -442,6 +695,8 @@ Suite *buffer_suite(void)
     tcase_add_test(tc_core, test_buffer_append);
     tcase_add_test(tc_core, test_buffer_pad);
     tcase_add_test(tc_core, test_buffer_expands);
+    tcase_add_test(tc_core, test_buffer_varint);
+    tcase_add_test(tc_core, test_container_header);
     suite_add_tcase(s, tc_core);
 
     return s;
@@ -454,12 +709,14 @@ int main(void)
     Suite *queue = priorityqueue_suite();
     Suite *bitarray = bitarray_suite();
     Suite *ringbuffer = ringbuffer_suite();
+    Suite *threadpool = threadpool_suite();
     SRunner *sr;
 
     sr = srunner_create(buffer);
     srunner_add_suite(sr, queue);
     srunner_add_suite(sr, bitarray);
     srunner_add_suite(sr, ringbuffer);
+    srunner_add_suite(sr, threadpool);
 
     srunner_run_all(sr, CK_VERBOSE);
     number_failed = srunner_ntests_failed(sr);